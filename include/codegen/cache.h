@@ -0,0 +1,31 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "codegen/layout.h"
+#include "driver/options.h"
+#include "parser/ast.h"
+
+#include <stdio.h>
+
+// Content-addressed cache of generated functions (--cache-dir).
+//
+// Each function is generated on its own: its labels are numbered from 0
+// (nasm scopes .L labels to the function label before them), its print
+// strings follow its code as local .msgN labels and variables are the
+// var.<name> labels shared by all functions. The result, after the layout
+// pass, only depends on the function's optimized subtree, the types of the
+// variables it uses and the code generation flags, so it is stored under
+// a hash of those as <dir>/<hash>.asm and spliced back in on the next
+// build that has the same function.
+
+typedef struct {
+    int hits;
+    int misses;
+    double saved_ms;    // generation time the hits took when they were stored
+} CacheStats;
+
+// the text section, with functions taken from the cache where possible
+CacheStats emit_text_section_cached(ASTNode* program, const CompilerOptions* opts,
+                                    LayoutStats* layout, FILE* output);
+
+#endif
@@ -2,12 +2,26 @@
 #define CODEGEN_H
 
 #include "parser/ast.h"
+#include "driver/options.h"
 #include <stdio.h>
+#include <stdbool.h>
 
 extern int data_label_counter;
 extern int code_label_counter;
+extern int stack_depth; // 8-byte pushes outstanding since the frame was aligned
+extern bool select_instructions; // cost-based instruction selection (-O1 and above)
+extern VectorIsa vector_isa;     // instruction set for loops flagged by vectorize_loops
+extern bool debug_info;          // -g: %line markers and sized function symbols
+extern bool named_variables;     // var.<name> labels instead of varN (-g, --cache-dir)
+extern const char* message_prefix; // labels of print strings: msgN, or the function-local .msgN
+extern int debug_line;           // source line of the last %line marker, -1 for none
+
+// -g: nasm -g -F dwarf maps the code that follows to `line` of the source
+// (0 for code that belongs to no line)
+void emit_line_marker(int line, FILE* output);
 
 void generate_code(ASTNode* node, FILE* output);
-void generate_code_to_file(ASTNode* node);
+// writes the program's assembly to `output`
+void generate_code_to_stream(ASTNode* node, const CompilerOptions* opts, FILE* output);
 
 #endif
\ No newline at end of file
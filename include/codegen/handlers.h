@@ -4,16 +4,21 @@
 #include "codegen/codegen.h"
 
 void handle_program(ASTNode* node, FILE* output);
+// _start: calls main, or runs the main block, and exits
+void emit_entry_point(ASTNode* node, FILE* output);
 void handle_function(ASTNode* node, FILE* output);
 void handle_call(ASTNode* node, FILE* output);
 
 void handle_print(ASTNode* node, FILE* output);
 void handle_decl(ASTNode* node, FILE* output);
 void handle_assign(ASTNode* node, FILE* output);
+void handle_index(ASTNode* node, FILE* output);
+void handle_index_assign(ASTNode* node, FILE* output);
 
 void handle_if(ASTNode* node, FILE* output);
 void handle_while(ASTNode* node, FILE* output);
 void handle_break(ASTNode* node, FILE* output);
+void handle_switch(ASTNode* node, FILE* output);
 void handle_return(ASTNode* node, FILE* output);
 
 void handle_num(ASTNode* node, FILE* output);
@@ -22,4 +27,7 @@ void handle_binop(ASTNode* node, FILE* output);
 void handle_unop(ASTNode* node, FILE* output);
 void handle_compound(ASTNode* node, FILE* output);
 
+// drops what a compile that ended part way through a function left behind
+void handlers_reset(void);
+
 #endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define HELPERS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "codegen/codegen.h"
 #include "parser/ast.h"
@@ -13,8 +14,40 @@ void collect_print_messages(ASTNode* node, FILE* output);
 void emit_data_section(ASTNode* node, FILE* output);
 
 void collect_variables(ASTNode* node);
+// adds the profile counts of the code using each variable to its heat
+void weigh_variables(ASTNode* node);
 void emit_bss_section(FILE* output);
 
+// `reg` at the given width: register_part("rax", 1) is "al"
+const char* register_part(const char* reg, int size);
+// loads a value of `type` from [address] into the 64-bit `reg`, extended
+void emit_sized_load(const char* reg, const char* type, const char* address, FILE* output);
+// stores the low bytes of the 64-bit `reg` that fit `type` to [address]
+void emit_sized_store(const char* address, const char* type, const char* reg, FILE* output);
+// `byte`, `word`, `dword` or `qword`
+const char* size_keyword(int size);
+// the low `size` bytes of a constant, sign-extended as an immediate is written
+int64_t sized_immediate(int64_t value, int size);
+// stores a constant to [address] at the width of `type`; may use rax
+void emit_constant_store(const char* address, const char* type, int64_t value, FILE* output);
+
+bool contains_call(ASTNode* node);
+
+// a case value and the position of its clause in the switch
+typedef struct {
+    int value;
+    int index;
+} CaseLabel;
+
+// jump tables need at least this many cases, covering at most this many
+// table entries per case
+#define SWITCH_TABLE_MIN_CASES 4
+#define SWITCH_TABLE_MAX_SPREAD 3
+
+// case values sorted ascending; *default_index is -1 without a default
+int collect_case_labels(ASTNode* node, CaseLabel** out, int* default_index);
+bool dense_case_labels(const CaseLabel* labels, int count);
+
 void emit_text_section(ASTNode* node, FILE* output);
 void emit_itoa(FILE* output);
 
@@ -0,0 +1,24 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+// Execution counters for --instrument.
+//
+// Each counter is a qword in the `profile_counters` table in .bss and is
+// keyed by a kind, the function it sits in and a source line. The program
+// calls profile_dump before it exits, which writes one line per counter
+//     <kind> <function> <line> <count>
+// to the profile file. The kinds are "func" (entries into a function),
+// "loop" (iterations of a while body), "then" and "else" (arms of an if).
+
+extern bool instrument; // set by generate_code_to_stream when --instrument is given
+
+void instrument_reset(void);
+// emits `inc qword [profile_counters + ...]` for a new counter
+void emit_counter(const char* kind, const char* function, int line, FILE* output);
+// the profile_dump routine, the counter keys and the counter table
+void emit_profile_dump(const char* path, FILE* output);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+typedef struct {
+    int threaded;       // jumps retargeted past a jump-only block
+    int inverted;       // jcc over a jmp turned into a single inverted jcc
+    int removed;        // jumps to the next instruction and unreachable code
+    int aligned;        // loop headers aligned
+} LayoutStats;
+
+// Rewrites the emitted text section `text` (NUL-terminated) onto `output`:
+// builds the basic blocks between labels and jumps, threads jumps to jumps,
+// drops unreachable code, jumps to the fall-through block and unused local
+// labels, and aligns the target of every backward jump to `loop_align`
+// bytes (0 to leave loops unaligned).
+LayoutStats optimize_layout(const char* text, int loop_align, FILE* output);
+
+#endif
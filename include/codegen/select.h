@@ -0,0 +1,24 @@
+#ifndef SELECT_H
+#define SELECT_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "parser/ast.h"
+#include "codegen/symbol.h"
+
+// Cost-based instruction selection for expressions (-O1 and above).
+
+// value of an expression into rax
+void select_expr(ASTNode* node, FILE* output);
+
+// jumps to `label` when the truth of `cond` equals `when`
+void select_branch(ASTNode* cond, bool when, const char* label, FILE* output);
+
+// stores the value of an expression into a variable, truncated to its type
+void select_store(Symbol* sym, ASTNode* value, FILE* output);
+
+// loads a NUM or IDENT leaf into a 64-bit register, extended from its type
+void select_load(const char* reg, ASTNode* leaf, FILE* output);
+
+#endif
@@ -1,18 +1,32 @@
 #ifndef SYMBOL_H
 #define SYMBOL_H
 
+#include <stdio.h>
+
 typedef struct Symbol {
     char* name;
     char* type;
     char* label;
     char* value;
+    int index;
+    int size;           // array elements, 0 for a scalar
+    long heat;          // --profile-use: executions of the code using it
     struct Symbol* next;
 } Symbol;
 
 void init_symbol_table(void);
 void free_symbol_table(void);
+// varN labels keep counting across tables; this starts them over for the next compile
+void reset_symbol_labels(void);
 Symbol* add_symbol(const char* name, const char* value, const char* type);
+Symbol* add_array_symbol(const char* name, const char* type, int size);
 Symbol* lookup_symbol(const char *name);
 Symbol* get_symbol_table(void);
+int symbol_slot_count(void);
+int symbol_count(void);
+
+// lookup_symbol calls so far (for --stats)
+extern long symbol_lookups;
+void print_symbol_table(FILE* output);
 
 #endif
\ No newline at end of file
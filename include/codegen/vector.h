@@ -0,0 +1,14 @@
+#ifndef VECTOR_H
+#define VECTOR_H
+
+#include <stdio.h>
+
+#include "parser/ast.h"
+
+// Emits the SIMD version of a loop flagged by vectorize_loops: whole
+// vectors of iterations while they fit under the bound, leaving the
+// induction variable at the first iteration not yet run. The caller emits
+// the scalar loop right after it to finish the remaining elements.
+void emit_vector_loop(ASTNode* loop, FILE* output);
+
+#endif
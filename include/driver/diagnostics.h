@@ -0,0 +1,44 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <setjmp.h>
+
+// Errors and warnings of a compile.
+//
+// Each is passed to the handler of the compile as it is reported (printed
+// on stderr when there is none). An error that ends the compile then
+// returns to the recovery point the compile set up instead of exiting, so
+// libcompiler hands it back to its caller; a process without one still
+// exits.
+
+typedef enum {
+    DIAGNOSTIC_ERROR,
+    DIAGNOSTIC_WARNING
+} DiagnosticSeverity;
+
+typedef struct {
+    DiagnosticSeverity severity;
+    int line;               // in the source, 0 when it belongs to no line
+    const char* message;    // as bin/compiler prints it, without the newline
+} Diagnostic;
+
+typedef void (*DiagnosticHandler)(const Diagnostic* diagnostic, void* context);
+
+// Diagnostics go to `handler` until diagnostics_end; errors that end the
+// compile longjmp to `recovery` (with 1) when it is not NULL.
+void diagnostics_begin(DiagnosticHandler handler, void* context, jmp_buf* recovery);
+void diagnostics_end(void);
+
+// reports `fmt` as it is
+void report(DiagnosticSeverity severity, int line, const char* fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+// "Warning: ..."
+void compile_warning(int line, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+// "Error: ...", and the compile ends
+_Noreturn void compile_error(int line, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+// "Memory allocation failed in <where>", and the compile ends
+_Noreturn void out_of_memory(const char* where);
+// ends the compile after its errors have been reported
+_Noreturn void compile_abort(void);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Memory of a compile.
+//
+// Everything the compiler allocates goes through these functions and from
+// them to the allocator of the compile (libcompiler's caller, or the C
+// library's malloc). Blocks are linked while they are live, so a compile
+// abandoned on an error gives back what it held with mem_release_all, and
+// --stats reads the bytes in use from here.
+
+typedef struct {
+    void* (*allocate)(size_t size, void* context);
+    void* (*reallocate)(void* block, size_t size, void* context);
+    void (*release)(void* block, void* context);
+    void* context;
+} Allocator;
+
+// the allocator of the compiles that follow; NULL for malloc/realloc/free
+void mem_use(const Allocator* allocator);
+
+// NULL when the allocator fails, like their C library counterparts
+void* mem_alloc(size_t size);
+void* mem_calloc(size_t count, size_t size);
+void* mem_realloc(void* block, size_t size);
+void mem_free(void* block);
+
+// copies are made wherever names are kept, so these end the compile with
+// out_of_memory themselves rather than returning NULL
+char* mem_strdup(const char* s);
+char* mem_strndup(const char* s, size_t length);
+
+// frees every block still live
+void mem_release_all(void);
+// bytes in live blocks
+size_t mem_in_use(void);
+
+// open_memstream over mem_realloc: `*text` (NUL-terminated) and `*length`
+// are current after fflush or fclose; the text is the caller's to mem_free
+FILE* mem_stream(char** text, size_t* length);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdbool.h>
+
+typedef enum {
+    BACKEND_NATIVE,
+    BACKEND_VM
+} Backend;
+
+typedef enum {
+    VECTOR_NONE,
+    VECTOR_SSE2,            // 2 x 64-bit lanes in xmm registers
+    VECTOR_AVX2             // 4 x 64-bit lanes in ymm registers
+} VectorIsa;
+
+typedef enum {
+    STATS_OFF,
+    STATS_TEXT,             // a table on stderr
+    STATS_JSON              // one JSON object on stderr
+} StatsFormat;
+
+typedef struct {
+    const char* input_file;
+    Backend backend;
+    bool dump_bytecode;
+
+    int opt_level;          // -O0 (default) .. -O2
+    int inline_budget;      // max AST nodes in an inlined function body
+    long eval_steps;        // interpreter steps allowed per folded call
+    int eval_depth;         // call depth allowed per folded call
+    int unroll_factor;      // copies of a counted loop body per iteration (-O2)
+    int loop_align;         // byte alignment of loop headers (-O1, 0 disables)
+    VectorIsa vector_isa;   // instruction set for element-wise array loops (-O2)
+    bool opt_report;        // per-pass counts on stderr
+    bool debug_info;        // -g: sized function symbols, named data and source lines
+    const char* trace_categories;   // --trace=LIST, NULL when not tracing
+    const char* trace_file;         // binary trace destination, NULL for text on stderr
+    StatsFormat stats;      // per-phase time and memory report
+    const char* instrument_file;    // --instrument profile destination, NULL when not instrumenting
+    const char* profile_file;       // --profile-use counts, NULL without a profile
+    const char* cache_dir;          // --cache-dir: reuse the code of unchanged functions
+    const char* server_socket;      // --server: serve compile requests here, NULL to compile
+    int server_threads;     // connections served at once by --server
+} CompilerOptions;
+
+#define DEFAULT_INLINE_BUDGET 24
+#define DEFAULT_EVAL_STEPS 100000
+#define DEFAULT_EVAL_DEPTH 64
+#define DEFAULT_UNROLL_FACTOR 4
+#define DEFAULT_LOOP_ALIGN 16
+#define DEFAULT_PROFILE_FILE "program.prof"
+#define DEFAULT_SERVER_SOCKET "build/compiler.sock"
+#define DEFAULT_SERVER_THREADS 4
+
+const char* vector_isa_name(VectorIsa isa);
+// what a command line without flags gives
+void default_options(CompilerOptions* opts);
+int parse_options(int argc, char* argv[], CompilerOptions* opts);
+void print_usage(const char* prog);
+
+#endif
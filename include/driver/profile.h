@@ -0,0 +1,30 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "parser/ast.h"
+
+#include <stdbool.h>
+
+// Execution counts read back for --profile-use.
+//
+// The file is what an --instrument build writes: one `<kind> <function>
+// <line> <count>` line per counter. Counts are looked up by kind and source
+// line, summed over every counter with that key, so the copies that
+// unrolling and inlining made (which keep the line of their source
+// construct) add up to the construct again. Lookups return -1 when no
+// profile is loaded or it has no entry for the construct.
+
+// reads `path` and warns about each entry that matches nothing in
+// `program` (edited or deleted code), which is then ignored; -1 when the
+// file cannot be read
+int profile_load(const char* path, ASTNode* program);
+void profile_free(void);
+bool profile_loaded(void);
+
+long profile_count(const char* kind, int line);
+// ran at least a tenth as often as the hottest construct of the profile
+bool profile_hot(const char* kind, int line);
+// has an entry, and it never ran
+bool profile_cold(const char* kind, int line);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "driver/options.h"
+
+#include <stdio.h>
+
+// Per-phase measurements for --stats.
+//
+// A phase is bracketed by stats_begin/stats_end; both return at once
+// unless stats_open was called, so the brackets stay in the code. Each
+// phase records its wall time, the AST nodes created and symbol lookups
+// made while it ran, the symbol table size and net heap growth at its end,
+// the process's peak RSS so far and, when given an output file, the bytes
+// of assembly it wrote.
+
+typedef enum {
+    PHASE_PARSE,                // yyparse
+    PHASE_OPTIMIZE,             // optimize_program
+    PHASE_COLLECT_VARIABLES,
+    PHASE_VERIFY_SYMBOLS,
+    PHASE_EMIT_DATA,            // emit_data_section
+    PHASE_EMIT_BSS,             // emit_bss_section
+    PHASE_EMIT_TEXT,            // emit_text_section, layout and itoa
+    PHASE_LOWER,                // lower_program (--vm)
+    PHASE_RUN,                  // vm_run (--vm)
+    PHASE_FREE_AST,
+    PHASE_COUNT
+} StatsPhase;
+
+void stats_open(StatsFormat format);
+void stats_begin(StatsPhase phase, FILE* output);
+void stats_end(StatsPhase phase);
+// prints the phases that ran, in order, in the format given to stats_open
+void stats_report(FILE* output);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "driver/options.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stddef.h>
+
+// libcompiler: the compiler as a library (lib/libcompiler.a and .so).
+//
+// A compile reads its source from memory and hands the assembly back in
+// memory, together with every error and warning it reported; an error ends
+// the compile, not the process. bin/compiler is this plus reading the input
+// file, printing the diagnostics and writing build/asm/program.asm.
+//
+// Compiler state is global, so a process runs one compile at a time (the
+// server forks for parallel ones). --stats, --opt-report and text traces
+// still go to stderr, and --vm runs the program with stdout as its output.
+// A program that faults on the VM (division by zero, an element out of
+// range) ends the compile with `signal` set; bin/compiler then raises it.
+
+typedef struct {
+    const Allocator* allocator;         // all memory of the compile; NULL for malloc/realloc/free
+    DiagnosticHandler on_diagnostic;    // sees each diagnostic as it is reported; may be NULL
+    void* context;                      // for on_diagnostic
+} CompilerHooks;
+
+typedef struct {
+    int status;                 // bin/compiler's exit status (the program's with --vm)
+    int signal;                 // with --vm, the signal a faulting program dies of natively (status is 128 + it); 0 otherwise
+    char* assembly;             // NUL-terminated NASM source; NULL with --vm or after an error
+    size_t assembly_length;
+    Diagnostic* diagnostics;    // in the order they were reported
+    int diagnostic_count;
+    Allocator allocator;        // what the above came from
+} CompileResult;
+
+// what bin/compiler uses when given no flags
+void compiler_default_options(CompilerOptions* opts);
+
+// Compiles `length` bytes of `source` with `opts` (its input_file only
+// names the source in -g line markers). Everything the compile allocated
+// is back with the allocator when this returns, apart from `result`.
+// Returns result->status.
+int compiler_compile(const char* source, size_t length, const CompilerOptions* opts,
+                     const CompilerHooks* hooks, CompileResult* result);
+
+void compiler_free_result(CompileResult* result);
+
+#endif
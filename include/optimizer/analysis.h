@@ -0,0 +1,76 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stdbool.h>
+
+#include "parser/ast.h"
+
+// small set of variable names (linear lookup; programs have few variables)
+typedef struct {
+    char** names;
+    int count;
+    int capacity;
+} NameSet;
+
+void nameset_init(NameSet* set);
+void nameset_free(NameSet* set);
+bool nameset_add(NameSet* set, const char* name);
+bool nameset_contains(const NameSet* set, const char* name);
+bool nameset_intersects(const NameSet* a, const NameSet* b);
+
+void collect_reads(ASTNode* node, NameSet* out);
+void collect_writes(ASTNode* node, NameSet* out);
+void collect_params(ASTNode* func, NameSet* out);
+// declared names (params and decls, initialised or not)
+void collect_declarations(ASTNode* node, NameSet* out);
+
+// declared type of every variable (element type for arrays); declarations
+// of one name agree, so the first one seen is kept
+typedef struct {
+    NameSet names;
+    char** types;       // parallel to names.names
+} TypeTable;
+
+void collect_types(ASTNode* node, TypeTable* out);
+// "int" for a name without a declaration
+const char* type_of(const TypeTable* table, const char* name);
+void type_table_free(TypeTable* table);
+
+int count_nodes(ASTNode* node);
+bool contains_node_type(ASTNode* node, NodeType type);
+bool contains_call_to(ASTNode* node, const char* name);
+// structural equality of call-free expressions (calls never compare equal)
+bool same_expr(ASTNode* a, ASTNode* b);
+// call-free and without a division that could trap (only by constants other
+// than 0 and -1), so it may be evaluated early, more often, or not at all
+bool expr_cannot_fault(ASTNode* node);
+// a `break` in `node` that is not inside a nested loop
+bool breaks_outside_loops(ASTNode* node);
+
+ASTNode* find_function(ASTNode* program, const char* name);
+int count_params(ASTNode* func);
+int count_args(ASTNode* call);
+
+// statement lists are NODE_COMPOUND chains; nested blocks are flattened
+int flatten_statements(ASTNode* list, ASTNode*** out);
+ASTNode* build_statement_list(ASTNode** stmts, int count);
+void free_statement_list(ASTNode* list);
+
+// growable array used while rebuilding a statement list
+typedef struct {
+    ASTNode** items;
+    int count;
+    int capacity;
+} StmtBuffer;
+
+void stmt_buffer_push(StmtBuffer* buf, ASTNode* stmt);
+void stmt_buffer_push_list(StmtBuffer* buf, ASTNode* list);
+
+// names of the functions called directly in `node`
+void collect_callees(ASTNode* node, NameSet* out);
+
+// variables a call to `name` may store to, following calls transitively
+void collect_call_writes(ASTNode* program, const char* name, NameSet* out);
+void collect_expr_call_writes(ASTNode* program, ASTNode* node, NameSet* out);
+
+#endif
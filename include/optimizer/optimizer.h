@@ -0,0 +1,35 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "driver/options.h"
+#include "parser/ast.h"
+
+void optimize_program(ASTNode* program, const CompilerOptions* opts);
+
+typedef struct {
+    int self_calls;
+    int sibling_calls;
+} TailCallStats;
+
+typedef struct {
+    int full;
+    int partial;
+} UnrollStats;
+
+typedef struct {
+    int unreachable;    // statements that could never run
+    int dead_stores;
+    int functions;      // functions never called from the entry point
+} DceStats;
+
+int fold_pure_calls(ASTNode* program, long step_limit, int depth_limit);
+int inline_functions(ASTNode* program, int budget);
+int hoist_loop_invariants(ASTNode* program);
+int eliminate_common_subexpressions(ASTNode* program);
+// flags element-wise array loops (control.vectorize) for the vector code generator
+int vectorize_loops(ASTNode* program);
+UnrollStats unroll_loops(ASTNode* program, int factor);
+DceStats eliminate_dead_code(ASTNode* program);
+TailCallStats mark_tail_calls(ASTNode* program);
+
+#endif
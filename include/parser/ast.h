@@ -1,6 +1,10 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
 typedef struct ASTNode ASTNode;
 typedef enum {
     NODE_PROGRAM,
@@ -20,9 +24,15 @@ typedef enum {
     NODE_STR,
     NODE_COMPOUND,
     NODE_UNOP,
+    NODE_SWITCH,
+    NODE_CASE,
+    NODE_INDEX,
+    NODE_INDEX_ASSIGN,
     NODE_EMPTY
 } NodeType;
 
+#define NODE_TYPE_COUNT (NODE_EMPTY + 1)
+
 typedef enum {
     OP_POS, OP_NEG, 
     OP_EQ, OP_NEQ, OP_GE, OP_LE, OP_LT, OP_GT,
@@ -34,8 +44,9 @@ typedef enum {
 
 typedef struct ASTNode {
     NodeType type;
+    int line;           // source line the construct starts on, 0 if made up later
     union {
-        int num_value;
+        int64_t num_value;
         char* str_value;
         struct {
             ASTNode* functions;
@@ -65,6 +76,7 @@ typedef struct ASTNode {
             struct ASTNode* loop_body;
             struct ASTNode* if_body;
             struct ASTNode* else_body;
+            int vectorize;  // set by vectorize_loops: element-wise array loop
         } control;
         struct {
             Operator op;
@@ -72,19 +84,36 @@ typedef struct ASTNode {
         } unop;
         struct {
             struct ASTNode* expr;
+            int message;    // set by collect_print_messages: msg<N> holds a string expr
         } print_expr;
         struct {
             struct ASTNode* expr;
+            int tail_call;  // set by mark_tail_calls: expr is a call in tail position
         } return_stmt;
         struct {
             char* type;
             char* name;
             ASTNode* init_expr;
+            int size;       // array elements, 0 for a scalar
         } decl;
         struct {
             ASTNode* target;
             ASTNode* value;
         } assign;
+        struct {
+            ASTNode* expr;
+            ASTNode* cases;     // NODE_CASE list in source order
+        } switch_stmt;
+        struct {
+            int value;
+            int is_default;
+            ASTNode* body;      // falls through into the next case
+        } case_clause;
+        struct {
+            ASTNode* array;     // NODE_IDENT naming the array
+            ASTNode* index;
+            ASTNode* value;     // stored value, NODE_INDEX_ASSIGN only
+        } element;
     };
 } ASTNode;
 
@@ -102,20 +131,42 @@ ASTNode* create_while_node(ASTNode* cond, ASTNode* body);
 ASTNode* create_break_node(void);
 ASTNode* create_return_node(ASTNode* expr);
 ASTNode* create_decl_node(char* type, char* name, ASTNode* init_expr);
+ASTNode* create_array_decl_node(char* type, char* name, int size);
 ASTNode* create_assign_node(char* id, ASTNode* value);
 ASTNode* create_binop_node(Operator op, ASTNode* left, ASTNode* right);
 ASTNode* create_ident_node(char* id);
-ASTNode* create_num_node(int value);
+ASTNode* create_num_node(int64_t value);
 ASTNode* create_str_node(char* str);
 ASTNode* create_compound_node(ASTNode* stmt, ASTNode* next);
 ASTNode* append_statement(ASTNode* compound, ASTNode* stmt);
 ASTNode* create_unop_node(Operator op, ASTNode* operand);
+ASTNode* create_index_node(char* array, ASTNode* index);
+ASTNode* create_index_assign_node(char* array, ASTNode* index, ASTNode* value);
+ASTNode* create_switch_node(ASTNode* expr, ASTNode* cases);
+ASTNode* create_case_node(int value, int is_default, ASTNode* body);
+ASTNode* append_case(ASTNode* case_list, ASTNode* clause);
 ASTNode* create_if_else_node(ASTNode* cond, ASTNode* if_body, ASTNode* else_body);
 ASTNode* create_empty_node(void);
 
+ASTNode* clone_ast(ASTNode* node);
+
 const char* operator_to_string(Operator op);
 
-void print_ast(ASTNode* node, int indent);
+// Integer types of declarations: int (the same as i64), i8, i16, i32, i64,
+// u8, u16 and u32. Expressions are evaluated in 64 bits; a store keeps the
+// low bits of the value and a load sign- or zero-extends them again.
+int type_size(const char* type);            // bytes in memory
+bool type_is_signed(const char* type);
+int64_t wrap_to_type(const char* type, int64_t value);
+
+// nodes created so far, by type (for --stats)
+extern long ast_nodes_created[NODE_TYPE_COUNT];
+// line given to new nodes; the parser sets it to the first line of the rule
+// being reduced
+extern int ast_line;
+
+void print_ast(ASTNode* node, int indent, FILE* output);
+const char* node_type_name(NodeType type);
 void free_ast(ASTNode* node);
 
 #endif
\ No newline at end of file
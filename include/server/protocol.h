@@ -0,0 +1,34 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+
+// Messages between `compiler --server` and compiler-client.
+//
+// Both directions are a sequence of frames: a type byte, a 32-bit length
+// in host order (the socket is local) and that many bytes. A request is the
+// client's working directory, its arguments in order and the source,
+// closed by FRAME_END. The reply streams the compiler's stdout, stderr and
+// assembly as they are produced and ends with FRAME_STATUS, the exit status
+// as a 32-bit int.
+
+typedef enum {
+    FRAME_DIRECTORY = 'd',
+    FRAME_ARGUMENT  = 'g',
+    FRAME_SOURCE    = 's',
+    FRAME_END       = 'r',
+    FRAME_STDOUT    = 'o',
+    FRAME_STDERR    = 'e',
+    FRAME_ASM       = 'a',
+    FRAME_STATUS    = 'x'
+} FrameType;
+
+#define MAX_FRAME_LENGTH (64u << 20)
+
+// 0, or -1 when the peer is gone
+int write_frame(int fd, FrameType type, const void* data, uint32_t length);
+// Reads the next frame into `*data` (malloc'd and NUL-terminated, so text
+// frames are strings). 0, or -1 at end of stream or on a malformed frame.
+int read_frame(int fd, FrameType* type, char** data, uint32_t* length);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "driver/options.h"
+
+// Compile server (--server).
+//
+// Listens on a Unix socket for requests from compiler-client and answers
+// each with what bin/compiler would have printed, written and returned.
+// A pool of threads serves the connections; each request is compiled in a
+// fork of the server, since compiler state is global (libcompiler runs one
+// compile at a time), so requests compile in parallel and a compile that
+// crashes cannot take the server down. Runs until it is killed.
+int run_server(const CompilerOptions* opts);
+
+#endif
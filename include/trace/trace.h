@@ -0,0 +1,56 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+// Opt-in tracing of the compiler's phases.
+//
+// Every category is off unless selected with --trace; a disabled category
+// costs one test of a global bit mask at each trace point, and building
+// with -DTRACE_DISABLED removes the trace points altogether. Events go to
+// stderr as text through a buffered stream, or with --trace-file to a
+// compact binary file that the tracedump tool turns back into the same text.
+
+typedef enum {
+    TRACE_TOKENS,           // every token the lexer returns
+    TRACE_REDUCTIONS,       // grammar rules as the parser reduces them
+    TRACE_AST,              // the tree after parsing and after optimization
+    TRACE_SYMBOLS,          // the symbol table once variables are collected
+    TRACE_CODEGEN,          // nodes as the code generator visits them
+    TRACE_CATEGORY_COUNT
+} TraceCategory;
+
+extern unsigned trace_mask;
+
+#if defined(TRACE_DISABLED)
+#define trace_enabled(category) 0
+#elif defined(__GNUC__)
+#define trace_enabled(category) __builtin_expect((trace_mask >> (category)) & 1u, 0)
+#else
+#define trace_enabled(category) ((trace_mask >> (category)) & 1u)
+#endif
+
+// `categories` is a comma-separated list of category names or "all"; NULL
+// with a path traces everything. Binary output goes to `path` when it is
+// given. Returns -1 after printing why on a bad list or unwritable file.
+int trace_open(const char* categories, const char* path);
+void trace_close(void);
+
+// one event: `name` says what happened, `text` (may be NULL) the details
+void trace_event(TraceCategory category, int line, const char* name, const char* text);
+void trace_printf(TraceCategory category, int line, const char* name, const char* fmt, ...);
+
+// an event whose text is written to the returned stream until trace_end
+FILE* trace_begin(TraceCategory category, int line, const char* name);
+void trace_end(FILE* stream);
+
+const char* trace_category_name(TraceCategory category);
+// the text form of one event, shared by the text sink and tracedump
+void trace_format(FILE* output, TraceCategory category, int line, const char* name,
+                  const char* text, size_t length);
+
+// decodes a binary trace file to text; -1 if it is not one
+int trace_dump(FILE* input, FILE* output);
+
+#endif
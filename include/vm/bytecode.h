@@ -0,0 +1,118 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// opcode list: X(name, operand format)
+//   R = registers a,b,c   I = register a + imm   J = jump target in imm
+#define BYTECODE_OPS(X) \
+    X(LOADI,  "I")  /* r[a] = imm                     */ \
+    X(LOADK,  "I")  /* r[a] = consts[imm]             */ \
+    X(LOADG,  "I")  /* r[a] = globals[imm]            */ \
+    X(STOREG, "I")  /* globals[imm] = r[a]            */ \
+    X(LOADX,  "I")  /* r[a] = globals[imm + r[b]]     */ \
+    X(STOREX, "I")  /* globals[imm + r[b]] = r[a]     */ \
+    X(MOV,    "R")  /* r[a] = r[b]                    */ \
+    X(EXT,    "I")  /* r[a] = low |imm| bits of r[a], sign-extended if imm < 0 */ \
+    X(ADD,    "R")  /* r[a] = r[b] op r[c]            */ \
+    X(SUB,    "R")  \
+    X(MUL,    "R")  \
+    X(DIV,    "R")  \
+    X(MOD,    "R")  \
+    X(AND,    "R")  \
+    X(OR,     "R")  \
+    X(XOR,    "R")  \
+    X(NAND,   "R")  \
+    X(NOR,    "R")  \
+    X(XNOR,   "R")  \
+    X(SHL,    "R")  \
+    X(SHR,    "R")  \
+    X(EQ,     "R")  \
+    X(NE,     "R")  \
+    X(LT,     "R")  \
+    X(LE,     "R")  \
+    X(GT,     "R")  \
+    X(GE,     "R")  \
+    X(LAND,   "R")  \
+    X(LOR,    "R")  \
+    X(NEG,    "R")  /* r[a] = op r[b]                 */ \
+    X(NOT,    "R")  \
+    X(LNOT,   "R")  \
+    X(JMP,    "J")  /* pc = imm                       */ \
+    X(JZ,     "J")  /* if (r[a] == 0) pc = imm        */ \
+    X(JNZ,    "J")  /* if (r[a] != 0) pc = imm        */ \
+    X(JEQ,    "J")  /* if (r[a] op r[b]) pc = imm     */ \
+    X(JNE,    "J")  \
+    X(JLT,    "J")  \
+    X(JLE,    "J")  \
+    X(JGT,    "J")  \
+    X(JGE,    "J")  \
+    X(JTAB,   "I")  /* pc += 1 + min(r[a] - r[b], imm) unsigned; imm + 1 JMPs follow */ \
+    X(PRINTI, "R")  /* write r[a] as a decimal line   */ \
+    X(PRINTS, "I")  /* write strings[imm] as a line   */ \
+    X(CALL,   "I")  /* r[a] = funcs[imm](r[b]..r[b+c-1]) */ \
+    X(TAILCALL, "I") /* return funcs[imm](r[b]..), reusing the frame */ \
+    X(RET,    "R")  /* return r[a] to the caller      */ \
+    X(HALT,   "R")  /* exit with status r[a]          */
+
+typedef enum {
+#define BC_ENUM(name, fmt) BC_##name,
+    BYTECODE_OPS(BC_ENUM)
+#undef BC_ENUM
+    BC_OPCOUNT
+} Opcode;
+
+// fixed 8-byte instruction: three register operands plus a 32-bit immediate
+typedef struct {
+    uint8_t op;
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+    int32_t imm;
+} Instr;
+
+#define BC_MAX_REGS 256
+
+typedef struct {
+    char* name;
+    int entry;          // index of the first instruction
+    int nregs;          // register window size
+    int nparams;
+    int* param_slots;   // global slot each parameter is copied into
+} BytecodeFunc;
+
+typedef struct {
+    Instr* code;
+    int count;
+    int capacity;
+
+    BytecodeFunc* funcs;
+    int func_count;
+
+    char** strings;
+    int* string_lens;
+    int string_count;
+
+    int64_t* consts;    // literals that do not fit the 32-bit immediate
+    int const_count;
+
+    int global_count;   // one slot per scalar and per array element, like the .bss section
+    int entry;          // first instruction of the entry point
+    int entry_nregs;
+} BytecodeProgram;
+
+BytecodeProgram* bytecode_create(void);
+void bytecode_free(BytecodeProgram* prog);
+
+int bytecode_emit(BytecodeProgram* prog, Opcode op, int a, int b, int c, int32_t imm);
+void bytecode_patch(BytecodeProgram* prog, int at, int32_t target);
+int bytecode_add_string(BytecodeProgram* prog, const char* str);
+int bytecode_add_const(BytecodeProgram* prog, int64_t value);
+int bytecode_add_func(BytecodeProgram* prog, const char* name);
+int bytecode_find_func(BytecodeProgram* prog, const char* name);
+
+const char* opcode_name(Opcode op);
+void bytecode_dump(BytecodeProgram* prog, FILE* output);
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef VM_H
+#define VM_H
+
+#include "parser/ast.h"
+#include "vm/bytecode.h"
+
+BytecodeProgram* lower_program(ASTNode* root);
+int vm_run(BytecodeProgram* prog);
+int run_vm(ASTNode* root, int dump_bytecode);
+// SIGFPE or SIGSEGV when the last run ended on the fault the native program
+// dies of, 0 otherwise; cleared by reading it
+int vm_fault(void);
+
+#endif
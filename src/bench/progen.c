@@ -0,0 +1,205 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// progen: writes a random but valid program to stdout for the compile
+// throughput benchmark (./utils.sh throughput).
+//
+// The same seed and sizes always give the same program. Programs only
+// use what every backend and optimization level handles: int variables,
+// arithmetic and bitwise operators (no division, so nothing traps), calls
+// to functions defined earlier (no recursion) and while loops over their
+// own counters, so they also run to completion quickly. Variables are
+// global in this language, so every name is unique to its function.
+
+typedef struct {
+    unsigned long seed;
+    int statements;     // statements in main, nested ones included
+    int depth;          // operators on the longest path of an expression
+    int nesting;        // if/while blocks inside one another
+    int functions;
+    int variables;      // variables of main
+} GenOptions;
+
+static uint64_t rng_state;
+static int counters = 0;    // while loop counters handed out so far
+static int budget = 0;      // statements of main still to write
+
+static uint64_t next_random(void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+static int pick(int n) {
+    return (int)(next_random() % (uint64_t)n);
+}
+
+static void indent(int level) {
+    for (int i = 0; i < level; i++) fputs("    ", stdout);
+}
+
+// an operand: one of `count` variables named prefix0.. or a small constant
+static void emit_leaf(const char* prefix, int count) {
+    if (count > 0 && pick(3) != 0) {
+        printf("%s%d", prefix, pick(count));
+    } else {
+        printf("%d", pick(100));
+    }
+}
+
+static void emit_expr(const char* prefix, int count, int depth, int callable) {
+    if (depth <= 0 || pick(4) == 0) {
+        emit_leaf(prefix, count);
+        return;
+    }
+    int choice = pick(10);
+    if (choice == 0 && callable > 0) {
+        printf("f%d(", pick(callable));
+        emit_expr(prefix, count, depth - 1, 0);
+        printf(", ");
+        emit_expr(prefix, count, depth - 1, 0);
+        printf(")");
+    } else if (choice == 1) {
+        printf(pick(2) ? "-(" : "~(");
+        emit_expr(prefix, count, depth - 1, callable);
+        printf(")");
+    } else if (choice == 2) {
+        // constant shift counts keep the result defined
+        printf("(");
+        emit_expr(prefix, count, depth - 1, callable);
+        printf(" %s %d)", pick(2) ? "<<" : ">>", pick(8));
+    } else {
+        static const char* ops[] = { "+", "-", "*", "&", "|", "^", "+" };
+        printf("(");
+        emit_expr(prefix, count, depth - 1, callable);
+        printf(" %s ", ops[pick(sizeof(ops) / sizeof(ops[0]))]);
+        emit_expr(prefix, count, depth - 1, callable);
+        printf(")");
+    }
+}
+
+static void emit_condition(const char* prefix, int count, int depth, int callable) {
+    static const char* ops[] = { "<", ">", "<=", ">=", "==", "!=" };
+    emit_expr(prefix, count, depth / 2, callable);
+    printf(" %s ", ops[pick(sizeof(ops) / sizeof(ops[0]))]);
+    emit_expr(prefix, count, depth / 2, callable);
+}
+
+static void emit_block(const GenOptions* opts, int level, int nesting, int length);
+
+static void emit_statement(const GenOptions* opts, int level, int nesting) {
+    int callable = opts->functions;
+    int choice = pick(20);
+    budget--;
+    indent(level);
+    if (choice < 2) {
+        printf("print ");
+        emit_expr("v", opts->variables, opts->depth, callable);
+        printf(";\n");
+    } else if (choice < 5 && nesting > 0 && budget > 1) {
+        printf("if (");
+        emit_condition("v", opts->variables, opts->depth, callable);
+        printf(") {\n");
+        emit_block(opts, level + 1, nesting - 1, 1 + pick(4));
+        indent(level);
+        if (pick(2) && budget > 0) {
+            printf("} else {\n");
+            emit_block(opts, level + 1, nesting - 1, 1 + pick(3));
+            indent(level);
+        }
+        printf("}\n");
+    } else if (choice < 7 && nesting > 0 && budget > 2) {
+        // a counter of its own, so the loop runs a fixed, small number of times
+        int counter = counters++;
+        printf("int c%d = 0;\n", counter);
+        indent(level);
+        printf("while (c%d < %d) {\n", counter, 1 + pick(3));
+        emit_block(opts, level + 1, nesting - 1, 1 + pick(4));
+        indent(level + 1);
+        printf("c%d = c%d + 1;\n", counter, counter);
+        indent(level);
+        printf("}\n");
+    } else if (choice < 10 && callable > 0) {
+        printf("v%d = f%d(", pick(opts->variables), pick(callable));
+        emit_expr("v", opts->variables, opts->depth - 1, 0);
+        printf(", ");
+        emit_expr("v", opts->variables, opts->depth - 1, 0);
+        printf(");\n");
+    } else {
+        printf("v%d = ", pick(opts->variables));
+        emit_expr("v", opts->variables, opts->depth, callable);
+        printf(";\n");
+    }
+}
+
+static void emit_block(const GenOptions* opts, int level, int nesting, int length) {
+    for (int i = 0; i < length && budget > 0; i++) emit_statement(opts, level, nesting);
+}
+
+// f<index>(f<index>_0, f<index>_1) with two locals; calls only the
+// functions before it
+static void emit_function(const GenOptions* opts, int index) {
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "f%d_", index);
+    printf("int f%d(int %s0, int %s1) {\n", index, prefix, prefix);
+    for (int i = 2; i < 4; i++) {
+        printf("    int %s%d = ", prefix, i);
+        emit_expr(prefix, i, opts->depth, index);
+        printf(";\n");
+    }
+    printf("    if (");
+    emit_condition(prefix, 4, opts->depth, index);
+    printf(") {\n        %s2 = ", prefix);
+    emit_expr(prefix, 4, opts->depth, index);
+    printf(";\n    }\n    return ");
+    emit_expr(prefix, 4, opts->depth, index);
+    printf(";\n}\n\n");
+}
+
+static int parse_count(const char* arg, const char* name, int min, int* out) {
+    size_t len = strlen(name);
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=') return 0;
+    char* end;
+    long value = strtol(arg + len + 1, &end, 10);
+    if (*end != '\0' || end == arg + len + 1 || value < min || value > 10000000) {
+        fprintf(stderr, "Invalid %s '%s'\n", name + 2, arg + len + 1);
+        exit(EXIT_FAILURE);
+    }
+    *out = (int)value;
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    GenOptions opts = { 1, 100, 3, 2, 4, 8 };
+    for (int i = 1; i < argc; i++) {
+        int seed = 0;
+        if (parse_count(argv[i], "--seed", 0, &seed)) {
+            opts.seed = (unsigned long)seed;
+        } else if (!parse_count(argv[i], "--statements", 1, &opts.statements) &&
+                   !parse_count(argv[i], "--depth", 0, &opts.depth) &&
+                   !parse_count(argv[i], "--nesting", 0, &opts.nesting) &&
+                   !parse_count(argv[i], "--functions", 0, &opts.functions) &&
+                   !parse_count(argv[i], "--variables", 1, &opts.variables)) {
+            fprintf(stderr,
+                    "Usage: %s [--seed=N] [--statements=N] [--depth=N] [--nesting=N]\n"
+                    "          [--functions=N] [--variables=N]\n", argv[0]);
+            return 1;
+        }
+    }
+    rng_state = opts.seed * 0x9E3779B97F4A7C15ULL + 1;
+
+    printf("// progen --seed=%lu --statements=%d --depth=%d --nesting=%d --functions=%d --variables=%d\n\n",
+           opts.seed, opts.statements, opts.depth, opts.nesting, opts.functions, opts.variables);
+    for (int i = 0; i < opts.functions; i++) emit_function(&opts, i);
+
+    printf("int main() {\n");
+    for (int i = 0; i < opts.variables; i++) printf("    int v%d = %d;\n", i, pick(100));
+    budget = opts.statements;
+    while (budget > 0) emit_statement(&opts, 1, opts.nesting);
+    printf("    return v0 & 255;\n}\n");
+    return 0;
+}
@@ -0,0 +1,326 @@
+#include "codegen/cache.h"
+#include "codegen/codegen.h"
+#include "codegen/handlers.h"
+#include "codegen/helpers.h"
+#include "codegen/symbol.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// bump when the code generator changes what it emits for the same input
+#define CACHE_VERSION 1
+
+// two FNV-1a hashes from different offsets, 128 bits of key
+typedef struct {
+    uint64_t a;
+    uint64_t b;
+} Hash;
+
+static void hash_bytes(Hash* h, const void* data, size_t length) {
+    const unsigned char* p = data;
+    for (size_t i = 0; i < length; i++) {
+        h->a = (h->a ^ p[i]) * 0x100000001b3ULL;
+        h->b = (h->b ^ p[i]) * 0x100000001b3ULL;
+    }
+}
+
+static void hash_int(Hash* h, int64_t value) {
+    hash_bytes(h, &value, sizeof(value));
+}
+
+static void hash_str(Hash* h, const char* s) {
+    if (!s) {
+        hash_int(h, -1);
+        return;
+    }
+    hash_bytes(h, s, strlen(s) + 1);
+}
+
+// a variable's name and the storage its code is generated for
+static void hash_symbol(Hash* h, const char* name) {
+    hash_str(h, name);
+    Symbol* sym = lookup_symbol(name);
+    hash_str(h, sym ? sym->type : NULL);
+    hash_int(h, sym ? sym->size : -1);
+}
+
+// Everything code generation reads from the subtree. Lines only matter
+// when they end up in the code (-g) or select profile counts.
+static void hash_node(Hash* h, ASTNode* node, bool lines) {
+    if (!node) {
+        hash_int(h, -1);
+        return;
+    }
+    hash_int(h, node->type);
+    if (lines) hash_int(h, node->line);
+    switch (node->type) {
+        case NODE_FUNC:
+            hash_str(h, node->func.return_type);
+            hash_str(h, node->func.name);
+            hash_node(h, node->func.params, lines);
+            hash_node(h, node->func.body, lines);
+            break;
+        case NODE_CALL:
+            hash_str(h, node->func_call.func_name);
+            hash_node(h, node->func_call.args, lines);
+            break;
+        case NODE_PARAM:
+            hash_str(h, node->param.type);
+            hash_symbol(h, node->param.name);
+            break;
+        case NODE_PRINT:
+            hash_node(h, node->print_expr.expr, lines);
+            break;
+        case NODE_IF:
+            hash_node(h, node->control.condition, lines);
+            hash_node(h, node->control.if_body, lines);
+            hash_node(h, node->control.else_body, lines);
+            break;
+        case NODE_WHILE:
+            hash_node(h, node->control.condition, lines);
+            hash_node(h, node->control.loop_body, lines);
+            hash_int(h, node->control.vectorize);
+            break;
+        case NODE_RETURN:
+            hash_node(h, node->return_stmt.expr, lines);
+            hash_int(h, node->return_stmt.tail_call);
+            break;
+        case NODE_DECL:
+            hash_str(h, node->decl.type);
+            hash_symbol(h, node->decl.name);
+            hash_node(h, node->decl.init_expr, lines);
+            hash_int(h, node->decl.size);
+            break;
+        case NODE_ASSIGN:
+            hash_node(h, node->assign.target, lines);
+            hash_node(h, node->assign.value, lines);
+            break;
+        case NODE_BINOP:
+            hash_int(h, node->binop.op);
+            // fall through
+        case NODE_COMPOUND:
+            hash_node(h, node->binop.left, lines);
+            hash_node(h, node->binop.right, lines);
+            break;
+        case NODE_IDENT:
+            hash_symbol(h, node->str_value);
+            break;
+        case NODE_NUM:
+            hash_int(h, node->num_value);
+            break;
+        case NODE_STR:
+            hash_str(h, node->str_value);
+            break;
+        case NODE_UNOP:
+            hash_int(h, node->unop.op);
+            hash_node(h, node->unop.operand, lines);
+            break;
+        case NODE_SWITCH:
+            hash_node(h, node->switch_stmt.expr, lines);
+            hash_node(h, node->switch_stmt.cases, lines);
+            break;
+        case NODE_CASE:
+            hash_int(h, node->case_clause.value);
+            hash_int(h, node->case_clause.is_default);
+            hash_node(h, node->case_clause.body, lines);
+            break;
+        case NODE_INDEX:
+        case NODE_INDEX_ASSIGN:
+            hash_node(h, node->element.array, lines);
+            hash_node(h, node->element.index, lines);
+            hash_node(h, node->element.value, lines);
+            break;
+        default:
+            break;
+    }
+}
+
+// the flags that change the code of a function
+static Hash options_hash(const CompilerOptions* opts) {
+    Hash h = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL };
+    hash_int(&h, CACHE_VERSION);
+    hash_int(&h, opts->opt_level);
+    hash_int(&h, vector_isa);
+    hash_int(&h, opts->opt_level >= 1 ? opts->loop_align : 0);
+    hash_int(&h, opts->debug_info);
+    if (opts->debug_info) hash_str(&h, opts->input_file);
+    if (opts->profile_file) {
+        // its counts decide layouts and cold code
+        FILE* profile = fopen(opts->profile_file, "rb");
+        char buffer[4096];
+        size_t length;
+        while (profile && (length = fread(buffer, 1, sizeof(buffer), profile)) > 0) {
+            hash_bytes(&h, buffer, length);
+        }
+        if (profile) fclose(profile);
+    }
+    return h;
+}
+
+static char* entry_path(const char* dir, Hash key) {
+    size_t size = strlen(dir) + 48;
+    char* path = mem_alloc(size);
+    if (!path) {
+        out_of_memory("entry_path");
+    }
+    snprintf(path, size, "%s/%016llx%016llx.asm", dir, (unsigned long long)key.a, (unsigned long long)key.b);
+    return path;
+}
+
+// An entry is a `; <function> <microseconds to generate> <layout counts>`
+// line and the code. NULL when there is none for this function.
+static char* read_entry(const char* path, const char* function, long* micros, LayoutStats* layout) {
+    FILE* input = fopen(path, "rb");
+    if (!input) return NULL;
+    char header[320], name[256];
+    char* text = NULL;
+    if (fgets(header, sizeof(header), input) &&
+        sscanf(header, "; %255s %ld %d %d %d %d", name, micros, &layout->threaded,
+               &layout->inverted, &layout->removed, &layout->aligned) == 6 &&
+        strcmp(name, function) == 0) {
+        long start = ftell(input);
+        fseek(input, 0, SEEK_END);
+        long length = ftell(input) - start;
+        fseek(input, start, SEEK_SET);
+        text = mem_alloc(length + 1);
+        if (!text) {
+            out_of_memory("read_entry");
+        }
+        if (fread(text, 1, length, input) != (size_t)length) {
+            mem_free(text);
+            text = NULL;
+        } else {
+            text[length] = '\0';
+        }
+    }
+    fclose(input);
+    return text;
+}
+
+// written under a temporary name and renamed, so concurrent builds only
+// ever see whole entries; a cache that cannot be written is skipped
+static void write_entry(const char* path, const char* function, long micros,
+                        const LayoutStats* layout, const char* text) {
+    size_t size = strlen(path) + 32;
+    char* temporary = mem_alloc(size);
+    if (!temporary) {
+        out_of_memory("write_entry");
+    }
+    snprintf(temporary, size, "%s.%ld.tmp", path, (long)getpid());
+    FILE* output = fopen(temporary, "wb");
+    if (output) {
+        fprintf(output, "; %s %ld %d %d %d %d\n", function, micros, layout->threaded,
+                layout->inverted, layout->removed, layout->aligned);
+        fputs(text, output);
+        if (fclose(output) != 0 || rename(temporary, path) != 0) unlink(temporary);
+    }
+    mem_free(temporary);
+}
+
+static FILE* open_buffer(char** text, size_t* length) {
+    FILE* buffer = mem_stream(text, length);
+    if (!buffer) {
+        out_of_memory("open_buffer");
+    }
+    return buffer;
+}
+
+// The code of `func`, or of the entry point when it is NULL, with its
+// labels numbered from 0, laid out and followed by its strings.
+static char* generate_chunk(ASTNode* program, ASTNode* func, const CompilerOptions* opts, LayoutStats* stats) {
+    code_label_counter = data_label_counter = stack_depth = 0;
+    debug_line = -1;
+
+    char* data = NULL;
+    size_t data_length = 0;
+    FILE* data_buffer = open_buffer(&data, &data_length);
+    collect_print_messages(func ? func : program->program.main_block, data_buffer);
+    fclose(data_buffer);
+
+    char* code = NULL;
+    size_t code_length = 0;
+    FILE* code_buffer = open_buffer(&code, &code_length);
+    if (func) generate_code(func, code_buffer);
+    else emit_entry_point(program, code_buffer);
+    fclose(code_buffer);
+
+    char* chunk = NULL;
+    size_t chunk_length = 0;
+    FILE* chunk_buffer = open_buffer(&chunk, &chunk_length);
+    if (opts->opt_level >= 1) {
+        *stats = optimize_layout(code, opts->loop_align, chunk_buffer);
+    } else {
+        fputs(code, chunk_buffer);
+    }
+    if (data_length > 0) fprintf(chunk_buffer, "section .data\n%ssection .text\n", data);
+    fclose(chunk_buffer);
+    mem_free(code);
+    mem_free(data);
+    return chunk;
+}
+
+static void add_layout(LayoutStats* total, const LayoutStats* stats) {
+    total->threaded += stats->threaded;
+    total->inverted += stats->inverted;
+    total->removed += stats->removed;
+    total->aligned += stats->aligned;
+}
+
+static double elapsed_micros(const struct timespec* start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e6 + (end.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+CacheStats emit_text_section_cached(ASTNode* program, const CompilerOptions* opts,
+                                    LayoutStats* layout, FILE* output) {
+    CacheStats stats = {0, 0, 0};
+    if (mkdir(opts->cache_dir, 0755) != 0 && errno != EEXIST) {
+        report(DIAGNOSTIC_ERROR, 0, "%s: %s", opts->cache_dir, strerror(errno));
+        compile_abort();
+    }
+    Hash flags = options_hash(opts);
+    bool lines = opts->debug_info || opts->profile_file;
+
+    fprintf(output, "section .text\n");
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        ASTNode* func = f->binop.left;
+        Hash key = flags;
+        hash_node(&key, func, lines);
+        char* path = entry_path(opts->cache_dir, key);
+
+        long micros = 0;
+        LayoutStats chunk_layout = {0};
+        char* chunk = read_entry(path, func->func.name, &micros, &chunk_layout);
+        if (chunk) {
+            stats.hits++;
+            stats.saved_ms += micros / 1e3;
+        } else {
+            struct timespec start;
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            chunk_layout = (LayoutStats){0};
+            chunk = generate_chunk(program, func, opts, &chunk_layout);
+            write_entry(path, func->func.name, (long)elapsed_micros(&start), &chunk_layout, chunk);
+            stats.misses++;
+        }
+        add_layout(layout, &chunk_layout);
+        fputs(chunk, output);
+        mem_free(chunk);
+        mem_free(path);
+    }
+
+    LayoutStats entry_layout = {0};
+    char* entry = generate_chunk(program, NULL, opts, &entry_layout);
+    add_layout(layout, &entry_layout);
+    fputs(entry, output);
+    mem_free(entry);
+    return stats;
+}
@@ -2,7 +2,15 @@
 #include "codegen/handlers.h"
 #include "codegen/helpers.h"
 #include "codegen/symbol.h"
+#include "codegen/layout.h"
+#include "codegen/instrument.h"
+#include "codegen/cache.h"
 #include "parser/ast.h"
+#include "driver/stats.h"
+#include "driver/profile.h"
+#include "trace/trace.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,10 +18,35 @@
 
 int data_label_counter = 0;
 int code_label_counter = 0;
+int stack_depth = 0;
+bool select_instructions = false;
+VectorIsa vector_isa = VECTOR_NONE;
+bool debug_info = false;
+bool named_variables = false;
+const char* message_prefix = "msg";
+int debug_line = -1;
+static const char* source_name = "stdin";
+
+void emit_line_marker(int line, FILE* output) {
+    fprintf(output, "%%line %d+0 %s\n", line, source_name);
+    debug_line = line;
+}
 
 void generate_code(ASTNode* node, FILE* output) {
 
     if (!node) return;
+    // lists and the program span many lines; their statements mark their own
+    if (debug_info && node->line > 0 && node->line != debug_line &&
+        node->type != NODE_COMPOUND && node->type != NODE_PROGRAM) {
+        emit_line_marker(node->line, output);
+    }
+    if (trace_enabled(TRACE_CODEGEN)) {
+        const char* detail = NULL;
+        if (node->type == NODE_FUNC) detail = node->func.name;
+        else if (node->type == NODE_CALL) detail = node->func_call.func_name;
+        else if (node->type == NODE_IDENT) detail = node->str_value;
+        trace_event(TRACE_CODEGEN, 0, node_type_name(node->type), detail);
+    }
     switch (node->type) {
         case NODE_PROGRAM: {
             handle_program(node, output);
@@ -45,6 +78,9 @@ void generate_code(ASTNode* node, FILE* output) {
             handle_while(node, output);
             break;
         }
+        case NODE_SWITCH:
+            handle_switch(node, output);
+            break;
         case NODE_BREAK: {
             handle_break(node, output);
             break;
@@ -67,6 +103,12 @@ void generate_code(ASTNode* node, FILE* output) {
             handle_unop(node, output);
             break;
         }
+        case NODE_INDEX:
+            handle_index(node, output);
+            break;
+        case NODE_INDEX_ASSIGN:
+            handle_index_assign(node, output);
+            break;
         case NODE_COMPOUND:
             handle_compound(node, output);
             break;
@@ -75,26 +117,80 @@ void generate_code(ASTNode* node, FILE* output) {
     }
 }
 
-void generate_code_to_file(ASTNode* node) {
-
-    FILE* output = fopen("build/asm/program.asm", "w");
-    if (!output) {
-        perror("Failed to open output file");
-        exit(EXIT_FAILURE);
-    }
+void generate_code_to_stream(ASTNode* node, const CompilerOptions* opts, FILE* output) {
 
     // init state
-    data_label_counter = code_label_counter = 0;
+    data_label_counter = code_label_counter = stack_depth = 0;
+    select_instructions = opts->opt_level >= 1;
+    vector_isa = opts->opt_level >= 2 ? opts->vector_isa : VECTOR_NONE;
+    instrument = opts->instrument_file != NULL;
+    debug_info = opts->debug_info;
+    debug_line = -1;
+    // counters are numbered across the whole program, so instrumented
+    // builds bypass the cache
+    bool cached = opts->cache_dir && !instrument;
+    named_variables = debug_info || cached;
+    message_prefix = cached ? ".msg" : "msg";
+    source_name = opts->input_file ? opts->input_file : "stdin";
+    instrument_reset();
     init_symbol_table();
 
+    stats_begin(PHASE_COLLECT_VARIABLES, NULL);
     collect_variables(node);
+    if (profile_loaded()) weigh_variables(node);
+    stats_end(PHASE_COLLECT_VARIABLES);
+    if (trace_enabled(TRACE_SYMBOLS)) {
+        FILE* trace = trace_begin(TRACE_SYMBOLS, 0, "symbols");
+        print_symbol_table(trace);
+        trace_end(trace);
+    }
+    stats_begin(PHASE_VERIFY_SYMBOLS, NULL);
     verify_symbols(node);
-    
-    emit_data_section(node, output);
+    stats_end(PHASE_VERIFY_SYMBOLS);
+
+    stats_begin(PHASE_EMIT_DATA, output);
+    // cached functions carry their own strings
+    if (cached) fprintf(output, "section .data\n");
+    else emit_data_section(node, output);
+    stats_end(PHASE_EMIT_DATA);
+    stats_begin(PHASE_EMIT_BSS, output);
     emit_bss_section(output);
-    emit_text_section(node, output);
+    stats_end(PHASE_EMIT_BSS);
+    stats_begin(PHASE_EMIT_TEXT, output);
+    if (cached) {
+        LayoutStats layout = {0};
+        CacheStats cache = emit_text_section_cached(node, opts, &layout, output);
+        if (opts->opt_report) {
+            if (opts->opt_level >= 1) {
+                fprintf(stderr, "layout: %d jumps threaded, %d branches inverted, %d instructions removed, %d loops aligned\n",
+                        layout.threaded, layout.inverted, layout.removed, layout.aligned);
+            }
+            fprintf(stderr, "cache: %d hits, %d misses, %.3f ms saved\n", cache.hits, cache.misses, cache.saved_ms);
+        }
+    } else if (opts->opt_level >= 1) {
+        // the layout pass rewrites the text section as a whole
+        char* text = NULL;
+        size_t text_size = 0;
+        FILE* buffer = mem_stream(&text, &text_size);
+        if (!buffer) {
+            out_of_memory("generate_code_to_stream");
+        }
+        emit_text_section(node, buffer);
+        fclose(buffer);
+        LayoutStats layout = optimize_layout(text, opts->loop_align, output);
+        mem_free(text);
+        if (opts->opt_report) {
+            fprintf(stderr, "layout: %d jumps threaded, %d branches inverted, %d instructions removed, %d loops aligned\n",
+                    layout.threaded, layout.inverted, layout.removed, layout.aligned);
+        }
+    } else {
+        emit_text_section(node, output);
+    }
+    if (debug_info) emit_line_marker(0, output);
     emit_itoa(output);
+    if (instrument) emit_profile_dump(opts->instrument_file, output);
+    stats_end(PHASE_EMIT_TEXT);
 
-    fclose(output);
     free_symbol_table();
+    instrument_reset();
 }
\ No newline at end of file
@@ -1,106 +1,325 @@
 #include "codegen/handlers.h"
 #include "codegen/symbol.h"
 #include "codegen/helpers.h"
+#include "codegen/select.h"
+#include "codegen/vector.h"
+#include "codegen/instrument.h"
+#include "driver/profile.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
 
-void handle_program(ASTNode* node, FILE* output) {
+// Code the profile says never ran goes to its own section, away from the
+// hot code: whole functions are emitted there, and if arms are collected in
+// cold_code while their function is generated and appended after it.
+#define COLD_SECTION ".text.cold"
+
+static const char* text_section = ".text";     // the section code is going to
+static char* cold_code = NULL;
+static size_t cold_length = 0;
+
+static void flush_cold_code(FILE* output) {
+    if (cold_length == 0) return;
+    bool switch_section = strcmp(text_section, COLD_SECTION) != 0;
+    if (switch_section) fprintf(output, "\nsection %s\n", COLD_SECTION);
+    fwrite(cold_code, 1, cold_length, output);
+    if (switch_section) fprintf(output, "section %s\n", text_section);
+    debug_line = -1;    // the marker in force is the cold code's
+    mem_free(cold_code);
+    cold_code = NULL;
+    cold_length = 0;
+}
 
+void handle_program(ASTNode* node, FILE* output) {
     generate_code(node->program.functions, output);
+    emit_entry_point(node, output);
+}
 
-    fprintf(output, "global _start\n_start:\n");
+void emit_entry_point(ASTNode* node, FILE* output) {
+    if (debug_info) {
+        emit_line_marker(0, output);
+        fprintf(output, "global _start:function (_start.end - _start)\n_start:\n");
+    } else {
+        fprintf(output, "global _start\n_start:\n");
+    }
     
     if (has_main_function(node->program.functions)) { 
+        if (instrument) {
+            fprintf(output, "    call main\n    push rax\n    call profile_dump\n    pop rdi\n");
+        } else {
+            fprintf(output, "    call main\n    mov rdi, rax\n");
+        }
         fprintf(output,
-            "    call main\n"
-            "    mov rdi, rax\n"
             "    mov rax, 60\n"
             "    syscall\n");
+        if (debug_info) fprintf(output, ".end:\n");
     } else if (node->program.main_block) { 
+        if (instrument) emit_counter("func", "main", node->program.main_block->line, output);
         generate_code(node->program.main_block, output);
+        if (instrument) fprintf(output, "    call profile_dump\n");
         fprintf(output, "    mov rax, 60\n    xor rdi, rdi\n    syscall\n");
+        if (debug_info) fprintf(output, ".end:\n");
+        flush_cold_code(output);
     } else {
-        fprintf(stderr, "Error: No entry point (main function or MAIN block)\n");
-        exit(EXIT_FAILURE);
+        compile_error(0, "No entry point (main function or MAIN block)");
+    }
+}
+
+// System V AMD64: integer arguments in these registers, the rest on the stack
+static const char* arg_registers[] = { "rdi", "rsi", "rdx", "rcx", "r8", "r9" };
+#define ARG_REGISTERS 6
+
+// rbx is callee-saved and doubles as our scratch register; the extra
+// 8 bytes keep rsp 16-byte aligned inside the body
+static void emit_epilogue(FILE* output) {
+    fprintf(output,
+        "    mov rbx, [rbp - 8]\n"
+        "    mov rsp, rbp\n"
+        "    pop rbp\n"
+        "    ret\n\n");
+}
+
+static const ASTNode* current_function = NULL;
+
+// counters outside any function belong to the main block
+static const char* counter_function(void) {
+    return current_function ? current_function->func.name : "main";
+}
+
+static bool has_self_tail_call(ASTNode* node, const char* name) {
+    if (!node) return false;
+    switch (node->type) {
+        case NODE_RETURN:
+            return node->return_stmt.tail_call &&
+                   strcmp(node->return_stmt.expr->func_call.func_name, name) == 0;
+        case NODE_COMPOUND:
+            return has_self_tail_call(node->binop.left, name) ||
+                   has_self_tail_call(node->binop.right, name);
+        case NODE_IF:
+            return has_self_tail_call(node->control.if_body, name) ||
+                   has_self_tail_call(node->control.else_body, name);
+        case NODE_WHILE:
+            return has_self_tail_call(node->control.loop_body, name);
+        case NODE_SWITCH:
+            return has_self_tail_call(node->switch_stmt.cases, name);
+        case NODE_CASE:
+            return has_self_tail_call(node->case_clause.body, name);
+        default:
+            return false;
     }
 }
 
 void handle_function(ASTNode* node, FILE* output) {
+    bool cold = profile_cold("func", node->line);
+    if (cold) {
+        fprintf(output, "section %s\n", COLD_SECTION);
+        text_section = COLD_SECTION;
+    }
+    if (debug_info) {
+        // the size covers the hot part; cold arms are in their own section
+        fprintf(output, "global %s:function (%s.end - %s)\n", node->func.name, node->func.name, node->func.name);
+    } else {
+        fprintf(output, "global %s:function\n", node->func.name);
+    }
     fprintf(output, "%s:\n", node->func.name);
     fprintf(output, "    push rbp\n");
     fprintf(output, "    mov rbp, rsp\n");
+    fprintf(output, "    push rbx\n");
+    fprintf(output, "    sub rsp, 8\n");
+    stack_depth = 0;
+    current_function = node;
+
+    // self tail calls re-enter here with fresh arguments in the registers
+    bool self_tail = has_self_tail_call(node->func.body, node->func.name);
+    if (self_tail) {
+        fprintf(output, ".Ltail_%s:\n", node->func.name);
+    }
 
-    ASTNode* params = node->func.params;
-    int param_offset = 16;
-    while (params) {
-        if (params->type == NODE_COMPOUND) {
-            ASTNode* param_node = params->binop.left;
-            if (param_node->type == NODE_PARAM) {
-                Symbol* sym = lookup_symbol(param_node->param.name);
-                if (sym) {
-                    fprintf(output, "    mov rax, [rbp + %d]\n", param_offset);
-                    fprintf(output, "    mov [%s], rax\n", sym->label);
-                    param_offset += 8;
-                }
-            }
-            params = params->binop.right;
-        } else if (params->type == NODE_PARAM) {
-            Symbol* sym = lookup_symbol(params->param.name);
-            if (sym) {
-                fprintf(output, "    mov rax, [rbp + %d]\n", param_offset);
-                fprintf(output, "    mov [%s], rax\n", sym->label);
+    int index = 0;
+    for (ASTNode* params = node->func.params; params; params = params->binop.right) {
+        ASTNode* param_node = params->binop.left;
+        Symbol* sym = lookup_symbol(param_node->param.name);
+        if (sym) {
+            if (index < ARG_REGISTERS) {
+                emit_sized_store(sym->label, sym->type, arg_registers[index], output);
+            } else {
+                fprintf(output, "    mov rax, [rbp + %d]\n", 16 + 8 * (index - ARG_REGISTERS));
+                emit_sized_store(sym->label, sym->type, "rax", output);
             }
-            break;
-        } else {
-            break;
         }
+        index++;
     }
+    if (self_tail) {
+        fprintf(output, ".Lbody_%s:\n", node->func.name);
+    }
+    // after the tail call labels, so a tail call counts as an entry too
+    if (instrument) emit_counter("func", node->func.name, node->line, output);
 
     generate_code(node->func.body, output);
 
-    fprintf(output, "    mov rsp, rbp\n");
-    fprintf(output, "    pop rbp\n");
-    fprintf(output, "    ret\n\n");
+    emit_epilogue(output);
+    if (debug_info) fprintf(output, ".end:\n");
+    flush_cold_code(output);
+    if (cold) {
+        text_section = ".text";
+        fprintf(output, "section %s\n", text_section);
+    }
+    current_function = NULL;
 }
 
-void handle_call(ASTNode* node, FILE* output) {
+static int collect_call_args(ASTNode* node, ASTNode** args) {
     int arg_count = 0;
-    ASTNode* current_arg = node->func_call.args;
+    for (ASTNode* current = node->func_call.args; current; current = current->binop.right) {
+        if (arg_count == 256) {
+            compile_error(node->line, "Too many arguments in call to '%s'", node->func_call.func_name);
+        }
+        args[arg_count++] = current->binop.left;
+    }
+    return arg_count;
+}
 
-    while (current_arg) {
-        if (current_arg->type == NODE_COMPOUND) {
-            generate_code(current_arg->binop.left, output);
+// Evaluates the arguments in source order. The first six end up in their
+// registers, the rest in the outgoing area reserved when stack_depth was
+// reserve_depth.
+static void emit_call_arguments(ASTNode** args, int arg_count, int reserve_depth, FILE* output) {
+    // a register argument that is a constant, or a variable no later argument
+    // can modify, is loaded straight into its register at the end
+    bool direct[ARG_REGISTERS] = { false };
+    bool later_call = false;
+    for (int i = arg_count - 1; i >= 0; i--) {
+        if (i < ARG_REGISTERS) {
+            direct[i] = args[i]->type == NODE_NUM ||
+                        (args[i]->type == NODE_IDENT && !later_call);
+        }
+        later_call = later_call || contains_call(args[i]);
+    }
+
+    for (int i = 0; i < arg_count; i++) {
+        if (i < ARG_REGISTERS) {
+            if (direct[i]) continue;
+            generate_code(args[i], output);
             fprintf(output, "    push rax\n");
-            arg_count++;
-            current_arg = current_arg->binop.right;
+            stack_depth++;
         } else {
-            generate_code(current_arg, output);
-            fprintf(output, "    push rax\n");
-            arg_count++;
-            break;
+            generate_code(args[i], output);
+            int offset = 8 * ((i - ARG_REGISTERS) + (stack_depth - reserve_depth));
+            fprintf(output, "    mov [rsp + %d], rax\n", offset);
+        }
+    }
+
+    int register_args = arg_count < ARG_REGISTERS ? arg_count : ARG_REGISTERS;
+    for (int i = register_args - 1; i >= 0; i--) {
+        if (!direct[i]) {
+            fprintf(output, "    pop %s\n", arg_registers[i]);
+            stack_depth--;
         }
     }
+    for (int i = 0; i < register_args; i++) {
+        if (!direct[i]) continue;
+        if (select_instructions) {
+            select_load(arg_registers[i], args[i], output);
+        } else if (args[i]->type == NODE_NUM) {
+            fprintf(output, "    mov %s, %lld\n", arg_registers[i], (long long)args[i]->num_value);
+        } else {
+            Symbol* sym = lookup_symbol(args[i]->str_value);
+            emit_sized_load(arg_registers[i], sym->type, sym->label, output);
+        }
+    }
+}
+
+void handle_call(ASTNode* node, FILE* output) {
+    ASTNode* args[256];
+    int arg_count = collect_call_args(node, args);
+
+    // rsp must be 16-byte aligned at the call instruction
+    int stack_args = arg_count > ARG_REGISTERS ? arg_count - ARG_REGISTERS : 0;
+    int padding = (stack_depth + stack_args) % 2;
+    int reserved = stack_args + padding;
+    if (reserved > 0) {
+        fprintf(output, "    sub rsp, %d\n", reserved * 8);
+        stack_depth += reserved;
+    }
+
+    emit_call_arguments(args, arg_count, stack_depth, output);
 
     fprintf(output, "    call %s\n", node->func_call.func_name);
-    if (arg_count > 0) {
-        fprintf(output, "    add rsp, %d\n", arg_count * 8);
+    if (reserved > 0) {
+        fprintf(output, "    add rsp, %d\n", reserved * 8);
+        stack_depth -= reserved;
     }
 }
 
+// `return f(...)`: set up the arguments and jump, reusing the current frame.
+// Returns false when the call has to stay a call (stack arguments to another
+// function would overwrite our caller's frame).
+static bool emit_tail_call(ASTNode* call, FILE* output) {
+    ASTNode* args[256];
+    int arg_count = collect_call_args(call, args);
+    const char* name = call->func_call.func_name;
+    bool self = strcmp(name, current_function->func.name) == 0;
+
+    if (arg_count > ARG_REGISTERS) {
+        if (!self) return false;
+        // parameters are plain variables: store the new values and loop
+        for (int i = 0; i < arg_count; i++) {
+            generate_code(args[i], output);
+            fprintf(output, "    push rax\n");
+            stack_depth++;
+        }
+        ASTNode* params[256];
+        int param_count = 0;
+        for (ASTNode* p = current_function->func.params; p && param_count < 256; p = p->binop.right) {
+            params[param_count++] = p->binop.left;
+        }
+        for (int i = arg_count - 1; i >= 0; i--) {
+            fprintf(output, "    pop rax\n");
+            stack_depth--;
+            if (i < param_count) {
+                Symbol* sym = lookup_symbol(params[i]->param.name);
+                emit_sized_store(sym->label, sym->type, "rax", output);
+            }
+        }
+        fprintf(output, "    jmp .Lbody_%s\n\n", name);
+        return true;
+    }
+
+    emit_call_arguments(args, arg_count, stack_depth, output);
+    if (self) {
+        fprintf(output, "    jmp .Ltail_%s\n\n", name);
+    } else {
+        fprintf(output,
+            "    mov rbx, [rbp - 8]\n"
+            "    mov rsp, rbp\n"
+            "    pop rbp\n"
+            "    jmp %s\n\n", name);
+    }
+    return true;
+}
+
 void handle_num(ASTNode* node, FILE* output) {
-    fprintf(output, "    mov rax, %d\n", node->num_value);
+    // constants past 32 bits only fit the 64-bit immediate of `mov`
+    if (select_instructions && node->num_value >= INT32_MIN && node->num_value <= INT32_MAX) {
+        select_expr(node, output);
+        return;
+    }
+    fprintf(output, "    mov rax, %lld\n", (long long)node->num_value);
 }
 
 void handle_ident(ASTNode* node, FILE* output) {
     Symbol* sym = lookup_symbol(node->str_value);
     if (!sym) {
-        fprintf(stderr, "Error: Undefined variable '%s'\n", node->str_value);
-        exit(EXIT_FAILURE);
+        compile_error(node->line, "Undefined variable '%s'", node->str_value);
+    }
+    // narrower variables need an extending load, not a memory operand
+    if (select_instructions && type_size(sym->type) == 8) {
+        select_expr(node, output);
+        return;
     }
-    fprintf(output, "    mov rax, [%s]\n", sym->label);
+    emit_sized_load("rax", sym->type, sym->label, output);
 }
 
 void handle_print(ASTNode* node, FILE* output) {
@@ -108,14 +327,13 @@ void handle_print(ASTNode* node, FILE* output) {
     ASTNode* expr = node->print_expr.expr;
     if (expr->type == NODE_STR) {
         int len = (int)strlen(expr->str_value);
-        static int msg_ref_counter = 0;
         fprintf(output,
             "    mov rax, 1\n"
             "    mov rdi, 1\n"
-            "    mov rsi, msg%d\n"
+            "    mov rsi, %s%d\n"
             "    mov rdx, %d\n"
             "    syscall\n",
-            msg_ref_counter++, len + 1);
+            message_prefix, node->print_expr.message, len + 1);
     } else {
         generate_code(expr, output);
         fprintf(output,
@@ -124,7 +342,7 @@ void handle_print(ASTNode* node, FILE* output) {
             "    mov rsi, print_buffer\n"
             "    call itoa\n"
             "    mov rsi, print_buffer\n"
-            "    add rsi, 20\n"
+            "    add rsi, 24\n"
             "    sub rsi, rax\n"
             "    mov rdx, rax\n"
             "    mov rax, 1\n"
@@ -135,25 +353,98 @@ void handle_print(ASTNode* node, FILE* output) {
 }
 
 void handle_decl(ASTNode* node, FILE* output) {
+    if (node->decl.size > 0) return;   // storage is reserved in .bss
     Symbol* sym = add_symbol(node->decl.name, NULL, node->decl.type);
-    if (node->decl.init_expr) {
+    if (node->decl.init_expr && select_instructions) {
+        select_store(sym, node->decl.init_expr, output);
+    } else if (node->decl.init_expr) {
         generate_code(node->decl.init_expr, output);
-        fprintf(output, "    mov [%s], rax\n", sym->label);
+        emit_sized_store(sym->label, sym->type, "rax", output);
     }
 }
 
 void handle_assign(ASTNode* node, FILE* output) {
     if (node->assign.target->type != NODE_IDENT) {
-        fprintf(stderr, "Error: Assignment target must be an identifier\n");
-        exit(EXIT_FAILURE);
+        compile_error(node->line, "Assignment target must be an identifier");
     }
     Symbol* sym = lookup_symbol(node->assign.target->str_value);
     if (!sym) {
-        fprintf(stderr, "Error: Variable '%s' not declared\n", node->assign.target->str_value);
-        exit(EXIT_FAILURE);
+        compile_error(node->line, "Variable '%s' not declared", node->assign.target->str_value);
+    }
+    if (select_instructions) {
+        select_store(sym, node->assign.value, output);
+        return;
     }
     generate_code(node->assign.value, output);
-    fprintf(output, "    mov [%s], rax\n", sym->label);
+    emit_sized_store(sym->label, sym->type, "rax", output);
+}
+
+static Symbol* array_symbol(ASTNode* node) {
+    Symbol* sym = lookup_symbol(node->element.array->str_value);
+    if (!sym || sym->size == 0) {
+        compile_error(node->line, "'%s' is not an array", node->element.array->str_value);
+    }
+    return sym;
+}
+
+// Elements are packed at the size of the array's type from its label on;
+// the index is not checked at run time.
+void handle_index(ASTNode* node, FILE* output) {
+    Symbol* sym = array_symbol(node);
+    ASTNode* index = node->element.index;
+    int size = type_size(sym->type);
+    char address[96];
+    if (select_instructions && index->type == NODE_NUM) {
+        snprintf(address, sizeof(address), "%s + %lld", sym->label, (long long)index->num_value * size);
+        emit_sized_load("rax", sym->type, address, output);
+        return;
+    }
+    if (select_instructions && index->type == NODE_BINOP && index->binop.right->type == NODE_NUM &&
+        (index->binop.op == OP_ADD || index->binop.op == OP_SUB)) {
+        // a[i ± c]: the constant goes into the displacement
+        long long offset = (long long)index->binop.right->num_value * size;
+        generate_code(index->binop.left, output);
+        snprintf(address, sizeof(address), "%s + rax*%d %c %lld", sym->label, size,
+                 (index->binop.op == OP_ADD) == (offset >= 0) ? '+' : '-', offset >= 0 ? offset : -offset);
+        emit_sized_load("rax", sym->type, address, output);
+        return;
+    }
+    generate_code(index, output);
+    snprintf(address, sizeof(address), "%s + rax*%d", sym->label, size);
+    emit_sized_load("rax", sym->type, address, output);
+}
+
+void handle_index_assign(ASTNode* node, FILE* output) {
+    Symbol* sym = array_symbol(node);
+    ASTNode* index = node->element.index;
+    ASTNode* value = node->element.value;
+    int size = type_size(sym->type);
+    char address[96];
+    if (select_instructions && index->type == NODE_NUM) {
+        snprintf(address, sizeof(address), "%s + %lld", sym->label, (long long)index->num_value * size);
+        if (value->type == NODE_NUM) {
+            emit_constant_store(address, sym->type, value->num_value, output);
+        } else {
+            generate_code(value, output);
+            emit_sized_store(address, sym->type, "rax", output);
+        }
+        return;
+    }
+    if (select_instructions && index->type == NODE_IDENT && !contains_call(value)) {
+        // nothing in the value can store to the index variable
+        generate_code(value, output);
+        Symbol* index_sym = lookup_symbol(index->str_value);
+        emit_sized_load("rcx", index_sym->type, index_sym->label, output);
+    } else {
+        generate_code(index, output);
+        fprintf(output, "    push rax\n");
+        stack_depth++;
+        generate_code(value, output);
+        fprintf(output, "    pop rcx\n");
+        stack_depth--;
+    }
+    snprintf(address, sizeof(address), "%s + rcx*%d", sym->label, size);
+    emit_sized_store(address, sym->type, "rax", output);
 }
 
 void handle_compound(ASTNode* node, FILE* output) {
@@ -161,64 +452,294 @@ void handle_compound(ASTNode* node, FILE* output) {
     generate_code(node->binop.right, output);
 }
 
+// the last statement of a block is a return or break, so control never
+// falls out of it
+static bool ends_in_jump(ASTNode* node) {
+    while (node && node->type == NODE_COMPOUND) {
+        node = node->binop.right ? node->binop.right : node->binop.left;
+    }
+    return node && (node->type == NODE_RETURN || node->type == NODE_BREAK);
+}
+
+// jumps to .L<prefix><number> when the condition's truth equals `when`
+static void emit_branch(ASTNode* cond, bool when, const char* prefix, int number, FILE* output) {
+    char label[32];
+    snprintf(label, sizeof(label), ".L%s%d", prefix, number);
+    if (select_instructions) {
+        select_branch(cond, when, label, output);
+    } else {
+        generate_code(cond, output);
+        fprintf(output, "    cmp rax, 0\n");
+        fprintf(output, "    %s %s\n", when ? "jne" : "je", label);
+    }
+}
+
+// .Lcold<label> runs `arm` and jumps back to .Lend<label>
+static void emit_cold_arm(ASTNode* arm, int label) {
+    char* text = NULL;
+    size_t length = 0;
+    FILE* buffer = mem_stream(&text, &length);
+    if (!buffer) {
+        out_of_memory("emit_cold_arm");
+    }
+    const char* outer_section = text_section;
+    int outer_line = debug_line;
+    text_section = COLD_SECTION;
+    debug_line = -1;
+    fprintf(buffer, ".Lcold%d:\n", label);
+    generate_code(arm, buffer);
+    if (!ends_in_jump(arm)) fprintf(buffer, "    jmp .Lend%d\n", label);
+    fprintf(buffer, "\n");
+    fclose(buffer);
+    text_section = outer_section;
+    debug_line = outer_line;
+
+    // arms nested in this one were appended while it was generated
+    cold_code = mem_realloc(cold_code, cold_length + length + 1);
+    if (!cold_code) {
+        out_of_memory("emit_cold_arm");
+    }
+    memcpy(cold_code + cold_length, text, length + 1);
+    cold_length += length;
+    mem_free(text);
+}
+
+// With a profile the arm that ran more often falls through; an arm that
+// never ran while the other did moves to the cold section.
+static bool emit_profiled_if(ASTNode* node, int label, FILE* output) {
+    long then_count = profile_count("then", node->line);
+    long else_count = profile_count("else", node->line);
+    ASTNode* cond = node->control.condition;
+
+    if (then_count == 0 && else_count > 0) {
+        emit_branch(cond, true, "cold", label, output);
+        fprintf(output, "\n");
+        generate_code(node->control.else_body, output);
+        fprintf(output, ".Lend%d:\n\n", label);
+        emit_cold_arm(node->control.if_body, label);
+        return true;
+    }
+    if (else_count == 0 && then_count > 0 && node->control.else_body) {
+        emit_branch(cond, false, "cold", label, output);
+        fprintf(output, "\n");
+        generate_code(node->control.if_body, output);
+        fprintf(output, ".Lend%d:\n\n", label);
+        emit_cold_arm(node->control.else_body, label);
+        return true;
+    }
+    if (else_count > then_count && node->control.else_body) {
+        emit_branch(cond, true, "then", label, output);
+        fprintf(output, "\n");
+        generate_code(node->control.else_body, output);
+        if (!ends_in_jump(node->control.else_body)) {
+            fprintf(output, "    jmp .Lend%d\n", label);
+        }
+        fprintf(output, ".Lthen%d:\n", label);
+        generate_code(node->control.if_body, output);
+        fprintf(output, ".Lend%d:\n\n", label);
+        return true;
+    }
+    return false;
+}
+
 void handle_if(ASTNode* node, FILE* output) {
     int current_label = code_label_counter;
     code_label_counter += 2;
 
-    generate_code(node->control.condition, output);
-    fprintf(output, "    cmp rax, 0\n");
-    fprintf(output, "    je .Lelse%d\n\n", current_label);
+    if (instrument) {
+        // each arm gets a counter, so the missing else becomes an empty one
+        emit_branch(node->control.condition, false, "else", current_label, output);
+        fprintf(output, "\n");
+        emit_counter("then", counter_function(), node->line, output);
+        generate_code(node->control.if_body, output);
+        if (!ends_in_jump(node->control.if_body)) {
+            fprintf(output, "    jmp .Lend%d\n", current_label);
+        }
+        fprintf(output, ".Lelse%d:\n", current_label);
+        emit_counter("else", counter_function(), node->line, output);
+        generate_code(node->control.else_body, output);
+        fprintf(output, ".Lend%d:\n\n", current_label);
+        return;
+    }
+    if (emit_profiled_if(node, current_label, output)) return;
+
+    if (!node->control.else_body) {
+        emit_branch(node->control.condition, false, "end", current_label, output);
+        fprintf(output, "\n");
+        generate_code(node->control.if_body, output);
+        fprintf(output, ".Lend%d:\n\n", current_label);
+        return;
+    }
 
+    emit_branch(node->control.condition, false, "else", current_label, output);
+    fprintf(output, "\n");
     generate_code(node->control.if_body, output);
-    fprintf(output, "    jmp .Lend%d\n", current_label);
+    if (!ends_in_jump(node->control.if_body)) {
+        fprintf(output, "    jmp .Lend%d\n", current_label);
+    }
 
     fprintf(output, ".Lelse%d:\n", current_label);
-    if (node->control.else_body) {
-        generate_code(node->control.else_body, output);
-    }
+    generate_code(node->control.else_body, output);
 
     fprintf(output, ".Lend%d:\n\n", current_label);
 }
 
+// end label of the innermost loop or switch being emitted, for `break`
+static int break_label = -1;
+
+void handlers_reset(void) {
+    mem_free(cold_code);
+    cold_code = NULL;
+    cold_length = 0;
+    text_section = ".text";
+    current_function = NULL;
+    break_label = -1;
+}
+
+// Loops are rotated: the condition is tested once on entry and again at the
+// bottom, so each iteration takes a single conditional branch back.
 void handle_while(ASTNode* node, FILE* output) {
     int start_label = code_label_counter++;
     int end_label = code_label_counter++;
-    
+    int outer_break_label = break_label;
+    break_label = end_label;
+
+    // the scalar loop below runs whatever iterations the vector loop leaves;
+    // instrumented loops stay scalar so every iteration is counted
+    if (node->control.vectorize && vector_isa != VECTOR_NONE && !instrument) emit_vector_loop(node, output);
+
+    emit_branch(node->control.condition, false, "end", end_label, output);
+    fprintf(output, "\n");
+
     fprintf(output, ".Lwhile%d:\n", start_label);
-    generate_code(node->control.condition, output);
-    
-    fprintf(output, "    cmp rax, 0\n");
-    fprintf(output, "    je .Lend%d\n\n", end_label);
-    
+    if (instrument) emit_counter("loop", counter_function(), node->line, output);
     generate_code(node->control.loop_body, output);
-    
-    fprintf(output, "    jmp .Lwhile%d\n", start_label);
+
+    emit_branch(node->control.condition, true, "while", start_label, output);
     fprintf(output, ".Lend%d:\n\n", end_label);
+
+    break_label = outer_break_label;
 }
 
 void handle_break(ASTNode* node, FILE* output) {
-    fprintf(output, "    jmp .Lend%d\n", code_label_counter - 1);
+    if (break_label < 0) {
+        compile_error(node->line, "'break' outside of a loop or switch");
+    }
+    fprintf(output, "    jmp .Lend%d\n", break_label);
+}
+
+// Dense case values index a table of case addresses in .rodata after one
+// unsigned bounds check; values below the first case wrap around and fail
+// it too.
+static void emit_jump_table(const CaseLabel* labels, int count, int first_case,
+                            const char* fallback, FILE* output) {
+    int table = code_label_counter++;
+    int low = labels[0].value;
+    int span = labels[count - 1].value - low;
+    if (low != 0) fprintf(output, "    sub rax, %d\n", low);
+    fprintf(output, "    cmp rax, %d\n", span);
+    fprintf(output, "    ja %s\n", fallback);
+    fprintf(output, "    jmp [.Ltable%d + rax*8]\n", table);
+
+    fprintf(output, "section .rodata\n");
+    fprintf(output, "align 8\n");
+    fprintf(output, ".Ltable%d:\n", table);
+    for (int i = 0, value = low; value <= low + span; value++) {
+        if (labels[i].value == value) {
+            fprintf(output, "    dq .Lcase%d\n", first_case + labels[i++].index);
+        } else {
+            fprintf(output, "    dq %s\n", fallback);
+        }
+    }
+    fprintf(output, "section %s\n", text_section);
+}
+
+// Sparse case values: a binary search on the sorted values, finishing with
+// a short run of compares.
+static void emit_case_search(const CaseLabel* labels, int count, int first_case,
+                             const char* fallback, FILE* output) {
+    if (count <= 3) {
+        for (int i = 0; i < count; i++) {
+            fprintf(output, "    cmp rax, %d\n", labels[i].value);
+            fprintf(output, "    je .Lcase%d\n", first_case + labels[i].index);
+        }
+        fprintf(output, "    jmp %s\n", fallback);
+        return;
+    }
+    int mid = count / 2;
+    int upper = code_label_counter++;
+    fprintf(output, "    cmp rax, %d\n", labels[mid].value);
+    fprintf(output, "    je .Lcase%d\n", first_case + labels[mid].index);
+    fprintf(output, "    jg .Lsearch%d\n", upper);
+    emit_case_search(labels, mid, first_case, fallback, output);
+    fprintf(output, ".Lsearch%d:\n", upper);
+    emit_case_search(labels + mid + 1, count - mid - 1, first_case, fallback, output);
+}
+
+// Cases fall through into the next one; `break` leaves the switch.
+void handle_switch(ASTNode* node, FILE* output) {
+    CaseLabel* labels;
+    int default_index;
+    int count = collect_case_labels(node, &labels, &default_index);
+    int clauses = 0;
+    for (ASTNode* c = node->switch_stmt.cases; c; c = c->binop.right) clauses++;
+
+    // .Lcase<first_case + i> starts clause i
+    int first_case = code_label_counter;
+    int end_label = first_case + clauses;
+    code_label_counter += clauses + 1;
+    char fallback[32];
+    if (default_index >= 0) {
+        snprintf(fallback, sizeof(fallback), ".Lcase%d", first_case + default_index);
+    } else {
+        snprintf(fallback, sizeof(fallback), ".Lend%d", end_label);
+    }
+
+    generate_code(node->switch_stmt.expr, output);
+    if (dense_case_labels(labels, count)) {
+        emit_jump_table(labels, count, first_case, fallback, output);
+    } else {
+        emit_case_search(labels, count, first_case, fallback, output);
+    }
+    mem_free(labels);
+
+    int outer_break_label = break_label;
+    break_label = end_label;
+    int index = 0;
+    for (ASTNode* c = node->switch_stmt.cases; c; c = c->binop.right, index++) {
+        fprintf(output, ".Lcase%d:\n", first_case + index);
+        generate_code(c->binop.left->case_clause.body, output);
+    }
+    fprintf(output, ".Lend%d:\n\n", end_label);
+    break_label = outer_break_label;
 }
 
 void handle_return(ASTNode* node, FILE* output) {
+    if (node->return_stmt.tail_call && current_function &&
+        emit_tail_call(node->return_stmt.expr, output)) {
+        return;
+    }
     if (node->return_stmt.expr) {
         generate_code(node->return_stmt.expr, output);
     } else {
-        fprintf(output, "    xor rax, rax\n");
+        fprintf(output, select_instructions ? "    xor eax, eax\n" : "    xor rax, rax\n");
     }
-    fprintf(output,
-        "    mov rsp, rbp\n"
-        "    pop rbp\n"
-        "    ret\n\n");
+    emit_epilogue(output);
 }
 
 void handle_binop(ASTNode* node, FILE* output) {
-    
+    if (select_instructions) {
+        select_expr(node, output);
+        return;
+    }
+
     generate_code(node->binop.left, output);
     fprintf(output, "    push rax\n");
+    stack_depth++;
     
     generate_code(node->binop.right, output);
     fprintf(output, "    pop rbx\n");
+    stack_depth--;
 
     switch (node->binop.op) {
         case OP_ADD:
@@ -275,34 +796,22 @@ void handle_binop(ASTNode* node, FILE* output) {
             fprintf(output, "    movzx rax, al\n");
             break;
         case OP_LAND:
-            generate_code(node->binop.left, output);
-            fprintf(output, "    cmp rax, 0\n");
-            fprintf(output, "    setne al\n");
-            fprintf(output, "    movzx rax, al\n");
-            fprintf(output, "    push rax\n");
-
-            generate_code(node->binop.right, output);
+            // both operands are already evaluated; normalise each to 0/1
+            fprintf(output, "    cmp rbx, 0\n");
+            fprintf(output, "    setne bl\n");
             fprintf(output, "    cmp rax, 0\n");
             fprintf(output, "    setne al\n");
+            fprintf(output, "    and al, bl\n");
             fprintf(output, "    movzx rax, al\n");
-
-            fprintf(output, "    pop rbx\n");
-            fprintf(output, "    and rax, rbx\n");
             break;
         case OP_LOR:
-            generate_code(node->binop.left, output);
-            fprintf(output, "    cmp rax, 0\n");
-            fprintf(output, "    setne al\n");
-            fprintf(output, "    movzx rax, al\n");
-            fprintf(output, "    push rax\n");
-
-            generate_code(node->binop.right, output);
+            // both operands are already evaluated; normalise each to 0/1
+            fprintf(output, "    cmp rbx, 0\n");
+            fprintf(output, "    setne bl\n");
             fprintf(output, "    cmp rax, 0\n");
             fprintf(output, "    setne al\n");
+            fprintf(output, "    or al, bl\n");
             fprintf(output, "    movzx rax, al\n");
-
-            fprintf(output, "    pop rbx\n");
-            fprintf(output, "    or rax, rbx\n");
             break;
         case OP_BAND:
             fprintf(output, "    and rax, rbx\n");
@@ -342,6 +851,10 @@ void handle_binop(ASTNode* node, FILE* output) {
 }
 
 void handle_unop(ASTNode* node, FILE* output) {
+    if (select_instructions) {
+        select_expr(node, output);
+        return;
+    }
     generate_code(node->unop.operand, output);
     switch (node->unop.op) {
         case OP_LNOT:
@@ -1,5 +1,8 @@
 #include "codegen/helpers.h"
 #include "codegen/symbol.h"
+#include "driver/profile.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -25,19 +28,39 @@ void verify_symbols(ASTNode* node) {
     if (!node) return;
     
     switch (node->type) {
-        case NODE_IDENT:
-            if (!lookup_symbol(node->str_value)) {
-                fprintf(stderr, "Error: Undefined variable '%s'\n", node->str_value);
-                exit(EXIT_FAILURE);
+        case NODE_IDENT: {
+            Symbol* sym = lookup_symbol(node->str_value);
+            if (!sym) {
+                compile_error(node->line, "Undefined variable '%s'", node->str_value);
+            }
+            if (sym->size > 0) {
+                compile_error(node->line, "Array '%s' used without an index", node->str_value);
             }
             break;
+        }
+        case NODE_INDEX:
+        case NODE_INDEX_ASSIGN: {
+            const char* name = node->element.array->str_value;
+            Symbol* sym = lookup_symbol(name);
+            if (!sym) {
+                compile_error(node->line, "Undefined variable '%s'", name);
+            }
+            if (sym->size == 0) {
+                compile_error(node->line, "'%s' is not an array", name);
+            }
+            ASTNode* index = node->element.index;
+            if (index->type == NODE_NUM && index->num_value >= sym->size) {
+                compile_error(node->line, "Index %lld out of bounds for array '%s'",
+                        (long long)index->num_value, name);
+            }
+            verify_symbols(index);
+            verify_symbols(node->element.value);
+            break;
+        }
             
         case NODE_ASSIGN:
             if (node->assign.target->type == NODE_IDENT) {
-                if (!lookup_symbol(node->assign.target->str_value)) {
-                    fprintf(stderr, "Error: Undefined variable '%s'\n", node->assign.target->str_value);
-                    exit(EXIT_FAILURE);
-                }
+                verify_symbols(node->assign.target);
             }
             verify_symbols(node->assign.value);
             break;
@@ -76,6 +99,13 @@ void verify_symbols(ASTNode* node) {
             verify_symbols(node->control.condition);
             verify_symbols(node->control.loop_body);
             break;
+        case NODE_SWITCH:
+            verify_symbols(node->switch_stmt.expr);
+            verify_symbols(node->switch_stmt.cases);
+            break;
+        case NODE_CASE:
+            verify_symbols(node->case_clause.body);
+            break;
         case NODE_RETURN:
             if (node->return_stmt.expr) {
                 verify_symbols(node->return_stmt.expr);
@@ -102,7 +132,8 @@ void collect_print_messages(ASTNode* node, FILE* output) {
     switch (node->type) {
         case NODE_PRINT:
             if (node->print_expr.expr && node->print_expr.expr->type == NODE_STR) {
-                fprintf(output, "msg%d db \"%s\", 0xA\n", data_label_counter++, 
+                node->print_expr.message = data_label_counter;
+                fprintf(output, "%s%d db \"%s\", 0xA\n", message_prefix, data_label_counter++, 
                         node->print_expr.expr->str_value);
             }
             break;
@@ -123,6 +154,12 @@ void collect_print_messages(ASTNode* node, FILE* output) {
         case NODE_WHILE:
             collect_print_messages(node->control.loop_body, output);
             break;
+        case NODE_SWITCH:
+            collect_print_messages(node->switch_stmt.cases, output);
+            break;
+        case NODE_CASE:
+            collect_print_messages(node->case_clause.body, output);
+            break;
         case NODE_FUNC:
             collect_print_messages(node->func.body, output);
             break;
@@ -135,14 +172,26 @@ void emit_data_section(ASTNode* node, FILE* output) {
 }
 
 // BSS Section Helpers
+// a name has one storage location, so every declaration must agree on it
+static void check_declaration(Symbol* sym, const char* type) {
+    if (sym->size > 0 || type_size(sym->type) != type_size(type) ||
+        type_is_signed(sym->type) != type_is_signed(type)) {
+        compile_error(0, "Conflicting declarations of '%s'", sym->name);
+    }
+}
+
 void collect_variables(ASTNode* node) {
     if (!node) return;
     switch (node->type) {
         case NODE_DECL:
-            add_symbol(node->decl.name, NULL, node->decl.type);
+            if (node->decl.size > 0) {
+                add_array_symbol(node->decl.name, node->decl.type, node->decl.size);
+            } else {
+                check_declaration(add_symbol(node->decl.name, NULL, node->decl.type), node->decl.type);
+            }
             break;
         case NODE_PARAM:
-            add_symbol(node->param.name, NULL, node->param.type);
+            check_declaration(add_symbol(node->param.name, NULL, node->param.type), node->param.type);
             break;
         case NODE_FUNC:
             collect_variables(node->func.params);
@@ -159,7 +208,7 @@ void collect_variables(ASTNode* node) {
             break;
         */
     }
-    if (node->type == NODE_COMPOUND || node->type == NODE_ASSIGN || node->type == NODE_DECL) {
+    if (node->type == NODE_COMPOUND || node->type == NODE_ASSIGN) {
         collect_variables(node->binop.left);
         collect_variables(node->binop.right);
     } else if (node->type == NODE_IF) {
@@ -167,19 +216,272 @@ void collect_variables(ASTNode* node) {
         collect_variables(node->control.else_body);
     } else if (node->type == NODE_WHILE) {
         collect_variables(node->control.loop_body);
+    } else if (node->type == NODE_SWITCH) {
+        collect_variables(node->switch_stmt.cases);
+    } else if (node->type == NODE_CASE) {
+        collect_variables(node->case_clause.body);
+    }
+}
+
+// `weight` is the count of the innermost function, loop or if arm with an
+// entry in the profile
+static void weigh_uses(ASTNode* node, long weight) {
+    if (!node) return;
+    long count;
+    switch (node->type) {
+        case NODE_IDENT: {
+            Symbol* sym = lookup_symbol(node->str_value);
+            if (sym) sym->heat += weight;
+            break;
+        }
+        case NODE_PROGRAM:
+            weigh_uses(node->program.functions, weight);
+            count = profile_count("func", node->program.main_block ? node->program.main_block->line : 0);
+            weigh_uses(node->program.main_block, count >= 0 ? count : weight);
+            break;
+        case NODE_FUNC:
+            count = profile_count("func", node->line);
+            weigh_uses(node->func.body, count >= 0 ? count : weight);
+            break;
+        case NODE_CALL:
+            weigh_uses(node->func_call.args, weight);
+            break;
+        case NODE_PRINT:
+            weigh_uses(node->print_expr.expr, weight);
+            break;
+        case NODE_IF:
+            weigh_uses(node->control.condition, weight);
+            count = profile_count("then", node->line);
+            weigh_uses(node->control.if_body, count >= 0 ? count : weight);
+            count = profile_count("else", node->line);
+            weigh_uses(node->control.else_body, count >= 0 ? count : weight);
+            break;
+        case NODE_WHILE:
+            count = profile_count("loop", node->line);
+            weigh_uses(node->control.condition, count >= 0 ? count : weight);
+            weigh_uses(node->control.loop_body, count >= 0 ? count : weight);
+            break;
+        case NODE_SWITCH:
+            weigh_uses(node->switch_stmt.expr, weight);
+            weigh_uses(node->switch_stmt.cases, weight);
+            break;
+        case NODE_CASE:
+            weigh_uses(node->case_clause.body, weight);
+            break;
+        case NODE_RETURN:
+            weigh_uses(node->return_stmt.expr, weight);
+            break;
+        case NODE_DECL: {
+            Symbol* sym = lookup_symbol(node->decl.name);
+            if (sym) sym->heat += weight;
+            weigh_uses(node->decl.init_expr, weight);
+            break;
+        }
+        case NODE_ASSIGN:
+            weigh_uses(node->assign.target, weight);
+            weigh_uses(node->assign.value, weight);
+            break;
+        case NODE_BINOP:
+        case NODE_COMPOUND:
+            weigh_uses(node->binop.left, weight);
+            weigh_uses(node->binop.right, weight);
+            break;
+        case NODE_UNOP:
+            weigh_uses(node->unop.operand, weight);
+            break;
+        case NODE_INDEX:
+        case NODE_INDEX_ASSIGN:
+            weigh_uses(node->element.array, weight);
+            weigh_uses(node->element.index, weight);
+            weigh_uses(node->element.value, weight);
+            break;
+        default:
+            break;
     }
 }
 
+void weigh_variables(ASTNode* node) {
+    weigh_uses(node, 1);
+}
+
+static const char* reserve_directive(int size) {
+    switch (size) {
+        case 1:  return "resb";
+        case 2:  return "resw";
+        case 4:  return "resd";
+        default: return "resq";
+    }
+}
+
+static int compare_heat(const void* a, const void* b) {
+    const Symbol* x = *(const Symbol* const*)a;
+    const Symbol* y = *(const Symbol* const*)b;
+    if (x->heat != y->heat) return x->heat < y->heat ? 1 : -1;
+    return y->index - x->index;     // the table's own order, newest first
+}
+
+// Arrays come first, each on a 32-byte boundary for the vector loops; the
+// scalars follow from the widest down, so each is naturally aligned
+// without padding. Within a width the hottest variables come first, so
+// with a profile they share cache lines.
 void emit_bss_section(FILE* output) {
     fprintf(output, "section .bss\n");
-    fprintf(output, "print_buffer: resb 20\n");
-    Symbol* sym = get_symbol_table();
-    while (sym) {
-        fprintf(output, "%s: resq 1\n", sym->label);
-        sym = sym->next;
+    fprintf(output, "print_buffer: resb 24   ; sign, 19 digits and the newline\n");
+    for (Symbol* sym = get_symbol_table(); sym; sym = sym->next) {
+        if (sym->size > 0) {
+            fprintf(output, "alignb 32\n%s: %s %d\n", sym->label,
+                    reserve_directive(type_size(sym->type)), sym->size);
+        }
+    }
+    fprintf(output, "alignb 8\n");
+    Symbol** scalars = mem_alloc((symbol_count() + 1) * sizeof(Symbol*));
+    if (!scalars) {
+        out_of_memory("emit_bss_section");
+    }
+    for (int size = 8; size >= 1; size /= 2) {
+        int count = 0;
+        for (Symbol* sym = get_symbol_table(); sym; sym = sym->next) {
+            if (sym->size == 0 && type_size(sym->type) == size) scalars[count++] = sym;
+        }
+        qsort(scalars, count, sizeof(Symbol*), compare_heat);
+        for (int i = 0; i < count; i++) {
+            fprintf(output, "%s: %s 1\n", scalars[i]->label, reserve_directive(size));
+        }
+    }
+    mem_free(scalars);
+}
+
+const char* register_part(const char* reg, int size) {
+    static const char* names[][4] = {
+        { "rax", "eax", "ax", "al" }, { "rbx", "ebx", "bx", "bl" },
+        { "rcx", "ecx", "cx", "cl" }, { "rdx", "edx", "dx", "dl" },
+        { "rsi", "esi", "si", "sil" }, { "rdi", "edi", "di", "dil" },
+        { "r8", "r8d", "r8w", "r8b" }, { "r9", "r9d", "r9w", "r9b" },
+    };
+    int column = size == 8 ? 0 : size == 4 ? 1 : size == 2 ? 2 : 3;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(reg, names[i][0]) == 0) return names[i][column];
+    }
+    compile_error(0, "No %d-byte part of register '%s'", size, reg);
+}
+
+void emit_sized_load(const char* reg, const char* type, const char* address, FILE* output) {
+    bool is_signed = type_is_signed(type);
+    switch (type_size(type)) {
+        case 1:
+            fprintf(output, "    %s %s, byte [%s]\n", is_signed ? "movsx" : "movzx",
+                    is_signed ? reg : register_part(reg, 4), address);
+            break;
+        case 2:
+            fprintf(output, "    %s %s, word [%s]\n", is_signed ? "movsx" : "movzx",
+                    is_signed ? reg : register_part(reg, 4), address);
+            break;
+        case 4:
+            // a 32-bit move clears the upper half
+            if (is_signed) {
+                fprintf(output, "    movsxd %s, dword [%s]\n", reg, address);
+            } else {
+                fprintf(output, "    mov %s, [%s]\n", register_part(reg, 4), address);
+            }
+            break;
+        default:
+            fprintf(output, "    mov %s, [%s]\n", reg, address);
+            break;
+    }
+}
+
+void emit_sized_store(const char* address, const char* type, const char* reg, FILE* output) {
+    fprintf(output, "    mov [%s], %s\n", address, register_part(reg, type_size(type)));
+}
+
+const char* size_keyword(int size) {
+    switch (size) {
+        case 1:  return "byte";
+        case 2:  return "word";
+        case 4:  return "dword";
+        default: return "qword";
     }
 }
 
+int64_t sized_immediate(int64_t value, int size) {
+    switch (size) {
+        case 1:  return (int8_t)value;
+        case 2:  return (int16_t)value;
+        case 4:  return (int32_t)value;
+        default: return value;
+    }
+}
+
+void emit_constant_store(const char* address, const char* type, int64_t value, FILE* output) {
+    int size = type_size(type);
+    if (size == 8 && (value < INT32_MIN || value > INT32_MAX)) {
+        // no store takes a 64-bit immediate
+        fprintf(output, "    mov rax, %lld\n", (long long)value);
+        fprintf(output, "    mov [%s], rax\n", address);
+        return;
+    }
+    fprintf(output, "    mov %s [%s], %lld\n", size_keyword(size), address,
+            (long long)sized_immediate(value, size));
+}
+
+// Expression Helpers
+bool contains_call(ASTNode* node) {
+    if (!node) return false;
+    switch (node->type) {
+        case NODE_CALL:
+            return true;
+        case NODE_BINOP:
+            return contains_call(node->binop.left) || contains_call(node->binop.right);
+        case NODE_UNOP:
+            return contains_call(node->unop.operand);
+        case NODE_INDEX:
+            return contains_call(node->element.index);
+        default:
+            return false;
+    }
+}
+
+// Switch Helpers
+static int compare_case_labels(const void* a, const void* b) {
+    int x = ((const CaseLabel*)a)->value, y = ((const CaseLabel*)b)->value;
+    return (x > y) - (x < y);
+}
+
+int collect_case_labels(ASTNode* node, CaseLabel** out, int* default_index) {
+    int count = 0, index = 0;
+    *out = NULL;
+    *default_index = -1;
+    for (ASTNode* c = node->switch_stmt.cases; c; c = c->binop.right, index++) {
+        ASTNode* clause = c->binop.left;
+        if (clause->case_clause.is_default) {
+            if (*default_index >= 0) {
+                compile_error(clause->line, "Multiple default labels in one switch");
+            }
+            *default_index = index;
+            continue;
+        }
+        *out = mem_realloc(*out, (count + 1) * sizeof(CaseLabel));
+        if (!*out) {
+            out_of_memory("collect_case_labels");
+        }
+        (*out)[count++] = (CaseLabel){ clause->case_clause.value, index };
+    }
+    if (count > 0) qsort(*out, count, sizeof(CaseLabel), compare_case_labels);
+    for (int i = 1; i < count; i++) {
+        if ((*out)[i].value == (*out)[i - 1].value) {
+            compile_error(node->line, "Duplicate case value %d", (*out)[i].value);
+        }
+    }
+    return count;
+}
+
+// enough cases, and few enough holes between them, for a jump table
+bool dense_case_labels(const CaseLabel* labels, int count) {
+    if (count < SWITCH_TABLE_MIN_CASES) return false;
+    long long range = (long long)labels[count - 1].value - labels[0].value + 1;
+    return range <= (long long)count * SWITCH_TABLE_MAX_SPREAD;
+}
+
 // Text Section Helpers
 void emit_text_section(ASTNode* node, FILE* output) {
     fprintf(output, "section .text\n");
@@ -191,7 +493,7 @@ void emit_itoa(FILE* output) {
                     "    push rbx\n    push rcx\n    push rdx\n"
                     "    mov rax, rdi          ; rdi contains the number to convert\n"
                     "    mov rdi, rsi          ; rsi is the buffer address\n"
-                    "    add rdi, 19           ; move to the end of the buffer\n"
+                    "    add rdi, 23           ; move to the end of the buffer\n"
                     "    mov rcx, 10           ; divisor for base 10\n"
                     "    mov rbx, 0            ; character count\n"
                     "    xor r8, r8            ; flag for negative (0 = positive)\n"
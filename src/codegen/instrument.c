@@ -0,0 +1,105 @@
+#include "codegen/instrument.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    const char* kind;
+    const char* function;
+    int line;
+} Counter;
+
+bool instrument = false;
+
+static Counter* counters = NULL;
+static int counter_count = 0;
+static int counter_capacity = 0;
+
+void instrument_reset(void) {
+    mem_free(counters);
+    counters = NULL;
+    counter_count = counter_capacity = 0;
+}
+
+void emit_counter(const char* kind, const char* function, int line, FILE* output) {
+    if (counter_count == counter_capacity) {
+        counter_capacity = counter_capacity ? counter_capacity * 2 : 64;
+        counters = mem_realloc(counters, counter_capacity * sizeof(Counter));
+        if (!counters) {
+            out_of_memory("emit_counter");
+        }
+    }
+    // function names outlive code generation: they belong to the AST
+    counters[counter_count] = (Counter){ kind, function, line };
+    fprintf(output, "    inc qword [profile_counters + %d]\n", 8 * counter_count++);
+}
+
+// `db` operands for a string of any bytes, NUL-terminated
+static void emit_bytes(const char* s, FILE* output) {
+    fprintf(output, "db ");
+    for (; *s; s++) fprintf(output, "%d, ", (unsigned char)*s);
+    fprintf(output, "0\n");
+}
+
+// Writes each key and the count after it with the itoa routine, which
+// leaves the digits and a newline at the end of print_buffer. Syscalls
+// clobber rcx and r11, itoa clobbers r8; r12 and r13 are saved.
+void emit_profile_dump(const char* path, FILE* output) {
+    fprintf(output,
+        "\nprofile_dump:\n"
+        "    push r12\n    push r13\n"
+        "    mov rax, 2            ; open\n"
+        "    mov rdi, profile_path\n"
+        "    mov rsi, 577          ; O_WRONLY | O_CREAT | O_TRUNC\n"
+        "    mov rdx, 420          ; 0644\n"
+        "    syscall\n"
+        "    test rax, rax\n"
+        "    js .profile_done\n"
+        "    mov r12, rax          ; file descriptor\n"
+        "    xor r13, r13          ; counter index\n"
+        ".profile_loop:\n"
+        "    mov rax, 1\n"
+        "    mov rdi, r12\n"
+        "    mov rsi, [profile_keys + r13*8]\n"
+        "    movzx rdx, byte [rsi] ; the key's length comes first\n"
+        "    inc rsi\n"
+        "    syscall\n"
+        "    mov rdi, [profile_counters + r13*8]\n"
+        "    mov rsi, print_buffer\n"
+        "    call itoa\n"
+        "    mov rsi, print_buffer\n"
+        "    add rsi, 24\n"
+        "    sub rsi, rax\n"
+        "    mov rdx, rax\n"
+        "    mov rax, 1\n"
+        "    mov rdi, r12\n"
+        "    syscall\n"
+        "    inc r13\n"
+        "    cmp r13, %d\n"
+        "    jb .profile_loop\n"
+        "    mov rax, 3            ; close\n"
+        "    mov rdi, r12\n"
+        "    syscall\n"
+        ".profile_done:\n"
+        "    pop r13\n    pop r12\n"
+        "    ret\n", counter_count);
+
+    fprintf(output, "\nsection .rodata\n");
+    fprintf(output, "profile_path: ");
+    emit_bytes(path, output);
+    for (int i = 0; i < counter_count; i++) {
+        char key[300];
+        int length = snprintf(key, sizeof(key), "%s %.255s %d ",
+                              counters[i].kind, counters[i].function, counters[i].line);
+        if (length > 255) length = 255;
+        fprintf(output, "profile_key%d: db %d, \"%.*s\"\n", i, length, length, key);
+    }
+    fprintf(output, "align 8\nprofile_keys:\n");
+    for (int i = 0; i < counter_count; i++) fprintf(output, "    dq profile_key%d\n", i);
+
+    fprintf(output, "\nsection .bss\nalignb 8\n");
+    fprintf(output, "profile_counters: resq %d\n", counter_count > 0 ? counter_count : 1);
+}
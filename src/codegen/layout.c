@@ -0,0 +1,308 @@
+#include "codegen/layout.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// Control-flow cleanup over the generated assembly.
+//
+// The handlers emit each construct on its own, so joins produce jumps to
+// jumps, jumps to the very next line, and labels nobody uses. The text is
+// split into lines, each classified as a label, a jump, a `ret` or anything
+// else; the rewrites below run until none applies. Only local `.L` labels
+// are touched: function entry points and the itoa routine stay as they are.
+
+typedef enum {
+    LINE_BLANK,
+    LINE_LABEL,
+    LINE_JMP,       // unconditional jump
+    LINE_JCC,       // conditional jump
+    LINE_RET,
+    LINE_DIRECTIVE, // global/section/align: never removed, ends a dead region
+    LINE_OTHER
+} LineKind;
+
+typedef struct {
+    char* text;     // original line, without the newline
+    LineKind kind;
+    char* name;     // label name, or jump mnemonic
+    char* target;   // jump target
+    bool removed;
+    bool align;     // emit an align directive before this line
+} Line;
+
+typedef struct {
+    Line* lines;
+    int count;
+    LayoutStats stats;
+} Layout;
+
+static char* copy_range(const char* start, size_t length) {
+    char* s = mem_alloc(length + 1);
+    if (!s) {
+        out_of_memory("copy_range");
+    }
+    memcpy(s, start, length);
+    s[length] = '\0';
+    return s;
+}
+
+static void classify(Line* line) {
+    const char* s = line->text;
+    while (*s == ' ' || *s == '\t') s++;
+    size_t length = strcspn(s, ";");
+    while (length > 0 && (s[length - 1] == ' ' || s[length - 1] == '\t')) length--;
+
+    line->kind = LINE_OTHER;
+    // %line markers (-g) are as invisible to the rewrites as blank lines
+    if (length == 0 || s[0] == '%') {
+        line->kind = LINE_BLANK;
+    } else if (s[length - 1] == ':' && strcspn(s, " \t") >= length) {
+        line->kind = LINE_LABEL;
+        line->name = copy_range(s, length - 1);
+    } else if (strncmp(s, "global", 6) == 0 || strncmp(s, "section", 7) == 0 ||
+               strncmp(s, "align", 5) == 0) {
+        line->kind = LINE_DIRECTIVE;
+    } else if (length == 3 && strncmp(s, "ret", 3) == 0) {
+        line->kind = LINE_RET;
+    } else if (s[0] == 'j') {
+        size_t op = strcspn(s, " \t");
+        const char* target = s + op;
+        while (*target == ' ' || *target == '\t') target++;
+        // register and memory operands (jmp [..]) are left alone
+        if (target < s + length && *target == '.') {
+            line->kind = strncmp(s, "jmp", op) == 0 && op == 3 ? LINE_JMP : LINE_JCC;
+            line->name = copy_range(s, op);
+            line->target = copy_range(target, s + length - target);
+        }
+    }
+}
+
+static bool is_local(const char* label) {
+    return strncmp(label, ".L", 2) == 0;
+}
+
+static int find_label(Layout* l, const char* name) {
+    for (int i = 0; i < l->count; i++) {
+        if (!l->lines[i].removed && l->lines[i].kind == LINE_LABEL &&
+            strcmp(l->lines[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// next line that is not removed and not blank, or count
+static int next_line(Layout* l, int i) {
+    for (i++; i < l->count; i++) {
+        if (!l->lines[i].removed && l->lines[i].kind != LINE_BLANK) return i;
+    }
+    return l->count;
+}
+
+// first line after label `name` that is not itself a label
+static int first_instruction(Layout* l, const char* name) {
+    int i = find_label(l, name);
+    if (i < 0) return -1;
+    do {
+        i = next_line(l, i);
+    } while (i < l->count && l->lines[i].kind == LINE_LABEL);
+    return i < l->count ? i : -1;
+}
+
+static void retarget(Line* line, const char* target) {
+    mem_free(line->target);
+    line->target = mem_strdup(target);
+    mem_free(line->text);
+    size_t length = strlen(line->name) + strlen(target) + 6;
+    line->text = mem_alloc(length);
+    if (!line->text) {
+        out_of_memory("retarget");
+    }
+    snprintf(line->text, length, "    %s %s", line->name, target);
+}
+
+static const char* inverted(const char* jcc) {
+    static const char* pairs[][2] = {
+        { "je", "jne" }, { "jz", "jnz" }, { "jl", "jge" }, { "jle", "jg" },
+        { "js", "jns" }, { "jb", "jae" }, { "jbe", "ja" },
+    };
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+        if (strcmp(jcc, pairs[i][0]) == 0) return pairs[i][1];
+        if (strcmp(jcc, pairs[i][1]) == 0) return pairs[i][0];
+    }
+    return NULL;
+}
+
+// a jump whose target block is just `jmp M` can go to M directly
+static bool thread_jumps(Layout* l) {
+    bool changed = false;
+    for (int i = 0; i < l->count; i++) {
+        Line* line = &l->lines[i];
+        if (line->removed || (line->kind != LINE_JMP && line->kind != LINE_JCC)) continue;
+        if (!is_local(line->target)) continue;
+        int j = first_instruction(l, line->target);
+        if (j < 0 || j == i || l->lines[j].kind != LINE_JMP) continue;
+        if (strcmp(l->lines[j].target, line->target) == 0) continue;   // jmp to itself
+        retarget(line, l->lines[j].target);
+        l->stats.threaded++;
+        changed = true;
+    }
+    return changed;
+}
+
+// `jcc A; jmp B; A:` becomes `j!cc B; A:`
+static bool invert_branches(Layout* l) {
+    bool changed = false;
+    for (int i = 0; i < l->count; i++) {
+        Line* jcc = &l->lines[i];
+        if (jcc->removed || jcc->kind != LINE_JCC || !inverted(jcc->name)) continue;
+        int j = next_line(l, i);
+        if (j >= l->count || l->lines[j].kind != LINE_JMP) continue;
+        bool falls_to_target = false;
+        for (int k = next_line(l, j); k < l->count && l->lines[k].kind == LINE_LABEL; k = next_line(l, k)) {
+            if (strcmp(l->lines[k].name, jcc->target) == 0) falls_to_target = true;
+        }
+        if (!falls_to_target) continue;
+        const char* op = inverted(jcc->name);
+        mem_free(jcc->name);
+        jcc->name = mem_strdup(op);
+        retarget(jcc, l->lines[j].target);
+        l->lines[j].removed = true;
+        l->stats.inverted++;
+        changed = true;
+    }
+    return changed;
+}
+
+// jumps to the label right after them, and code after jmp/ret before any label
+static bool remove_dead(Layout* l) {
+    bool changed = false;
+    for (int i = 0; i < l->count; i++) {
+        Line* line = &l->lines[i];
+        if (line->removed) continue;
+        if (line->kind == LINE_JMP || line->kind == LINE_JCC) {
+            for (int k = next_line(l, i); k < l->count && l->lines[k].kind == LINE_LABEL; k = next_line(l, k)) {
+                if (strcmp(l->lines[k].name, line->target) == 0) {
+                    line->removed = true;
+                    l->stats.removed++;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+        if (line->removed || (line->kind != LINE_JMP && line->kind != LINE_RET)) continue;
+        for (int k = next_line(l, i); k < l->count; k = next_line(l, k)) {
+            LineKind kind = l->lines[k].kind;
+            if (kind == LINE_LABEL || kind == LINE_DIRECTIVE) break;
+            l->lines[k].removed = true;
+            l->stats.removed++;
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+static bool is_referenced(Layout* l, const char* label) {
+    size_t length = strlen(label);
+    for (int i = 0; i < l->count; i++) {
+        Line* line = &l->lines[i];
+        if (line->removed || line->kind == LINE_LABEL) continue;
+        if (line->target) {
+            if (strcmp(line->target, label) == 0) return true;
+            continue;
+        }
+        // any other mention of the name, as a whole word
+        for (const char* p = strstr(line->text, label); p; p = strstr(p + 1, label)) {
+            char after = p[length];
+            if (!(after == '_' || after == '.' || (after >= '0' && after <= '9') ||
+                  (after >= 'a' && after <= 'z') || (after >= 'A' && after <= 'Z'))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool remove_unused_labels(Layout* l) {
+    bool changed = false;
+    for (int i = 0; i < l->count; i++) {
+        Line* line = &l->lines[i];
+        if (line->removed || line->kind != LINE_LABEL || !is_local(line->name)) continue;
+        if (is_referenced(l, line->name)) continue;
+        line->removed = true;
+        changed = true;
+    }
+    return changed;
+}
+
+// labels targeted by a later jump start a loop; padding goes before the
+// first label of the group so every name for the header is aligned
+static void mark_loop_headers(Layout* l) {
+    for (int i = 0; i < l->count; i++) {
+        Line* line = &l->lines[i];
+        if (line->removed || line->kind != LINE_LABEL || !is_local(line->name)) continue;
+        bool backward = false;
+        for (int j = i + 1; j < l->count && !backward; j++) {
+            Line* jump = &l->lines[j];
+            backward = !jump->removed && jump->target && strcmp(jump->target, line->name) == 0;
+        }
+        if (!backward) continue;
+        int first = i;
+        for (int k = i - 1; k >= 0; k--) {
+            if (l->lines[k].removed || l->lines[k].kind == LINE_BLANK) continue;
+            if (l->lines[k].kind != LINE_LABEL) break;
+            first = k;
+        }
+        if (!l->lines[first].align) {
+            l->lines[first].align = true;
+            l->stats.aligned++;
+        }
+    }
+}
+
+LayoutStats optimize_layout(const char* text, int loop_align, FILE* output) {
+    Layout l = {0};
+    int capacity = 0;
+    for (const char* p = text; *p; ) {
+        size_t length = strcspn(p, "\n");
+        if (l.count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            l.lines = mem_realloc(l.lines, capacity * sizeof(Line));
+            if (!l.lines) {
+                out_of_memory("optimize_layout");
+            }
+        }
+        Line* line = &l.lines[l.count++];
+        memset(line, 0, sizeof(Line));
+        line->text = copy_range(p, length);
+        classify(line);
+        p += length;
+        if (*p == '\n') p++;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = thread_jumps(&l);
+        changed = invert_branches(&l) || changed;
+        changed = remove_dead(&l) || changed;
+        changed = remove_unused_labels(&l) || changed;
+    }
+    if (loop_align > 0) mark_loop_headers(&l);
+
+    for (int i = 0; i < l.count; i++) {
+        Line* line = &l.lines[i];
+        if (!line->removed) {
+            if (line->align) fprintf(output, "align %d\n", loop_align);
+            fprintf(output, "%s\n", line->text);
+        }
+        mem_free(line->text);
+        mem_free(line->name);
+        mem_free(line->target);
+    }
+    mem_free(l.lines);
+    return l.stats;
+}
@@ -0,0 +1,601 @@
+#include "codegen/select.h"
+#include "codegen/codegen.h"
+#include "codegen/helpers.h"
+#include "codegen/symbol.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Instruction selection by tree pattern matching.
+//
+// Each expression node can be covered by one of a few tiles; a tile covers
+// the node and possibly its leaf children, whose values then appear as
+// immediate or memory operands instead of going through rax and the stack:
+//     a + 5          mov rax, [a] / add rax, 5
+//     a < 10         cmp qword [a], 10 / setl al / movzx eax, al
+//     b + i * 4      mov rax, [b] / mov rcx, [i] / lea rax, [rax+rcx*4]
+// Every tile that matches is priced (roughly in cycles, a memory operand
+// counting as one more) on top of the cheapest cover of the subtrees it
+// leaves, and the cheapest is emitted. Conditions of if/while compare and
+// branch without materializing a 0/1, and `x = x op e` updates x in place.
+//
+// Operand order is kept where it is visible: a variable may only be read
+// after a call that could store to it when the source reads it there too.
+//
+// Only 64-bit variables and constants that fit a sign-extended 32-bit
+// immediate are operands; narrower variables need an extending load and
+// wider constants a `mov` of their own, so both are left to generate_code.
+
+#define COST_LOAD 1     // extra for a memory operand
+#define COST_MUL 3
+#define COST_DIV 20
+#define COST_CALL 10
+
+typedef enum {
+    OPERAND_IMM,
+    OPERAND_MEM,
+    OPERAND_REG
+} OperandKind;
+
+typedef struct {
+    OperandKind kind;
+    int64_t imm;
+    const char* name;   // data label or register
+} Operand;
+
+typedef enum {
+    TILE_LEAF,              // constant or variable loaded into rax
+    TILE_GENERATE,          // calls and array elements: left to generate_code
+    TILE_UNARY,
+    TILE_RIGHT_OPERAND,     // left in rax, `op rax, right`
+    TILE_LEFT_OPERAND,      // right in rax, mirrored operator, left as the operand
+    TILE_MEMORY_COMPARE,    // `cmp qword [var], imm`
+    TILE_SCALED_ADD,        // `lea rax, [rax+rcx*scale]`
+    TILE_STACK              // both sides in registers, one kept on the stack meanwhile
+} Tile;
+
+typedef struct {
+    Tile tile;
+    int cost;
+} Choice;
+
+static const Operand rcx_operand = { OPERAND_REG, 0, "rcx" };
+
+static bool leaf_operand(ASTNode* node, Operand* out) {
+    switch (node->type) {
+        case NODE_NUM:
+            if (node->num_value < INT32_MIN || node->num_value > INT32_MAX) return false;
+            *out = (Operand){ OPERAND_IMM, node->num_value, NULL };
+            return true;
+        case NODE_UNOP:
+            if (node->unop.op == OP_NEG && node->unop.operand->type == NODE_NUM) {
+                int64_t value = node->unop.operand->num_value;
+                if (value < -INT32_MAX || value > INT32_MAX) return false;
+                *out = (Operand){ OPERAND_IMM, -value, NULL };
+                return true;
+            }
+            return node->unop.op == OP_POS && leaf_operand(node->unop.operand, out);
+        case NODE_IDENT: {
+            Symbol* sym = lookup_symbol(node->str_value);
+            if (!sym) {
+                compile_error(node->line, "Undefined variable '%s'", node->str_value);
+            }
+            if (type_size(sym->type) != 8) return false;
+            *out = (Operand){ OPERAND_MEM, 0, sym->label };
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+static void format_operand(const Operand* x, bool sized, char* text, size_t size) {
+    switch (x->kind) {
+        case OPERAND_IMM: snprintf(text, size, "%lld", (long long)x->imm); break;
+        case OPERAND_MEM: snprintf(text, size, sized ? "qword [%s]" : "[%s]", x->name); break;
+        case OPERAND_REG: snprintf(text, size, "%s", x->name); break;
+    }
+}
+
+// writes to a 32-bit register clear the upper half and encode shorter
+static const char* low_half(const char* reg) {
+    static const char* names[][2] = {
+        { "rax", "eax" }, { "rcx", "ecx" }, { "rdx", "edx" }, { "rsi", "esi" },
+        { "rdi", "edi" }, { "r8", "r8d" }, { "r9", "r9d" },
+    };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        if (strcmp(reg, names[i][0]) == 0) return names[i][1];
+    }
+    return reg;
+}
+
+static void emit_load(const char* reg, const Operand* x, FILE* output) {
+    char text[80];
+    format_operand(x, false, text, sizeof(text));
+    if (x->kind == OPERAND_IMM && x->imm == 0) {
+        fprintf(output, "    xor %s, %s\n", low_half(reg), low_half(reg));
+    } else if (x->kind == OPERAND_IMM && x->imm > 0) {
+        fprintf(output, "    mov %s, %s\n", low_half(reg), text);
+    } else {
+        fprintf(output, "    mov %s, %s\n", reg, text);
+    }
+}
+
+static const char* condition_code(Operator op) {
+    switch (op) {
+        case OP_EQ:  return "e";
+        case OP_NEQ: return "ne";
+        case OP_LT:  return "l";
+        case OP_LE:  return "le";
+        case OP_GT:  return "g";
+        case OP_GE:  return "ge";
+        default:     return NULL;
+    }
+}
+
+static Operator negated(Operator op) {
+    switch (op) {
+        case OP_EQ:  return OP_NEQ;
+        case OP_NEQ: return OP_EQ;
+        case OP_LT:  return OP_GE;
+        case OP_LE:  return OP_GT;
+        case OP_GT:  return OP_LE;
+        case OP_GE:  return OP_LT;
+        default:     return op;
+    }
+}
+
+// `a op b` as `b op' a`
+static bool mirror(Operator op, Operator* out) {
+    switch (op) {
+        case OP_ADD: case OP_MUL: case OP_BAND: case OP_BOR: case OP_BXOR:
+        case OP_BNAND: case OP_BNOR: case OP_BXNOR:
+        case OP_EQ: case OP_NEQ: case OP_LAND: case OP_LOR:
+            *out = op;
+            return true;
+        case OP_LT: *out = OP_GT; return true;
+        case OP_LE: *out = OP_GE; return true;
+        case OP_GT: *out = OP_LT; return true;
+        case OP_GE: *out = OP_LE; return true;
+        default:
+            return false;
+    }
+}
+
+static int power_of_two(int64_t value) {
+    if (value <= 0 || (value & (value - 1)) != 0) return -1;
+    int shift = 0;
+    while (value > 1) {
+        value >>= 1;
+        shift++;
+    }
+    return shift;
+}
+
+// multiplications done with a shift or a single lea
+static bool cheap_multiplier(int64_t value) {
+    return power_of_two(value) >= 0 || value == 3 || value == 5 || value == 9;
+}
+
+static bool immediate_shift(const Operand* x) {
+    return x->kind == OPERAND_IMM && x->imm >= 0 && x->imm < 64;
+}
+
+// cost of `rax = rax op x`
+static int op_cost(Operator op, const Operand* x) {
+    int load = x->kind == OPERAND_MEM ? COST_LOAD : 0;
+    int to_rcx = x->kind == OPERAND_REG ? 0 : 1 + load;
+    switch (op) {
+        case OP_ADD: case OP_SUB: case OP_BAND: case OP_BOR: case OP_BXOR:
+            return 1 + load;
+        case OP_BNAND: case OP_BNOR: case OP_BXNOR:
+            return 2 + load;
+        case OP_MUL:
+            if (x->kind == OPERAND_IMM && cheap_multiplier(x->imm)) return 1;
+            return COST_MUL + load;
+        case OP_DIV:
+            return COST_DIV + 1 + (x->kind == OPERAND_IMM ? 1 : load);
+        case OP_MOD:
+            return COST_DIV + 2 + (x->kind == OPERAND_IMM ? 1 : load);
+        case OP_LSHIFT: case OP_RSHIFT:
+            return immediate_shift(x) ? 1 : 1 + to_rcx;
+        case OP_LAND: case OP_LOR:
+            return 6 + to_rcx;
+        default:
+            return 3 + load;    // cmp, setcc, movzx
+    }
+}
+
+static Choice choose(ASTNode* node);
+
+static int expr_cost(ASTNode* node) {
+    return choose(node).cost;
+}
+
+// b + i * s / i * s + b with s = 2, 4 or 8 and i a variable
+static bool scaled_add(ASTNode* node, ASTNode** base, ASTNode** index, int* scale) {
+    if (node->binop.op != OP_ADD) return false;
+    for (int side = 0; side < 2; side++) {
+        ASTNode* product = side ? node->binop.left : node->binop.right;
+        ASTNode* other = side ? node->binop.right : node->binop.left;
+        if (product->type != NODE_BINOP || product->binop.op != OP_MUL) continue;
+        // with the product first, i is read before b is evaluated
+        if (side && contains_call(other)) continue;
+        for (int order = 0; order < 2; order++) {
+            ASTNode* var = order ? product->binop.right : product->binop.left;
+            ASTNode* factor = order ? product->binop.left : product->binop.right;
+            if (var->type != NODE_IDENT || factor->type != NODE_NUM) continue;
+            if (factor->num_value != 2 && factor->num_value != 4 && factor->num_value != 8) continue;
+            *base = other;
+            *index = var;
+            *scale = (int)factor->num_value;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void consider(Choice* best, Tile tile, int cost) {
+    if (cost < best->cost) {
+        best->tile = tile;
+        best->cost = cost;
+    }
+}
+
+static Choice choose_binop(ASTNode* node) {
+    ASTNode* left = node->binop.left;
+    ASTNode* right = node->binop.right;
+    Operator op = node->binop.op;
+    Operand l, r;
+    bool left_leaf = leaf_operand(left, &l);
+    bool right_leaf = leaf_operand(right, &r);
+    int left_cost = expr_cost(left);
+    int right_cost = expr_cost(right);
+    bool calls = contains_call(left) || contains_call(right);
+
+    Choice best = { TILE_STACK, left_cost + right_cost + (calls ? 3 : 2) + op_cost(op, &rcx_operand) };
+    if (right_leaf) {
+        consider(&best, TILE_RIGHT_OPERAND, left_cost + op_cost(op, &r));
+    }
+    Operator mirrored;
+    if (left_leaf && (l.kind == OPERAND_IMM || !contains_call(right))) {
+        if (op == OP_SUB) {
+            consider(&best, TILE_LEFT_OPERAND, right_cost + 1 + op_cost(OP_ADD, &l));
+        } else if (mirror(op, &mirrored)) {
+            consider(&best, TILE_LEFT_OPERAND, right_cost + op_cost(mirrored, &l));
+        }
+    }
+    if (condition_code(op) && left_leaf && right_leaf &&
+        (l.kind == OPERAND_MEM) != (r.kind == OPERAND_MEM) &&
+        (l.kind == OPERAND_IMM || r.kind == OPERAND_IMM)) {
+        consider(&best, TILE_MEMORY_COMPARE, 1 + COST_LOAD + 2);
+    }
+    ASTNode* base;
+    ASTNode* index;
+    int scale;
+    if (scaled_add(node, &base, &index, &scale)) {
+        consider(&best, TILE_SCALED_ADD, expr_cost(base) + 2 + COST_LOAD);
+    }
+    return best;
+}
+
+static Choice choose(ASTNode* node) {
+    Operand x;
+    if (leaf_operand(node, &x)) {
+        return (Choice){ TILE_LEAF, x.kind == OPERAND_MEM ? 1 + COST_LOAD : 1 };
+    }
+    switch (node->type) {
+        case NODE_BINOP:
+            return choose_binop(node);
+        case NODE_UNOP:
+            return (Choice){ TILE_UNARY, expr_cost(node->unop.operand) +
+                                         (node->unop.op == OP_LNOT ? 3 : node->unop.op == OP_POS ? 0 : 1) };
+        case NODE_INDEX:
+            // handle_index folds a constant index into the address
+            return (Choice){ TILE_GENERATE, 1 + COST_LOAD +
+                             (node->element.index->type == NODE_NUM ? 0 : expr_cost(node->element.index)) };
+        case NODE_IDENT:    // narrow: an extending load
+        case NODE_NUM:      // wide: a 64-bit immediate
+            return (Choice){ TILE_GENERATE, node->type == NODE_IDENT ? 1 + COST_LOAD : 1 };
+        default:
+            return (Choice){ TILE_GENERATE, COST_CALL };
+    }
+}
+
+// rax = rax op x
+static void emit_op(Operator op, const Operand* x, FILE* output) {
+    char text[80];
+    format_operand(x, false, text, sizeof(text));
+    switch (op) {
+        case OP_ADD:  fprintf(output, "    add rax, %s\n", text); break;
+        case OP_SUB:  fprintf(output, "    sub rax, %s\n", text); break;
+        case OP_BAND: fprintf(output, "    and rax, %s\n", text); break;
+        case OP_BOR:  fprintf(output, "    or rax, %s\n", text); break;
+        case OP_BXOR: fprintf(output, "    xor rax, %s\n", text); break;
+        case OP_BNAND: fprintf(output, "    and rax, %s\n    not rax\n", text); break;
+        case OP_BNOR:  fprintf(output, "    or rax, %s\n    not rax\n", text); break;
+        case OP_BXNOR: fprintf(output, "    xor rax, %s\n    not rax\n", text); break;
+        case OP_MUL: {
+            if (x->kind != OPERAND_IMM) {
+                fprintf(output, "    imul rax, %s\n", text);
+            } else if (power_of_two(x->imm) > 0) {
+                fprintf(output, "    shl rax, %d\n", power_of_two(x->imm));
+            } else if (x->imm == 3 || x->imm == 5 || x->imm == 9) {
+                fprintf(output, "    lea rax, [rax+rax*%d]\n", (int)x->imm - 1);
+            } else if (x->imm != 1) {
+                fprintf(output, "    imul rax, rax, %s\n", text);
+            }
+            break;
+        }
+        case OP_DIV:
+        case OP_MOD:
+            if (x->kind == OPERAND_IMM) {
+                emit_load("rcx", x, output);
+                snprintf(text, sizeof(text), "rcx");
+            } else {
+                format_operand(x, true, text, sizeof(text));
+            }
+            fprintf(output, "    cqo\n    idiv %s\n", text);
+            if (op == OP_MOD) fprintf(output, "    mov rax, rdx\n");
+            break;
+        case OP_LSHIFT:
+        case OP_RSHIFT: {
+            const char* mnemonic = op == OP_LSHIFT ? "shl" : "sar";
+            if (immediate_shift(x)) {
+                fprintf(output, "    %s rax, %s\n", mnemonic, text);
+            } else {
+                if (x->kind != OPERAND_REG) emit_load("rcx", x, output);
+                fprintf(output, "    %s rax, cl\n", mnemonic);
+            }
+            break;
+        }
+        case OP_LAND:
+        case OP_LOR:
+            // both operands are already evaluated; normalise each to 0/1
+            if (x->kind != OPERAND_REG) emit_load("rcx", x, output);
+            fprintf(output,
+                "    test rax, rax\n"
+                "    setne al\n"
+                "    test rcx, rcx\n"
+                "    setne cl\n"
+                "    %s al, cl\n"
+                "    movzx eax, al\n", op == OP_LAND ? "and" : "or");
+            break;
+        default: {
+            const char* cc = condition_code(op);
+            if (!cc) {
+                fprintf(output, "    ; unsupported operator\n");
+                break;
+            }
+            fprintf(output, "    cmp rax, %s\n    set%s al\n    movzx eax, al\n", text, cc);
+            break;
+        }
+    }
+}
+
+// Evaluates what `tile` leaves of a binary node: afterwards rax holds one
+// side and the returned operand the other, to be combined with *op.
+static Operand emit_operands(ASTNode* node, Tile tile, Operator* op, FILE* output) {
+    Operand x;
+    switch (tile) {
+        case TILE_RIGHT_OPERAND:
+            select_expr(node->binop.left, output);
+            leaf_operand(node->binop.right, &x);
+            return x;
+        case TILE_LEFT_OPERAND:
+            select_expr(node->binop.right, output);
+            leaf_operand(node->binop.left, &x);
+            if (*op == OP_SUB) {
+                // a - b = -b + a
+                fprintf(output, "    neg rax\n");
+                *op = OP_ADD;
+            } else {
+                mirror(*op, op);
+            }
+            return x;
+        default:
+            if (contains_call(node->binop.left) || contains_call(node->binop.right)) {
+                select_expr(node->binop.left, output);
+                fprintf(output, "    push rax\n");
+                stack_depth++;
+                select_expr(node->binop.right, output);
+                fprintf(output, "    mov rcx, rax\n    pop rax\n");
+                stack_depth--;
+            } else {
+                // without calls the order is not observable
+                select_expr(node->binop.right, output);
+                fprintf(output, "    push rax\n");
+                stack_depth++;
+                select_expr(node->binop.left, output);
+                fprintf(output, "    pop rcx\n");
+                stack_depth--;
+            }
+            return rcx_operand;
+    }
+}
+
+// `cmp qword [var], imm`; returns the comparison as seen from the variable
+static Operator emit_memory_compare(ASTNode* node, FILE* output) {
+    Operand l, r;
+    leaf_operand(node->binop.left, &l);
+    leaf_operand(node->binop.right, &r);
+    Operator op = node->binop.op;
+    if (l.kind != OPERAND_MEM) {
+        Operand swap = l;
+        l = r;
+        r = swap;
+        mirror(op, &op);
+    }
+    fprintf(output, "    cmp qword [%s], %lld\n", l.name, (long long)r.imm);
+    return op;
+}
+
+static void emit_unary(ASTNode* node, FILE* output) {
+    select_expr(node->unop.operand, output);
+    switch (node->unop.op) {
+        case OP_LNOT:
+            fprintf(output, "    test rax, rax\n    sete al\n    movzx eax, al\n");
+            break;
+        case OP_BNOT:
+            fprintf(output, "    not rax\n");
+            break;
+        case OP_NEG:
+            fprintf(output, "    neg rax\n");
+            break;
+        case OP_POS:
+            break;
+        default:
+            fprintf(output, "    ; unsupported unary operator\n");
+            break;
+    }
+}
+
+void select_expr(ASTNode* node, FILE* output) {
+    Choice choice = choose(node);
+    Operand x;
+    switch (choice.tile) {
+        case TILE_LEAF:
+            leaf_operand(node, &x);
+            emit_load("rax", &x, output);
+            break;
+        case TILE_GENERATE:
+            generate_code(node, output);
+            break;
+        case TILE_UNARY:
+            emit_unary(node, output);
+            break;
+        case TILE_MEMORY_COMPARE: {
+            Operator op = emit_memory_compare(node, output);
+            fprintf(output, "    set%s al\n    movzx eax, al\n", condition_code(op));
+            break;
+        }
+        case TILE_SCALED_ADD: {
+            ASTNode* base;
+            ASTNode* index;
+            int scale;
+            scaled_add(node, &base, &index, &scale);
+            select_expr(base, output);
+            // widens a narrow index the way any other read of it does
+            select_load("rcx", index, output);
+            fprintf(output, "    lea rax, [rax+rcx*%d]\n", scale);
+            break;
+        }
+        default: {
+            Operator op = node->binop.op;
+            x = emit_operands(node, choice.tile, &op, output);
+            emit_op(op, &x, output);
+            break;
+        }
+    }
+}
+
+void select_branch(ASTNode* cond, bool when, const char* label, FILE* output) {
+    Operand x;
+    if (leaf_operand(cond, &x) && x.kind == OPERAND_IMM) {
+        if ((x.imm != 0) == when) fprintf(output, "    jmp %s\n", label);
+        return;
+    }
+    if (cond->type == NODE_UNOP && cond->unop.op == OP_LNOT) {
+        select_branch(cond->unop.operand, !when, label, output);
+        return;
+    }
+    if (cond->type == NODE_BINOP && condition_code(cond->binop.op)) {
+        Choice choice = choose(cond);
+        Operator op = cond->binop.op;
+        if (choice.tile == TILE_MEMORY_COMPARE) {
+            op = emit_memory_compare(cond, output);
+        } else {
+            char text[80];
+            x = emit_operands(cond, choice.tile, &op, output);
+            format_operand(&x, false, text, sizeof(text));
+            fprintf(output, "    cmp rax, %s\n", text);
+        }
+        if (!when) op = negated(op);
+        fprintf(output, "    j%s %s\n", condition_code(op), label);
+        return;
+    }
+    select_expr(cond, output);
+    fprintf(output, "    test rax, rax\n    j%s %s\n", when ? "nz" : "z", label);
+}
+
+static bool is_variable(ASTNode* node, const char* name) {
+    return node->type == NODE_IDENT && strcmp(node->str_value, name) == 0;
+}
+
+void select_store(Symbol* sym, ASTNode* value, FILE* output) {
+    const char* label = sym->label;
+    const char* name = sym->name;
+    int size = type_size(sym->type);
+    Operand x;
+    if (value->type == NODE_NUM) {
+        emit_constant_store(label, sym->type, value->num_value, output);
+        return;
+    }
+    if (leaf_operand(value, &x) && x.kind == OPERAND_IMM) {
+        emit_constant_store(label, sym->type, x.imm, output);
+        return;
+    }
+
+    // x = x op e, with e free of calls that could store to x first
+    ASTNode* other = NULL;
+    const char* mnemonic = NULL;
+    if (value->type == NODE_BINOP) {
+        Operator op = value->binop.op;
+        switch (op) {
+            case OP_ADD:  mnemonic = "add"; break;
+            case OP_SUB:  mnemonic = "sub"; break;
+            case OP_BAND: mnemonic = "and"; break;
+            case OP_BOR:  mnemonic = "or"; break;
+            case OP_BXOR: mnemonic = "xor"; break;
+            case OP_LSHIFT: mnemonic = "shl"; break;
+            case OP_RSHIFT: mnemonic = "sar"; break;
+            default: break;
+        }
+        if (mnemonic && is_variable(value->binop.left, name)) {
+            other = value->binop.right;
+        } else if (mnemonic && op != OP_SUB && op != OP_LSHIFT && op != OP_RSHIFT &&
+                   is_variable(value->binop.right, name)) {
+            other = value->binop.left;
+        }
+        if (other && contains_call(other)) other = NULL;
+        // the low bits of a narrow variable shift differently from the full value
+        if (other && (op == OP_LSHIFT || op == OP_RSHIFT) &&
+            (size < 8 || !(leaf_operand(other, &x) && immediate_shift(&x)))) {
+            other = NULL;
+        }
+    }
+    if (other) {
+        bool immediate = leaf_operand(other, &x) && x.kind == OPERAND_IMM;
+        int in_place = (immediate ? 0 : expr_cost(other)) + 2;
+        if (in_place < expr_cost(value) + 1) {
+            if (immediate) {
+                fprintf(output, "    %s %s [%s], %lld\n", mnemonic, size_keyword(size), label,
+                        (long long)sized_immediate(x.imm, size));
+            } else {
+                select_expr(other, output);
+                fprintf(output, "    %s [%s], %s\n", mnemonic, label, register_part("rax", size));
+            }
+            return;
+        }
+    }
+
+    select_expr(value, output);
+    emit_sized_store(label, sym->type, "rax", output);
+}
+
+void select_load(const char* reg, ASTNode* leaf, FILE* output) {
+    Operand x;
+    if (leaf_operand(leaf, &x)) {
+        emit_load(reg, &x, output);
+    } else if (leaf->type == NODE_NUM) {
+        fprintf(output, "    mov %s, %lld\n", reg, (long long)leaf->num_value);
+    } else if (leaf->type == NODE_IDENT) {
+        Symbol* sym = lookup_symbol(leaf->str_value);
+        emit_sized_load(reg, sym->type, sym->label, output);
+    } else {
+        compile_error(0, "select_load needs a constant or a variable");
+    }
+}
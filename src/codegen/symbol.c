@@ -1,4 +1,8 @@
 #include "codegen/symbol.h"
+#include "codegen/codegen.h"
+#include "parser/ast.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
 
 #include <stdlib.h>
 #include <string.h>
@@ -7,6 +11,7 @@
 static Symbol* symbol_table = NULL;
 static int var_counter = 0;
 static int func_var_counter = 0;
+long symbol_lookups = 0;
 
 void init_symbol_table(void) {
     symbol_table = NULL;
@@ -17,57 +22,81 @@ void free_symbol_table(void) {
     Symbol *curr = symbol_table;
     while(curr) {
        Symbol *next = curr->next;
-       free(curr->name);
-       free(curr->label);
-       if(curr->value) free(curr->value);
-       free(curr);
+       mem_free(curr->name);
+       mem_free(curr->label);
+       if(curr->value) mem_free(curr->value);
+       mem_free(curr);
        curr = next;
     }
     symbol_table = NULL;
     var_counter = 0;
 }
 
-Symbol* add_symbol(const char* name, const char* value, const char* type) {
-    Symbol *sym = lookup_symbol(name);
-    if(sym) {
-        if(value) {
-            free(sym->value);
-            sym->value = strdup(value);
-        }
-        return sym;
-    }
-    
-    sym = malloc(sizeof(Symbol));
+void reset_symbol_labels(void) {
+    func_var_counter = 0;
+}
+
+static Symbol* insert_symbol(const char* name, const char* value, const char* type, int size) {
+    Symbol* sym = mem_alloc(sizeof(Symbol));
     if (!sym) {
-        fprintf(stderr, "Memory allocation failed in add_symbol\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("add_symbol");
     }
-    sym->name = strdup(name);
+    sym->name = mem_strdup(name);
     if (!sym->name) {
-        fprintf(stderr, "Memory allocation failed in add_symbol (name)\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("add_symbol (name)");
     }
-    sym->value = value ? strdup(value) : NULL;
+    sym->value = value ? mem_strdup(value) : NULL;
     
-    sym->label = malloc(32);
+    sym->label = mem_alloc(strlen(name) + 32);
     if (!sym->label) {
-        fprintf(stderr, "Memory allocation failed in add_symbol (label)\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("add_symbol (label)");
     }
-    sprintf(sym->label, "var%d", func_var_counter++);
+    // an array takes one slot per element
+    sym->index = func_var_counter;
+    sym->size = size;
+    sym->heat = 0;
+    // named after the variable for perf and objdump, and so that cached
+    // code does not depend on the order variables were collected in
+    if (named_variables) sprintf(sym->label, "var.%s", name);
+    else sprintf(sym->label, "var%d", func_var_counter);
+    func_var_counter += size > 0 ? size : 1;
     
     sym->next = symbol_table;
     symbol_table = sym;
-    sym->type = strdup(type);
+    sym->type = mem_strdup(type);
     return sym;
 }
 
+Symbol* add_symbol(const char* name, const char* value, const char* type) {
+    Symbol *sym = lookup_symbol(name);
+    if(sym) {
+        if(value) {
+            mem_free(sym->value);
+            sym->value = mem_strdup(value);
+        }
+        return sym;
+    }
+    return insert_symbol(name, value, type, 0);
+}
+
+Symbol* add_array_symbol(const char* name, const char* type, int size) {
+    Symbol* sym = lookup_symbol(name);
+    if (sym) {
+        if (sym->size != size || type_size(sym->type) != type_size(type) ||
+            type_is_signed(sym->type) != type_is_signed(type)) {
+            compile_error(0, "Conflicting declarations of '%s'", name);
+        }
+        return sym;
+    }
+    return insert_symbol(name, NULL, type, size);
+}
+
 int update_symbol_value(const char* name, const char* new_value) {
     Symbol* sym = lookup_symbol(name);
     if(sym) {
         if(new_value) {
-            free(sym->value);
-            sym->value = strdup(new_value);
+            mem_free(sym->value);
+            sym->value = mem_strdup(new_value);
         }
         return 1;
     }
@@ -75,6 +104,7 @@ int update_symbol_value(const char* name, const char* new_value) {
 }
 
 Symbol* lookup_symbol(const char* name) {
+    symbol_lookups++;
     Symbol* curr = symbol_table;
     while(curr) {
        if(strcmp(curr->name, name) == 0)
@@ -84,17 +114,34 @@ Symbol* lookup_symbol(const char* name) {
     return NULL;
 }
 
+int symbol_count(void) {
+    int count = 0;
+    for (Symbol* curr = symbol_table; curr; curr = curr->next) count++;
+    return count;
+}
+
 Symbol* get_symbol_table(void) {
     return symbol_table;
 }
 
-void print_symbol_table(void) {
-    Symbol* curr = symbol_table;
-    while (curr) {
-        printf("Symbol: %s, Label: %s, Value: %s\n",
-               curr->name,
-               curr->label,
-               curr->value ? curr->value : "NULL");
-        curr = curr->next;
+// one past the highest slot index handed out so far
+int symbol_slot_count(void) {
+    int count = 0;
+    for (Symbol* curr = symbol_table; curr; curr = curr->next) {
+        int end = curr->index + (curr->size > 0 ? curr->size : 1);
+        if (end > count) count = end;
+    }
+    return count;
+}
+
+void print_symbol_table(FILE* output) {
+    for (Symbol* curr = symbol_table; curr; curr = curr->next) {
+        fprintf(output, "Symbol: %s, Type: %s, Label: %s, Value: %s",
+                curr->name,
+                curr->type ? curr->type : "NULL",
+                curr->label,
+                curr->value ? curr->value : "NULL");
+        if (curr->size > 0) fprintf(output, ", Size: %d", curr->size);
+        fprintf(output, "\n");
     }
 }
\ No newline at end of file
@@ -0,0 +1,201 @@
+#include "codegen/vector.h"
+#include "codegen/codegen.h"
+#include "codegen/symbol.h"
+#include "codegen/select.h"
+#include "optimizer/analysis.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// Vector code for element-wise array loops.
+//
+// Elements are 64-bit, so an xmm register holds 2 iterations (SSE2) and a
+// ymm register 4 (AVX2). The variables and constants an expression uses
+// are broadcast into registers counted down from 15 before the loop;
+// temporaries are allocated upwards from 0 by expression depth, which
+// vectorize_loops has already checked fits. rcx holds the induction
+// variable and rdx the bound for the whole loop.
+
+typedef struct {
+    bool avx;
+    int lanes;
+    ASTNode** invariants;   // one leaf per distinct variable or constant
+    int count;
+} VectorCode;
+
+static const char* register_prefix(const VectorCode* v) {
+    return v->avx ? "ymm" : "xmm";
+}
+
+static bool same_leaf(ASTNode* a, ASTNode* b) {
+    if (a->type != b->type) return false;
+    if (a->type == NODE_NUM) return a->num_value == b->num_value;
+    return strcmp(a->str_value, b->str_value) == 0;
+}
+
+static int invariant_register(const VectorCode* v, ASTNode* leaf) {
+    for (int i = 0; i < v->count; i++) {
+        if (same_leaf(v->invariants[i], leaf)) return 15 - i;
+    }
+    compile_error(0, "'%s' was not broadcast for the vector loop",
+            leaf->type == NODE_IDENT ? leaf->str_value : "constant");
+}
+
+static void collect_invariants(VectorCode* v, ASTNode* node) {
+    switch (node->type) {
+        case NODE_NUM:
+        case NODE_IDENT:
+            for (int i = 0; i < v->count; i++) {
+                if (same_leaf(v->invariants[i], node)) return;
+            }
+            v->invariants = mem_realloc(v->invariants, (v->count + 1) * sizeof(ASTNode*));
+            if (!v->invariants) {
+                out_of_memory("collect_invariants");
+            }
+            v->invariants[v->count++] = node;
+            break;
+        case NODE_BINOP:
+            collect_invariants(v, node->binop.left);
+            // shift counts are immediates
+            if (node->binop.op != OP_LSHIFT) collect_invariants(v, node->binop.right);
+            break;
+        default:
+            break;
+    }
+}
+
+static void broadcast(const VectorCode* v, ASTNode* leaf, int reg, FILE* output) {
+    select_load("rax", leaf, output);
+    if (v->avx) {
+        fprintf(output, "    vmovq xmm%d, rax\n", reg);
+        fprintf(output, "    vpbroadcastq ymm%d, xmm%d\n", reg, reg);
+    } else {
+        fprintf(output, "    movq xmm%d, rax\n", reg);
+        fprintf(output, "    punpcklqdq xmm%d, xmm%d\n", reg, reg);
+    }
+}
+
+// `[label + rcx*8 ± offset]` for an element access at i, i + c or i - c
+static void element_address(ASTNode* access, char* out, size_t size) {
+    Symbol* sym = lookup_symbol(access->element.array->str_value);
+    ASTNode* index = access->element.index;
+    int offset = 0;
+    if (index->type == NODE_BINOP) {
+        offset = index->binop.right->num_value * 8;
+        if (index->binop.op == OP_SUB) offset = -offset;
+    }
+    if (offset > 0) {
+        snprintf(out, size, "[%s + rcx*8 + %d]", sym->label, offset);
+    } else if (offset < 0) {
+        snprintf(out, size, "[%s + rcx*8 - %d]", sym->label, -offset);
+    } else {
+        snprintf(out, size, "[%s + rcx*8]", sym->label);
+    }
+}
+
+static const char* lane_op(Operator op) {
+    switch (op) {
+        case OP_ADD:  return "paddq";
+        case OP_SUB:  return "psubq";
+        case OP_BAND: return "pand";
+        case OP_BOR:  return "por";
+        case OP_BXOR: return "pxor";
+        default:
+            compile_error(0, "Operator cannot be vectorized");
+    }
+}
+
+// value of `node` for every lane into register `reg`
+static void emit_lanes(const VectorCode* v, ASTNode* node, int reg, FILE* output) {
+    const char* r = register_prefix(v);
+    char address[96];
+    switch (node->type) {
+        case NODE_INDEX:
+            element_address(node, address, sizeof(address));
+            fprintf(output, "    %s %s%d, %s\n", v->avx ? "vmovdqu" : "movdqu", r, reg, address);
+            break;
+        case NODE_NUM:
+        case NODE_IDENT:
+            fprintf(output, "    %s %s%d, %s%d\n", v->avx ? "vmovdqa" : "movdqa",
+                    r, reg, r, invariant_register(v, node));
+            break;
+        case NODE_BINOP: {
+            emit_lanes(v, node->binop.left, reg, output);
+            if (node->binop.op == OP_LSHIFT) {
+                int count = node->binop.right->num_value;
+                if (v->avx) {
+                    fprintf(output, "    vpsllq ymm%d, ymm%d, %d\n", reg, reg, count);
+                } else {
+                    fprintf(output, "    psllq xmm%d, %d\n", reg, count);
+                }
+                break;
+            }
+            ASTNode* right = node->binop.right;
+            int source = reg + 1;
+            if (right->type == NODE_NUM || right->type == NODE_IDENT) {
+                source = invariant_register(v, right);
+            } else {
+                emit_lanes(v, right, source, output);
+            }
+            const char* op = lane_op(node->binop.op);
+            if (v->avx) {
+                fprintf(output, "    v%s ymm%d, ymm%d, ymm%d\n", op, reg, reg, source);
+            } else {
+                fprintf(output, "    %s xmm%d, xmm%d\n", op, reg, source);
+            }
+            break;
+        }
+        default:
+            compile_error(0, "Expression cannot be vectorized");
+    }
+}
+
+// sets flags for `rcx + lanes - 1` against the bound in rdx
+static void emit_lane_check(const VectorCode* v, FILE* output) {
+    fprintf(output, "    lea rax, [rcx + %d]\n", v->lanes - 1);
+    fprintf(output, "    cmp rax, rdx\n");
+}
+
+void emit_vector_loop(ASTNode* loop, FILE* output) {
+    VectorCode v = {0};
+    v.avx = vector_isa == VECTOR_AVX2;
+    v.lanes = v.avx ? 4 : 2;
+
+    ASTNode* cond = loop->control.condition;
+    bool inclusive = cond->binop.op == OP_LE;
+    Symbol* var = lookup_symbol(cond->binop.left->str_value);
+    ASTNode** body = NULL;
+    int n = flatten_statements(loop->control.loop_body, &body);
+    for (int i = 0; i < n - 1; i++) collect_invariants(&v, body[i]->element.value);
+
+    int label = code_label_counter++;
+    fprintf(output, "    ; %d lanes (%s)\n", v.lanes, v.avx ? "avx2" : "sse2");
+    fprintf(output, "    mov rcx, [%s]\n", var->label);
+    select_load("rdx", cond->binop.right, output);
+    for (int i = 0; i < v.count; i++) broadcast(&v, v.invariants[i], 15 - i, output);
+    emit_lane_check(&v, output);
+    fprintf(output, "    %s .Lvecend%d\n", inclusive ? "jg" : "jge", label);
+
+    fprintf(output, ".Lvec%d:\n", label);
+    char address[96];
+    for (int i = 0; i < n - 1; i++) {
+        emit_lanes(&v, body[i]->element.value, 0, output);
+        element_address(body[i], address, sizeof(address));
+        fprintf(output, "    %s %s, %s0\n", v.avx ? "vmovdqu" : "movdqu", address, register_prefix(&v));
+    }
+    fprintf(output, "    add rcx, %d\n", v.lanes);
+    emit_lane_check(&v, output);
+    fprintf(output, "    %s .Lvec%d\n", inclusive ? "jle" : "jl", label);
+
+    fprintf(output, ".Lvecend%d:\n", label);
+    fprintf(output, "    mov [%s], rcx\n", var->label);
+    if (v.avx) fprintf(output, "    vzeroupper\n");
+    fprintf(output, "\n");
+
+    mem_free(v.invariants);
+    mem_free(body);
+}
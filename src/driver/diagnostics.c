@@ -0,0 +1,67 @@
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+static DiagnosticHandler handler = NULL;
+static void* handler_context = NULL;
+static jmp_buf* recovery = NULL;
+
+void diagnostics_begin(DiagnosticHandler requested, void* context, jmp_buf* point) {
+    handler = requested;
+    handler_context = context;
+    recovery = point;
+}
+
+void diagnostics_end(void) {
+    handler = NULL;
+    handler_context = NULL;
+    recovery = NULL;
+}
+
+// Formats into a fixed buffer: reporting must work when memory has run
+// out, and no message of the compiler comes near the limit.
+static void deliver(DiagnosticSeverity severity, int line, const char* prefix, const char* fmt, va_list args) {
+    char message[1024];
+    int length = snprintf(message, sizeof(message), "%s", prefix);
+    vsnprintf(message + length, sizeof(message) - length, fmt, args);
+    if (handler) {
+        Diagnostic diagnostic = { severity, line, message };
+        handler(&diagnostic, handler_context);
+    } else {
+        fprintf(stderr, "%s\n", message);
+    }
+}
+
+void report(DiagnosticSeverity severity, int line, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    deliver(severity, line, "", fmt, args);
+    va_end(args);
+}
+
+void compile_warning(int line, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    deliver(DIAGNOSTIC_WARNING, line, "Warning: ", fmt, args);
+    va_end(args);
+}
+
+void compile_error(int line, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    deliver(DIAGNOSTIC_ERROR, line, "Error: ", fmt, args);
+    va_end(args);
+    compile_abort();
+}
+
+void out_of_memory(const char* where) {
+    report(DIAGNOSTIC_ERROR, 0, "Memory allocation failed in %s", where);
+    compile_abort();
+}
+
+void compile_abort(void) {
+    if (recovery) longjmp(*recovery, 1);
+    exit(EXIT_FAILURE);
+}
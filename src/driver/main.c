@@ -0,0 +1,83 @@
+// bin/compiler: the command line over libcompiler. Compiles the input file
+// (or stdin), printing errors and warnings as they are reported, and writes
+// the assembly to build/asm/program.asm.
+
+#include "lib/compiler.h"
+#include "server/server.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+
+static char* read_source(FILE* input, size_t* length) {
+    size_t capacity = 1 << 16;
+    char* source = malloc(capacity);
+    size_t n;
+    *length = 0;
+    while (source && (n = fread(source + *length, 1, capacity - *length, input)) > 0) {
+        *length += n;
+        if (*length == capacity) source = realloc(source, capacity *= 2);
+    }
+    if (!source) {
+        fprintf(stderr, "Memory allocation failed in read_source\n");
+        exit(EXIT_FAILURE);
+    }
+    return source;
+}
+
+static void print_diagnostic(const Diagnostic* diagnostic, void* context) {
+    (void)context;
+    fprintf(stderr, "%s\n", diagnostic->message);
+}
+
+int main(int argc, char* argv[]) {
+
+    CompilerOptions opts;
+    if (parse_options(argc, argv, &opts) != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (opts.server_socket) {
+        return run_server(&opts);
+    }
+
+    FILE* input;
+    if (!opts.input_file) {
+        fprintf(stderr, "No input file provided. Defaulting to /dev/stdin.\nEnter input (press Ctrl+D when done): ");
+        input = fopen("/dev/stdin", "r");
+    } else {
+        input = fopen(opts.input_file, "r");
+    }
+
+    if (!input) {
+        perror("Error opening file");
+        return 1;
+    }
+    size_t length;
+    char* source = read_source(input, &length);
+    fclose(input);
+
+    CompilerHooks hooks = { NULL, print_diagnostic, NULL };
+    CompileResult result;
+    int status = compiler_compile(source, length, &opts, &hooks, &result);
+    free(source);
+
+    if (result.assembly) {
+        FILE* output = fopen("build/asm/program.asm", "w");
+        if (!output) {
+            perror("Failed to open output file");
+            status = 1;
+        } else {
+            fwrite(result.assembly, 1, result.assembly_length, output);
+            fclose(output);
+        }
+    }
+    int signo = result.signal;
+    compiler_free_result(&result);
+    if (signo) {
+        // a program that faulted on the VM ends this process as it would
+        // have ended its own
+        raise(signo);
+    }
+    return status;
+}
@@ -0,0 +1,210 @@
+#define _GNU_SOURCE
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+// in front of every block, keeping what follows it maximally aligned
+typedef union Header {
+    struct {
+        union Header* prev;
+        union Header* next;
+        size_t size;
+    };
+    max_align_t align;
+} Header;
+
+static void* default_allocate(size_t size, void* context) {
+    (void)context;
+    return malloc(size);
+}
+
+static void* default_reallocate(void* block, size_t size, void* context) {
+    (void)context;
+    return realloc(block, size);
+}
+
+static void default_release(void* block, void* context) {
+    (void)context;
+    free(block);
+}
+
+static const Allocator default_allocator = { default_allocate, default_reallocate, default_release, NULL };
+static Allocator allocator = { default_allocate, default_reallocate, default_release, NULL };
+
+static Header* blocks = NULL;
+static size_t in_use = 0;
+
+// a mem_stream; those an error left open are closed before their memory goes
+typedef struct Stream Stream;
+struct Stream {
+    char** text;
+    size_t* length;
+    size_t capacity;
+    size_t position;
+    FILE* file;
+    bool abandoned;         // being closed by mem_release_all
+    Stream* next;           // in open_streams
+};
+static Stream* open_streams = NULL;
+
+void mem_use(const Allocator* requested) {
+    allocator = requested ? *requested : default_allocator;
+}
+
+static void link_block(Header* header, size_t size) {
+    header->prev = NULL;
+    header->next = blocks;
+    header->size = size;
+    if (blocks) blocks->prev = header;
+    blocks = header;
+    in_use += size;
+}
+
+static void unlink_block(Header* header) {
+    if (header->prev) header->prev->next = header->next;
+    else blocks = header->next;
+    if (header->next) header->next->prev = header->prev;
+    in_use -= header->size;
+}
+
+void* mem_alloc(size_t size) {
+    if (size > SIZE_MAX - sizeof(Header)) return NULL;
+    Header* header = allocator.allocate(sizeof(Header) + size, allocator.context);
+    if (!header) return NULL;
+    link_block(header, size);
+    return header + 1;
+}
+
+void* mem_calloc(size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) return NULL;
+    void* block = mem_alloc(count * size);
+    if (block) memset(block, 0, count * size);
+    return block;
+}
+
+void* mem_realloc(void* block, size_t size) {
+    if (!block) return mem_alloc(size);
+    if (size > SIZE_MAX - sizeof(Header)) return NULL;
+    Header* header = (Header*)block - 1;
+    unlink_block(header);
+    Header* moved = allocator.reallocate(header, sizeof(Header) + size, allocator.context);
+    if (!moved) {
+        // the old block is untouched and still the caller's
+        link_block(header, header->size);
+        return NULL;
+    }
+    link_block(moved, size);
+    return moved + 1;
+}
+
+char* mem_strdup(const char* s) {
+    return mem_strndup(s, strlen(s));
+}
+
+char* mem_strndup(const char* s, size_t length) {
+    size_t n = strnlen(s, length);
+    char* copy = mem_alloc(n + 1);
+    if (!copy) {
+        out_of_memory("mem_strndup");
+    }
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+void mem_free(void* block) {
+    if (!block) return;
+    Header* header = (Header*)block - 1;
+    unlink_block(header);
+    allocator.release(header, allocator.context);
+}
+
+void mem_release_all(void) {
+    // the text pointers may be in stack frames an error jumped out of, so
+    // what is still buffered is dropped
+    for (Stream* stream = open_streams; stream; stream = stream->next) stream->abandoned = true;
+    while (open_streams) fclose(open_streams->file);
+    while (blocks) {
+        Header* header = blocks;
+        unlink_block(header);
+        allocator.release(header, allocator.context);
+    }
+}
+
+size_t mem_in_use(void) {
+    return in_use;
+}
+
+// --- streams ---
+
+static ssize_t stream_write(void* cookie, const char* data, size_t size) {
+    Stream* stream = cookie;
+    if (stream->abandoned) return size;
+    size_t end = stream->position + size;
+    if (end + 1 > stream->capacity) {
+        size_t capacity = stream->capacity ? stream->capacity : 256;
+        while (capacity < end + 1) capacity *= 2;
+        char* text = mem_realloc(*stream->text, capacity);
+        if (!text) return -1;
+        // what a seek skipped over reads as NULs
+        memset(text + stream->capacity, 0, capacity - stream->capacity);
+        *stream->text = text;
+        stream->capacity = capacity;
+    }
+    memcpy(*stream->text + stream->position, data, size);
+    stream->position = end;
+    if (end > *stream->length) {
+        *stream->length = end;
+        (*stream->text)[end] = '\0';
+    }
+    return size;
+}
+
+static int stream_seek(void* cookie, off64_t* offset, int whence) {
+    Stream* stream = cookie;
+    if (stream->abandoned) return -1;
+    off64_t base = whence == SEEK_SET ? 0 : whence == SEEK_CUR ? (off64_t)stream->position : (off64_t)*stream->length;
+    if (base + *offset < 0) return -1;
+    stream->position = base + *offset;
+    *offset = stream->position;
+    return 0;
+}
+
+static int stream_close(void* cookie) {
+    Stream** link = &open_streams;
+    while (*link != cookie) link = &(*link)->next;
+    *link = ((Stream*)cookie)->next;
+    mem_free(cookie);
+    return 0;
+}
+
+FILE* mem_stream(char** text, size_t* length) {
+    Stream* stream = mem_alloc(sizeof(Stream));
+    *text = mem_alloc(1);
+    if (!stream || !*text) {
+        mem_free(stream);
+        mem_free(*text);
+        *text = NULL;
+        return NULL;
+    }
+    (*text)[0] = '\0';
+    *length = 0;
+    *stream = (Stream){ text, length, 1, 0, NULL, false, NULL };
+    cookie_io_functions_t functions = { NULL, stream_write, stream_seek, stream_close };
+    FILE* file = fopencookie(stream, "w", functions);
+    if (!file) {
+        mem_free(stream);
+        mem_free(*text);
+        *text = NULL;
+        return NULL;
+    }
+    stream->file = file;
+    stream->next = open_streams;
+    open_streams = stream;
+    return file;
+}
@@ -0,0 +1,203 @@
+#include "driver/options.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void print_usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [options] [input_file]\n", prog);
+    fprintf(stderr,
+        "Options:\n"
+        "  --vm              run the program on the bytecode VM instead of emitting assembly\n"
+        "  --dump-bytecode   print the lowered bytecode to stderr (with --vm)\n"
+        "  -O0, -O1, -O2     optimization level (default -O0)\n"
+        "  --inline-budget=N inline leaf functions of at most N AST nodes (-O1, default %d)\n"
+        "  --eval-steps=N    give up folding a pure call after N steps (-O1, default %d)\n"
+        "  --eval-depth=N    give up folding a pure call past N nested calls (-O1, default %d)\n"
+        "  --unroll=N        unroll counted loops N times (-O2, default %d; 1 disables)\n"
+        "  --align-loops=N   align loop headers to N bytes (-O1, default %d; 0 disables)\n"
+        "  --vectorize=ISA   vectorize element-wise array loops with none, sse2 or avx2\n"
+        "                    (-O2, default sse2)\n"
+        "  --opt-report      print what each optimization pass did to stderr\n"
+        "  -g                emit sized function symbols, named variables and source line\n"
+        "                    markers, for nasm -g -F dwarf and perf\n"
+        "  --trace=LIST      trace tokens, reductions, ast, symbols, codegen (comma-separated)\n"
+        "                    or all, as text on stderr\n"
+        "  --trace-file=PATH write the trace in binary to PATH instead (read it with tracedump)\n"
+        "  --stats[=FORMAT]  report time, memory, AST nodes, symbols and assembly size per\n"
+        "                    phase on stderr, as text (default) or json\n"
+        "  --instrument[=PATH]\n"
+        "                    count function entries, loop iterations and if arms at run\n"
+        "                    time; the program writes them to PATH on exit\n"
+        "                    (default %s)\n"
+        "  --profile-use=PATH\n"
+        "                    lay out branches, split cold code, inline, unroll and place\n"
+        "                    variables by the counts of an --instrument run\n"
+        "  --cache-dir=DIR   keep the code of each function in DIR and reuse it while the\n"
+        "                    function and the flags are unchanged\n"
+        "  --server[=PATH]   stay resident and compile the requests of compiler-client\n"
+        "                    sent to the Unix socket PATH (default %s)\n"
+        "  --server-threads=N\n"
+        "                    serve N requests at once (default %d)\n"
+        "  -h, --help        show this message\n",
+        DEFAULT_INLINE_BUDGET, DEFAULT_EVAL_STEPS, DEFAULT_EVAL_DEPTH,
+        DEFAULT_UNROLL_FACTOR, DEFAULT_LOOP_ALIGN, DEFAULT_PROFILE_FILE,
+        DEFAULT_SERVER_SOCKET, DEFAULT_SERVER_THREADS);
+}
+
+const char* vector_isa_name(VectorIsa isa) {
+    switch (isa) {
+        case VECTOR_SSE2: return "sse2";
+        case VECTOR_AVX2: return "avx2";
+        default:          return "none";
+    }
+}
+
+void default_options(CompilerOptions* opts) {
+    memset(opts, 0, sizeof(CompilerOptions));
+    opts->backend = BACKEND_NATIVE;
+    opts->inline_budget = DEFAULT_INLINE_BUDGET;
+    opts->eval_steps = DEFAULT_EVAL_STEPS;
+    opts->eval_depth = DEFAULT_EVAL_DEPTH;
+    opts->unroll_factor = DEFAULT_UNROLL_FACTOR;
+    opts->loop_align = DEFAULT_LOOP_ALIGN;
+    opts->vector_isa = VECTOR_SSE2;
+    opts->server_threads = DEFAULT_SERVER_THREADS;
+}
+
+int parse_options(int argc, char* argv[], CompilerOptions* opts) {
+    default_options(opts);
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--vm") == 0) {
+            opts->backend = BACKEND_VM;
+        } else if (strcmp(arg, "--dump-bytecode") == 0) {
+            opts->dump_bytecode = true;
+        } else if (strcmp(arg, "-O0") == 0 || strcmp(arg, "-O1") == 0 || strcmp(arg, "-O2") == 0) {
+            opts->opt_level = arg[2] - '0';
+        } else if (strncmp(arg, "--inline-budget=", 16) == 0) {
+            char* end;
+            long budget = strtol(arg + 16, &end, 10);
+            if (*end != '\0' || end == arg + 16 || budget < 0) {
+                fprintf(stderr, "Invalid inline budget '%s'\n", arg + 16);
+                return -1;
+            }
+            opts->inline_budget = (int)budget;
+        } else if (strncmp(arg, "--eval-steps=", 13) == 0) {
+            char* end;
+            long steps = strtol(arg + 13, &end, 10);
+            if (*end != '\0' || end == arg + 13 || steps < 0) {
+                fprintf(stderr, "Invalid step limit '%s'\n", arg + 13);
+                return -1;
+            }
+            opts->eval_steps = steps;
+        } else if (strncmp(arg, "--eval-depth=", 13) == 0) {
+            char* end;
+            long depth = strtol(arg + 13, &end, 10);
+            if (*end != '\0' || end == arg + 13 || depth < 0 || depth > 10000) {
+                fprintf(stderr, "Invalid depth limit '%s'\n", arg + 13);
+                return -1;
+            }
+            opts->eval_depth = (int)depth;
+        } else if (strncmp(arg, "--unroll=", 9) == 0) {
+            char* end;
+            long factor = strtol(arg + 9, &end, 10);
+            if (*end != '\0' || end == arg + 9 || factor < 1 || factor > 64) {
+                fprintf(stderr, "Invalid unroll factor '%s'\n", arg + 9);
+                return -1;
+            }
+            opts->unroll_factor = (int)factor;
+        } else if (strncmp(arg, "--align-loops=", 14) == 0) {
+            char* end;
+            long align = strtol(arg + 14, &end, 10);
+            if (*end != '\0' || end == arg + 14 || align < 0 || align > 64 || (align & (align - 1)) != 0) {
+                fprintf(stderr, "Invalid loop alignment '%s'\n", arg + 14);
+                return -1;
+            }
+            opts->loop_align = (int)align;
+        } else if (strncmp(arg, "--vectorize=", 12) == 0) {
+            const char* isa = arg + 12;
+            if (strcmp(isa, "none") == 0) {
+                opts->vector_isa = VECTOR_NONE;
+            } else if (strcmp(isa, "sse2") == 0) {
+                opts->vector_isa = VECTOR_SSE2;
+            } else if (strcmp(isa, "avx2") == 0) {
+                opts->vector_isa = VECTOR_AVX2;
+            } else {
+                fprintf(stderr, "Invalid vector instruction set '%s'\n", isa);
+                return -1;
+            }
+        } else if (strcmp(arg, "--opt-report") == 0) {
+            opts->opt_report = true;
+        } else if (strcmp(arg, "-g") == 0) {
+            opts->debug_info = true;
+        } else if (strncmp(arg, "--trace=", 8) == 0) {
+            opts->trace_categories = arg + 8;
+        } else if (strncmp(arg, "--trace-file=", 13) == 0) {
+            if (arg[13] == '\0') {
+                fprintf(stderr, "Missing trace file name\n");
+                return -1;
+            }
+            opts->trace_file = arg + 13;
+        } else if (strcmp(arg, "--stats") == 0 || strcmp(arg, "--stats=text") == 0) {
+            opts->stats = STATS_TEXT;
+        } else if (strcmp(arg, "--stats=json") == 0) {
+            opts->stats = STATS_JSON;
+        } else if (strncmp(arg, "--stats=", 8) == 0) {
+            fprintf(stderr, "Invalid stats format '%s'\n", arg + 8);
+            return -1;
+        } else if (strcmp(arg, "--instrument") == 0) {
+            opts->instrument_file = DEFAULT_PROFILE_FILE;
+        } else if (strncmp(arg, "--instrument=", 13) == 0) {
+            if (arg[13] == '\0') {
+                fprintf(stderr, "Missing profile file name\n");
+                return -1;
+            }
+            opts->instrument_file = arg + 13;
+        } else if (strncmp(arg, "--profile-use=", 14) == 0) {
+            if (arg[14] == '\0') {
+                fprintf(stderr, "Missing profile file name\n");
+                return -1;
+            }
+            opts->profile_file = arg + 14;
+        } else if (strncmp(arg, "--cache-dir=", 12) == 0) {
+            if (arg[12] == '\0') {
+                fprintf(stderr, "Missing cache directory\n");
+                return -1;
+            }
+            opts->cache_dir = arg + 12;
+        } else if (strcmp(arg, "--server") == 0) {
+            opts->server_socket = DEFAULT_SERVER_SOCKET;
+        } else if (strncmp(arg, "--server=", 9) == 0) {
+            if (arg[9] == '\0') {
+                fprintf(stderr, "Missing socket path\n");
+                return -1;
+            }
+            opts->server_socket = arg + 9;
+        } else if (strncmp(arg, "--server-threads=", 17) == 0) {
+            char* end;
+            long threads = strtol(arg + 17, &end, 10);
+            if (*end != '\0' || end == arg + 17 || threads < 1 || threads > 256) {
+                fprintf(stderr, "Invalid server thread count '%s'\n", arg + 17);
+                return -1;
+            }
+            opts->server_threads = (int)threads;
+        } else if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            return -1;
+        } else if (arg[0] == '-' && arg[1] != '\0') {
+            fprintf(stderr, "Unknown option '%s'\n", arg);
+            return -1;
+        } else if (opts->input_file) {
+            fprintf(stderr, "Only one input file is supported\n");
+            return -1;
+        } else {
+            opts->input_file = arg;
+        }
+    }
+    if (opts->instrument_file && opts->backend == BACKEND_VM) {
+        fprintf(stderr, "--instrument needs the native backend\n");
+        return -1;
+    }
+    return 0;
+}
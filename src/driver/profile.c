@@ -0,0 +1,167 @@
+#include "driver/profile.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+typedef struct {
+    char kind[8];
+    char* function;     // of the first counter with this key
+    int line;
+    long count;
+    bool stale;         // matches nothing in the source, so it is not used
+} ProfileEntry;
+
+static ProfileEntry* entries = NULL;
+static int entry_count = 0;
+static bool loaded = false;
+
+static ProfileEntry* find_entry(const char* kind, int line) {
+    for (int i = 0; i < entry_count; i++) {
+        if (entries[i].line == line && strcmp(entries[i].kind, kind) == 0) return &entries[i];
+    }
+    return NULL;
+}
+
+static void add_entry(const char* kind, const char* function, int line, long count) {
+    ProfileEntry* entry = find_entry(kind, line);
+    if (entry) {
+        entry->count += count;
+        return;
+    }
+    entries = mem_realloc(entries, (entry_count + 1) * sizeof(ProfileEntry));
+    if (!entries) {
+        out_of_memory("add_entry");
+    }
+    entry = &entries[entry_count++];
+    snprintf(entry->kind, sizeof(entry->kind), "%s", kind);
+    entry->function = mem_strdup(function);
+    if (!entry->function) {
+        out_of_memory("add_entry");
+    }
+    entry->line = line;
+    entry->count = count;
+    entry->stale = false;
+}
+
+static bool has_construct(ASTNode* node, const char* kind, int line) {
+    if (!node) return false;
+    switch (node->type) {
+        case NODE_COMPOUND:
+            return has_construct(node->binop.left, kind, line) ||
+                   has_construct(node->binop.right, kind, line);
+        case NODE_IF:
+            if (node->line == line && (strcmp(kind, "then") == 0 || strcmp(kind, "else") == 0)) return true;
+            return has_construct(node->control.if_body, kind, line) ||
+                   has_construct(node->control.else_body, kind, line);
+        case NODE_WHILE:
+            if (node->line == line && strcmp(kind, "loop") == 0) return true;
+            return has_construct(node->control.loop_body, kind, line);
+        case NODE_SWITCH:
+            return has_construct(node->switch_stmt.cases, kind, line);
+        case NODE_CASE:
+            return has_construct(node->case_clause.body, kind, line);
+        default:
+            return false;
+    }
+}
+
+// A function entry names its function and line. Branches and loops only
+// need a construct of their kind on the line in some function, since an
+// inlined copy is counted in the function it was inlined into.
+static bool entry_matches(const ProfileEntry* entry, ASTNode* program) {
+    bool function_exists = strcmp(entry->function, "main") == 0 && program->program.main_block;
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        ASTNode* func = f->binop.left;
+        if (strcmp(func->func.name, entry->function) == 0) {
+            if (strcmp(entry->kind, "func") == 0) return func->line == entry->line;
+            function_exists = true;
+        }
+    }
+    if (strcmp(entry->kind, "func") == 0) {
+        return function_exists && program->program.main_block->line == entry->line;
+    }
+    if (!function_exists) return false;
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        if (has_construct(f->binop.left->func.body, entry->kind, entry->line)) return true;
+    }
+    return has_construct(program->program.main_block, entry->kind, entry->line);
+}
+
+int profile_load(const char* path, ASTNode* program) {
+    FILE* input = fopen(path, "r");
+    if (!input) {
+        report(DIAGNOSTIC_ERROR, 0, "%s: %s", path, strerror(errno));
+        return -1;
+    }
+    char text[512];
+    int line_number = 0;
+    while (fgets(text, sizeof(text), input)) {
+        line_number++;
+        char kind[8], function[256];
+        int line;
+        long count;
+        if (sscanf(text, "%7s %255s %d %ld", kind, function, &line, &count) != 4 || count < 0 ||
+            (strcmp(kind, "func") != 0 && strcmp(kind, "loop") != 0 &&
+             strcmp(kind, "then") != 0 && strcmp(kind, "else") != 0)) {
+            report(DIAGNOSTIC_ERROR, 0, "Error: Malformed profile entry at %s:%d", path, line_number);
+            fclose(input);
+            profile_free();
+            return -1;
+        }
+        add_entry(kind, function, line, count);
+    }
+    fclose(input);
+    loaded = true;
+
+    int stale = 0;
+    for (int i = 0; i < entry_count; i++) {
+        if (!entry_matches(&entries[i], program)) {
+            entries[i].stale = true;
+            compile_warning(entries[i].line, "Profile entry '%s %s %d' does not match the source",
+                            entries[i].kind, entries[i].function, entries[i].line);
+            stale++;
+        }
+    }
+    if (stale > 0) {
+        compile_warning(0, "%d of %d profile entries are stale; rerun the --instrument build",
+                        stale, entry_count);
+    }
+    return 0;
+}
+
+void profile_free(void) {
+    for (int i = 0; i < entry_count; i++) mem_free(entries[i].function);
+    mem_free(entries);
+    entries = NULL;
+    entry_count = 0;
+    loaded = false;
+}
+
+bool profile_loaded(void) {
+    return loaded;
+}
+
+long profile_count(const char* kind, int line) {
+    ProfileEntry* entry = loaded && line > 0 ? find_entry(kind, line) : NULL;
+    return entry && !entry->stale ? entry->count : -1;
+}
+
+bool profile_hot(const char* kind, int line) {
+    long count = profile_count(kind, line);
+    if (count <= 0) return false;
+    long hottest = 0;
+    for (int i = 0; i < entry_count; i++) {
+        if (!entries[i].stale && strcmp(entries[i].kind, kind) == 0 && entries[i].count > hottest) {
+            hottest = entries[i].count;
+        }
+    }
+    return count * 10 >= hottest;
+}
+
+bool profile_cold(const char* kind, int line) {
+    return profile_count(kind, line) == 0;
+}
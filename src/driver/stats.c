@@ -0,0 +1,155 @@
+#include "driver/stats.h"
+#include "parser/ast.h"
+#include "codegen/symbol.h"
+#include "driver/memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/resource.h>
+
+typedef struct {
+    bool ran;
+    double wall_ms;
+    long nodes[NODE_TYPE_COUNT];    // created during the phase
+    long lookups;                   // lookup_symbol calls during the phase
+    int symbols;                    // symbol table size at the end
+    long heap;                      // net heap growth in bytes
+    long peak_rss_kb;               // process peak so far
+    long asm_bytes;                 // written to the phase's output
+
+    // state at stats_begin
+    struct timespec start;
+    long start_nodes[NODE_TYPE_COUNT];
+    long start_lookups;
+    long start_heap;
+    FILE* output;
+    long start_offset;
+} PhaseStats;
+
+static const char* phase_names[PHASE_COUNT] = {
+    "yyparse", "optimize_program", "collect_variables", "verify_symbols",
+    "emit_data_section", "emit_bss_section", "emit_text_section",
+    "lower_program", "vm_run", "free_ast",
+};
+
+static StatsFormat format = STATS_OFF;
+static PhaseStats phases[PHASE_COUNT];
+static StatsPhase order[PHASE_COUNT];   // phases in the order they first ran
+static int phase_count = 0;
+
+// bytes the compile holds, whichever allocator it uses
+static long heap_in_use(void) {
+    return (long)mem_in_use();
+}
+
+static long peak_rss_kb(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return usage.ru_maxrss;
+}
+
+void stats_open(StatsFormat requested) {
+    format = requested;
+    memset(phases, 0, sizeof(phases));
+    phase_count = 0;
+}
+
+void stats_begin(StatsPhase phase, FILE* output) {
+    if (format == STATS_OFF) return;
+    PhaseStats* p = &phases[phase];
+    if (!p->ran) {
+        p->ran = true;
+        order[phase_count++] = phase;
+    }
+    memcpy(p->start_nodes, ast_nodes_created, sizeof(p->start_nodes));
+    p->start_lookups = symbol_lookups;
+    p->start_heap = heap_in_use();
+    p->output = output;
+    p->start_offset = output ? ftell(output) : 0;
+    clock_gettime(CLOCK_MONOTONIC, &p->start);
+}
+
+void stats_end(StatsPhase phase) {
+    if (format == STATS_OFF) return;
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    PhaseStats* p = &phases[phase];
+    p->wall_ms += (end.tv_sec - p->start.tv_sec) * 1e3 + (end.tv_nsec - p->start.tv_nsec) / 1e6;
+    for (int i = 0; i < NODE_TYPE_COUNT; i++) p->nodes[i] += ast_nodes_created[i] - p->start_nodes[i];
+    p->lookups += symbol_lookups - p->start_lookups;
+    p->symbols = symbol_count();
+    p->heap += heap_in_use() - p->start_heap;
+    p->peak_rss_kb = peak_rss_kb();
+    if (p->output) {
+        long offset = ftell(p->output);
+        if (offset >= p->start_offset) p->asm_bytes += offset - p->start_offset;
+        p->output = NULL;
+    }
+}
+
+static long node_total(const long* nodes) {
+    long total = 0;
+    for (int i = 0; i < NODE_TYPE_COUNT; i++) total += nodes[i];
+    return total;
+}
+
+static void report_text(FILE* output) {
+    fprintf(output, "%-20s %10s %8s %8s %8s %12s %10s %10s\n",
+            "phase", "time (ms)", "nodes", "symbols", "lookups", "heap (B)", "rss (KB)", "asm (B)");
+    double wall_ms = 0;
+    long nodes = 0, lookups = 0, heap = 0, asm_bytes = 0, rss = 0;
+    for (int i = 0; i < phase_count; i++) {
+        PhaseStats* p = &phases[order[i]];
+        long created = node_total(p->nodes);
+        fprintf(output, "%-20s %10.3f %8ld %8d %8ld %+12ld %10ld %10ld\n",
+                phase_names[order[i]], p->wall_ms, created, p->symbols, p->lookups,
+                p->heap, p->peak_rss_kb, p->asm_bytes);
+        wall_ms += p->wall_ms;
+        nodes += created;
+        lookups += p->lookups;
+        heap += p->heap;
+        asm_bytes += p->asm_bytes;
+        if (p->peak_rss_kb > rss) rss = p->peak_rss_kb;
+    }
+    fprintf(output, "%-20s %10.3f %8ld %8s %8ld %+12ld %10ld %10ld\n",
+            "total", wall_ms, nodes, "", lookups, heap, rss, asm_bytes);
+
+    fprintf(output, "AST nodes created by type:");
+    for (int t = 0; t < NODE_TYPE_COUNT; t++) {
+        long count = 0;
+        for (int i = 0; i < phase_count; i++) count += phases[order[i]].nodes[t];
+        if (count > 0) fprintf(output, " %s=%ld", node_type_name((NodeType)t), count);
+    }
+    fprintf(output, "\n");
+}
+
+static void report_json(FILE* output) {
+    double wall_ms = 0;
+    long nodes = 0, asm_bytes = 0, rss = 0;
+    fprintf(output, "{\"phases\": [");
+    for (int i = 0; i < phase_count; i++) {
+        PhaseStats* p = &phases[order[i]];
+        wall_ms += p->wall_ms;
+        nodes += node_total(p->nodes);
+        asm_bytes += p->asm_bytes;
+        if (p->peak_rss_kb > rss) rss = p->peak_rss_kb;
+        fprintf(output, "%s\n  {\"name\": \"%s\", \"wall_ms\": %.3f, \"nodes\": {\"total\": %ld",
+                i > 0 ? "," : "", phase_names[order[i]], p->wall_ms, node_total(p->nodes));
+        for (int t = 0; t < NODE_TYPE_COUNT; t++) {
+            if (p->nodes[t] > 0) fprintf(output, ", \"%s\": %ld", node_type_name((NodeType)t), p->nodes[t]);
+        }
+        fprintf(output, "}, \"symbols\": %d, \"symbol_lookups\": %ld, \"heap_bytes\": %ld, "
+                "\"peak_rss_kb\": %ld, \"asm_bytes\": %ld}",
+                p->symbols, p->lookups, p->heap, p->peak_rss_kb, p->asm_bytes);
+    }
+    fprintf(output, "\n], \"total\": {\"wall_ms\": %.3f, \"nodes\": %ld, \"peak_rss_kb\": %ld, \"asm_bytes\": %ld}}\n",
+            wall_ms, nodes, rss, asm_bytes);
+}
+
+void stats_report(FILE* output) {
+    if (format == STATS_TEXT) report_text(output);
+    else if (format == STATS_JSON) report_json(output);
+}
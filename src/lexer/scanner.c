@@ -0,0 +1,456 @@
+#include "parser/parser.tab.h"
+#include "parser/ast.h"
+#include "trace/trace.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define SCANNER_SIMD 1
+#endif
+
+// Hand-written scanner, a drop-in replacement for the Flex one in lang.l
+// (chosen with SCANNER=simd ./utils.sh compile).
+//
+// The whole input is mapped (or read, for pipes) once and scanned in place:
+// yytext/yyleng are a slice of the mapping rather than a NUL-terminated
+// copy, and only identifiers and strings are copied, since the AST owns
+// them. Whitespace, comments, identifier and number runs and string bodies
+// are skipped 16 (SSE2) or 32 (AVX2) bytes at a time. The token stream is
+// the one lang.l produces, longest match first and keywords before
+// identifiers.
+
+FILE* yyin = NULL;
+char* yytext = "";
+int yyleng = 0;
+int yylineno = 1;
+
+static const char* input = NULL;    // the mapped or read input
+static size_t input_size = 0;
+static bool mapped = false;
+static const char* cursor = NULL;
+static const char* input_end = NULL;
+static bool started = false;
+
+// --- runs of one character class ---
+//
+// Each returns the first byte at or after `p` that is not in the class (or
+// `end`). The scalar loops finish what does not fill a whole vector.
+
+typedef const char* (*SpanFn)(const char* p, const char* end);
+
+static inline bool is_blank(unsigned char c) { return c == ' ' || c == '\t' || c == '\r'; }
+static inline bool is_digit(unsigned char c) { return (unsigned)(c - '0') < 10u; }
+static inline bool is_word(unsigned char c) {
+    return is_digit(c) || (unsigned char)((c | 0x20) - 'a') < 26u || c == '_';
+}
+
+static const char* span_blank_scalar(const char* p, const char* end) {
+    while (p < end && is_blank(*p)) p++;
+    return p;
+}
+
+static const char* span_digits_scalar(const char* p, const char* end) {
+    while (p < end && is_digit(*p)) p++;
+    return p;
+}
+
+static const char* span_word_scalar(const char* p, const char* end) {
+    while (p < end && is_word(*p)) p++;
+    return p;
+}
+
+// up to the next newline (a comment) or quote (a string body)
+static const char* find_byte_scalar(const char* p, const char* end, char c) {
+    const char* hit = memchr(p, c, end - p);
+    return hit ? hit : end;
+}
+
+#ifdef SCANNER_SIMD
+
+// bytes of `v` in [lo, hi]: v - lo <= hi - lo, unsigned
+static inline __m128i in_range_sse2(__m128i v, char lo, char hi) {
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8((char)(hi - lo))), shifted);
+}
+
+static inline __m128i blank_sse2(__m128i v) {
+    return _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')),
+                                     _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+}
+
+static inline __m128i word_sse2(__m128i v) {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    return _mm_or_si128(_mm_or_si128(in_range_sse2(v, '0', '9'), in_range_sse2(lower, 'a', 'z')),
+                        _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+}
+
+// `p` advanced past every whole vector of class bytes; the mask has a bit
+// per byte in the class
+#define SPAN_SSE2(p, end, classify)                                            \
+    while ((end) - (p) >= 16) {                                                \
+        __m128i v = _mm_loadu_si128((const __m128i*)(p));                      \
+        unsigned outside = ~(unsigned)_mm_movemask_epi8(classify(v)) & 0xFFFF; \
+        if (outside) return (p) + __builtin_ctz(outside);                      \
+        (p) += 16;                                                             \
+    }
+
+static inline __m128i digits_sse2(__m128i v) { return in_range_sse2(v, '0', '9'); }
+
+static const char* span_blank_sse2(const char* p, const char* end) {
+    SPAN_SSE2(p, end, blank_sse2);
+    return span_blank_scalar(p, end);
+}
+
+static const char* span_digits_sse2(const char* p, const char* end) {
+    SPAN_SSE2(p, end, digits_sse2);
+    return span_digits_scalar(p, end);
+}
+
+static const char* span_word_sse2(const char* p, const char* end) {
+    SPAN_SSE2(p, end, word_sse2);
+    return span_word_scalar(p, end);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i in_range_avx2(__m256i v, char lo, char hi) {
+    __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8((char)(hi - lo))), shifted);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i blank_avx2(__m256i v) {
+    return _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')),
+                                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i word_avx2(__m256i v) {
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    return _mm256_or_si256(_mm256_or_si256(in_range_avx2(v, '0', '9'), in_range_avx2(lower, 'a', 'z')),
+                           _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i digits_avx2(__m256i v) { return in_range_avx2(v, '0', '9'); }
+
+#define SPAN_AVX2(p, end, classify)                                            \
+    while ((end) - (p) >= 32) {                                                \
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p));                   \
+        uint32_t outside = ~(uint32_t)_mm256_movemask_epi8(classify(v));       \
+        if (outside) return (p) + __builtin_ctz(outside);                      \
+        (p) += 32;                                                             \
+    }
+
+__attribute__((target("avx2")))
+static const char* span_blank_avx2(const char* p, const char* end) {
+    SPAN_AVX2(p, end, blank_avx2);
+    return span_blank_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* span_digits_avx2(const char* p, const char* end) {
+    SPAN_AVX2(p, end, digits_avx2);
+    return span_digits_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char* span_word_avx2(const char* p, const char* end) {
+    SPAN_AVX2(p, end, word_avx2);
+    return span_word_sse2(p, end);
+}
+
+#endif
+
+static SpanFn span_blank = span_blank_scalar;
+static SpanFn span_digits = span_digits_scalar;
+static SpanFn span_word = span_word_scalar;
+
+static void select_spans(void) {
+#ifdef SCANNER_SIMD
+    span_blank = span_blank_sse2;
+    span_digits = span_digits_sse2;
+    span_word = span_word_sse2;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        span_blank = span_blank_avx2;
+        span_digits = span_digits_avx2;
+        span_word = span_word_avx2;
+    }
+#endif
+}
+
+// --- input ---
+
+static void read_stream(FILE* stream) {
+    size_t capacity = 1 << 16;
+    char* buffer = mem_alloc(capacity);
+    size_t size = 0;
+    size_t n;
+    while (buffer && (n = fread(buffer + size, 1, capacity - size, stream)) > 0) {
+        size += n;
+        if (size == capacity) buffer = mem_realloc(buffer, capacity *= 2);
+    }
+    if (!buffer) {
+        out_of_memory("read_stream");
+    }
+    input = buffer;
+    input_size = size;
+}
+
+static void open_input(void) {
+    select_spans();
+    FILE* stream = yyin ? yyin : stdin;
+    struct stat st;
+    int fd = fileno(stream);
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            input = map;
+            input_size = st.st_size;
+            mapped = true;
+        }
+    }
+    // pipes, terminals and anything that cannot be mapped are read whole
+    if (!input) read_stream(stream);
+    cursor = input;
+    input_end = input + input_size;
+}
+
+static void close_input(void) {
+    if (mapped) {
+        munmap((void*)input, input_size);
+    } else {
+        mem_free((void*)input);
+    }
+    input = cursor = input_end = NULL;
+    input_size = 0;
+    mapped = false;
+}
+
+// --- tokens ---
+
+static void trace_token(const char* name, int line, bool with_text) {
+    if (with_text) {
+        trace_printf(TRACE_TOKENS, line, name, "%.*s", yyleng, yytext);
+    } else {
+        trace_event(TRACE_TOKENS, line, name, NULL);
+    }
+}
+
+#define TOKEN(t, length)                                              \
+    do {                                                              \
+        yyleng = (length);                                            \
+        cursor += yyleng;                                             \
+        if (trace_enabled(TRACE_TOKENS)) trace_token(#t, yylineno, false); \
+        return t;                                                     \
+    } while (0)
+
+typedef struct {
+    const char* word;
+    int length;
+    int token;
+    const char* name;
+} Keyword;
+
+#define KEYWORD(w, t) { w, sizeof(w) - 1, t, #t }
+
+static const Keyword keywords[] = {
+    KEYWORD("int", TYPE_INT),  KEYWORD("i8", TYPE_I8),     KEYWORD("i16", TYPE_I16),
+    KEYWORD("i32", TYPE_I32),  KEYWORD("i64", TYPE_I64),   KEYWORD("u8", TYPE_U8),
+    KEYWORD("u16", TYPE_U16),  KEYWORD("u32", TYPE_U32),   KEYWORD("main", MAIN),
+    KEYWORD("true", TRUE),     KEYWORD("false", FALSE),    KEYWORD("print", PRINT),
+    KEYWORD("if", IF),         KEYWORD("else", ELSE),      KEYWORD("while", WHILE),
+    KEYWORD("break", BREAK),   KEYWORD("return", RETURN),  KEYWORD("switch", SWITCH),
+    KEYWORD("case", CASE),     KEYWORD("default", DEFAULT),
+};
+
+static const Keyword* find_keyword(const char* word, int length) {
+    for (size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); i++) {
+        if (keywords[i].length == length && keywords[i].word[0] == word[0] &&
+            memcmp(keywords[i].word, word, length) == 0) {
+            return &keywords[i];
+        }
+    }
+    return NULL;
+}
+
+static int scan_number(void) {
+    const char* end = span_digits(cursor, input_end);
+    yytext = (char*)cursor;
+    yyleng = end - cursor;
+    cursor = end;
+    uint64_t value = 0;
+    for (const char* p = yytext; p < end; p++) {
+        unsigned digit = *p - '0';
+        if (value > ((uint64_t)INT64_MAX - digit) / 10) {
+            report(DIAGNOSTIC_ERROR, yylineno, "Error: Number '%.*s' out of range at line %d", yyleng, yytext, yylineno);
+            return ERROR;
+        }
+        value = value * 10 + digit;
+    }
+    yylval.num = (int64_t)value;
+    if (trace_enabled(TRACE_TOKENS)) trace_token("NUMBER", yylineno, true);
+    return NUMBER;
+}
+
+static int scan_word(void) {
+    const char* end = span_word(cursor, input_end);
+    yytext = (char*)cursor;
+    yyleng = end - cursor;
+    cursor = end;
+    const Keyword* keyword = find_keyword(yytext, yyleng);
+    if (keyword) {
+        if (trace_enabled(TRACE_TOKENS)) trace_token(keyword->name, yylineno, false);
+        return keyword->token;
+    }
+    yylval.str = mem_strndup(yytext, yyleng);
+    if (!yylval.str) {
+        out_of_memory("scan_word");
+    }
+    if (trace_enabled(TRACE_TOKENS)) trace_token("IDENTIFIER", yylineno, true);
+    return IDENTIFIER;
+}
+
+// a string may span lines; without a closing quote the quote itself is an
+// invalid character, as in lang.l
+static int scan_string(void) {
+    const char* close = find_byte_scalar(cursor + 1, input_end, '"');
+    if (close == input_end) {
+        yytext = (char*)cursor;
+        yyleng = 1;
+        cursor++;
+        report(DIAGNOSTIC_ERROR, yylineno, "Error: Invalid character '\"' at line %d", yylineno);
+        return ERROR;
+    }
+    yytext = (char*)cursor;
+    yyleng = close + 1 - cursor;
+    yylval.str = mem_strndup(cursor + 1, close - cursor - 1);
+    if (!yylval.str) {
+        out_of_memory("scan_string");
+    }
+    for (const char* p = cursor + 1; (p = memchr(p, '\n', close - p)); p++) yylineno++;
+    cursor = close + 1;
+    if (trace_enabled(TRACE_TOKENS)) {
+        trace_printf(TRACE_TOKENS, yylineno, "STRING", "%s", yylval.str);
+    }
+    return STRING;
+}
+
+int yylex(void) {
+    if (!started) {
+        open_input();
+        started = true;
+    }
+    if (!input) return 0;
+
+    for (;;) {
+        cursor = span_blank(cursor, input_end);
+        if (cursor == input_end) {
+            close_input();
+            yytext = "";
+            yyleng = 0;
+            return 0;
+        }
+        // comments run to the newline, which is still a token
+        if (cursor[0] == '/' && cursor + 1 < input_end && cursor[1] == '/') {
+            cursor = find_byte_scalar(cursor + 2, input_end, '\n');
+            continue;
+        }
+        break;
+    }
+
+    yytext = (char*)cursor;
+    yylloc.first_line = yylloc.last_line = yylineno;
+    unsigned char c = *cursor;
+    char next = cursor + 1 < input_end ? cursor[1] : '\0';
+
+    if (is_digit(c)) return scan_number();
+    if (is_word(c)) return scan_word();
+
+    switch (c) {
+        case '\n':
+            yyleng = 1;
+            cursor++;
+            // the token belongs to the line it ends
+            if (trace_enabled(TRACE_TOKENS)) trace_token("NEWLINE", yylineno, false);
+            yylineno++;
+            return NEWLINE;
+        case '"':
+            return scan_string();
+        case '<':
+            if (next == '<') TOKEN(LSHIFT, 2);
+            if (next == '=') TOKEN(LE, 2);
+            TOKEN(LT, 1);
+        case '>':
+            if (next == '>') TOKEN(RSHIFT, 2);
+            if (next == '=') TOKEN(GE, 2);
+            TOKEN(GT, 1);
+        case '=':
+            if (next == '=') TOKEN(EQ, 2);
+            TOKEN(ASSIGN, 1);
+        case '!':
+            if (next == '=') TOKEN(NEQ, 2);
+            TOKEN(LNOT, 1);
+        case '&':
+            if (next == '&') {
+                yylval.num = 0;
+                TOKEN(LAND, 2);
+            }
+            TOKEN(BAND, 1);
+        case '|':
+            if (next == '|') {
+                yylval.num = 0;
+                TOKEN(LOR, 2);
+            }
+            TOKEN(BOR, 1);
+        case '~':
+            if (next == '&') TOKEN(BNAND, 2);
+            if (next == '|') TOKEN(BNOR, 2);
+            if (next == '^') TOKEN(BXNOR, 2);
+            TOKEN(BNOT, 1);
+        case '^': TOKEN(BXOR, 1);
+        case '+': TOKEN(PLUS, 1);
+        case '-': TOKEN(MINUS, 1);
+        case '*': TOKEN(MULT, 1);
+        case '/': TOKEN(DIV, 1);
+        case '%': TOKEN(MOD, 1);
+        case '(': TOKEN(LPAREN, 1);
+        case ')': TOKEN(RPAREN, 1);
+        case '{': TOKEN(LBRACE, 1);
+        case '}': TOKEN(RBRACE, 1);
+        case '[': TOKEN(LBRACKET, 1);
+        case ']': TOKEN(RBRACKET, 1);
+        case ';': TOKEN(SEMICOLON, 1);
+        case ':': TOKEN(COLON, 1);
+        case ',': TOKEN(COMMA, 1);
+    }
+
+    yyleng = 1;
+    cursor++;
+    report(DIAGNOSTIC_ERROR, yylineno, "Error: Invalid character '%.*s' at line %d", yyleng, yytext, yylineno);
+    return ERROR;
+}
+
+// as Flex's: back to the state before the first yylex, for the next input
+int yylex_destroy(void) {
+    if (input) close_input();
+    started = false;
+    yyin = NULL;
+    yytext = "";
+    yyleng = 0;
+    yylineno = 1;
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include "lib/compiler.h"
+#include "parser/parser.tab.h"
+#include "codegen/codegen.h"
+#include "codegen/handlers.h"
+#include "codegen/symbol.h"
+#include "codegen/instrument.h"
+#include "driver/stats.h"
+#include "driver/profile.h"
+#include "optimizer/optimizer.h"
+#include "vm/vm.h"
+#include "trace/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+static void* system_allocate(size_t size, void* context) {
+    (void)context;
+    return malloc(size);
+}
+
+static void* system_reallocate(void* block, size_t size, void* context) {
+    (void)context;
+    return realloc(block, size);
+}
+
+static void system_release(void* block, void* context) {
+    (void)context;
+    free(block);
+}
+
+static const Allocator system_allocator = { system_allocate, system_reallocate, system_release, NULL };
+
+// The result is the caller's, so it comes straight from their allocator and
+// outlives the compile's own memory.
+static void* result_alloc(CompileResult* result, void* block, size_t size) {
+    Allocator* a = &result->allocator;
+    return block ? a->reallocate(block, size, a->context) : a->allocate(size, a->context);
+}
+
+typedef struct {
+    const CompilerHooks* hooks;
+    CompileResult* result;
+} Collector;
+
+// passes the diagnostic on and keeps a copy in the result; one that cannot
+// be kept has still been seen by the caller's handler
+static void collect(const Diagnostic* diagnostic, void* context) {
+    Collector* collector = context;
+    if (collector->hooks && collector->hooks->on_diagnostic) {
+        collector->hooks->on_diagnostic(diagnostic, collector->hooks->context);
+    }
+    CompileResult* result = collector->result;
+    size_t length = strlen(diagnostic->message);
+    char* message = result_alloc(result, NULL, length + 1);
+    if (!message) return;
+    Diagnostic* list = result_alloc(result, result->diagnostics,
+                                    (result->diagnostic_count + 1) * sizeof(Diagnostic));
+    if (!list) {
+        result->allocator.release(message, result->allocator.context);
+        return;
+    }
+    memcpy(message, diagnostic->message, length + 1);
+    list[result->diagnostic_count++] = (Diagnostic){ diagnostic->severity, diagnostic->line, message };
+    result->diagnostics = list;
+}
+
+// parse, optimize, then run the program on the VM or write its assembly
+static int run_pipeline(FILE* input, const CompilerOptions* opts, FILE* asm_output) {
+
+    stats_begin(PHASE_PARSE, NULL);
+    ASTNode* program = parse_program(input);
+    stats_end(PHASE_PARSE);
+    if (!program) return 1;
+
+    if (trace_enabled(TRACE_AST)) {
+        FILE* trace = trace_begin(TRACE_AST, 0, "parsed");
+        print_ast(program, 0, trace);
+        trace_end(trace);
+    }
+    if (opts->profile_file && profile_load(opts->profile_file, program) != 0) {
+        return 1;
+    }
+    stats_begin(PHASE_OPTIMIZE, NULL);
+    optimize_program(program, opts);
+    stats_end(PHASE_OPTIMIZE);
+    if (trace_enabled(TRACE_AST) && opts->opt_level > 0) {
+        FILE* trace = trace_begin(TRACE_AST, 0, "optimized");
+        print_ast(program, 0, trace);
+        trace_end(trace);
+    }
+
+    int status = 0;
+    if (opts->backend == BACKEND_VM) {
+        status = run_vm(program, opts->dump_bytecode);
+    } else {
+        generate_code_to_stream(program, opts, asm_output);
+    }
+
+    stats_begin(PHASE_FREE_AST, NULL);
+    free_ast(program);
+    stats_end(PHASE_FREE_AST);
+    profile_free();
+    stats_report(stderr);
+    return status;
+}
+
+// Drops what a compile left in the modules' state, so the next one starts
+// as the first did; the memory of one an error ended goes back with
+// mem_release_all.
+static void forget_compile(void) {
+    parser_reset();
+    handlers_reset();
+    free_symbol_table();
+    reset_symbol_labels();
+    instrument_reset();
+    profile_free();
+}
+
+void compiler_default_options(CompilerOptions* opts) {
+    default_options(opts);
+}
+
+int compiler_compile(const char* source, size_t length, const CompilerOptions* opts,
+                     const CompilerHooks* hooks, CompileResult* result) {
+
+    memset(result, 0, sizeof(CompileResult));
+    result->allocator = hooks && hooks->allocator ? *hooks->allocator : system_allocator;
+    result->status = 1;
+    Collector collector = { hooks, result };
+    mem_use(hooks ? hooks->allocator : NULL);
+
+    // static: locals changed after setjmp are indeterminate once an error
+    // has jumped back to it
+    static FILE* input;
+    static FILE* asm_output;
+    static char* text;
+    static size_t text_length;
+    input = asm_output = NULL;
+    text = NULL;
+
+    jmp_buf recovery;
+    diagnostics_begin(collect, &collector, &recovery);
+    if (setjmp(recovery) == 0 && trace_open(opts->trace_categories, opts->trace_file) == 0) {
+        stats_open(opts->stats);
+        input = fmemopen((void*)source, length, "r");
+        asm_output = mem_stream(&text, &text_length);
+        if (!input || !asm_output) {
+            out_of_memory("compiler_compile");
+        }
+        int status = run_pipeline(input, opts, asm_output);
+        fclose(asm_output);
+        asm_output = NULL;
+        if (status == 0 && opts->backend == BACKEND_NATIVE) {
+            result->assembly = result_alloc(result, NULL, text_length + 1);
+            if (!result->assembly) {
+                out_of_memory("compiler_compile");
+            }
+            memcpy(result->assembly, text, text_length + 1);
+            result->assembly_length = text_length;
+        }
+        result->status = status;
+    }
+
+    int signo = vm_fault();
+    if (signo) {
+        result->signal = signo;
+        result->status = 128 + signo;
+    }
+
+    // what was traced up to an error is kept
+    trace_close();
+    forget_compile();
+    if (input) fclose(input);
+    mem_release_all();
+    diagnostics_end();
+    mem_use(NULL);
+    return result->status;
+}
+
+void compiler_free_result(CompileResult* result) {
+    Allocator* a = &result->allocator;
+    if (!a->release) return;
+    for (int i = 0; i < result->diagnostic_count; i++) {
+        a->release((void*)result->diagnostics[i].message, a->context);
+    }
+    if (result->diagnostics) a->release(result->diagnostics, a->context);
+    if (result->assembly) a->release(result->assembly, a->context);
+    memset(result, 0, sizeof(CompileResult));
+}
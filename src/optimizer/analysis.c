@@ -0,0 +1,571 @@
+#include "optimizer/analysis.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void nameset_init(NameSet* set) {
+    set->names = NULL;
+    set->count = 0;
+    set->capacity = 0;
+}
+
+void nameset_free(NameSet* set) {
+    for (int i = 0; i < set->count; i++) {
+        mem_free(set->names[i]);
+    }
+    mem_free(set->names);
+    nameset_init(set);
+}
+
+bool nameset_contains(const NameSet* set, const char* name) {
+    for (int i = 0; i < set->count; i++) {
+        if (strcmp(set->names[i], name) == 0) return true;
+    }
+    return false;
+}
+
+bool nameset_add(NameSet* set, const char* name) {
+    if (nameset_contains(set, name)) return false;
+    if (set->count == set->capacity) {
+        set->capacity = set->capacity ? set->capacity * 2 : 8;
+        set->names = mem_realloc(set->names, set->capacity * sizeof(char*));
+        if (!set->names) {
+            out_of_memory("nameset_add");
+        }
+    }
+    set->names[set->count++] = mem_strdup(name);
+    return true;
+}
+
+bool nameset_intersects(const NameSet* a, const NameSet* b) {
+    for (int i = 0; i < a->count; i++) {
+        if (nameset_contains(b, a->names[i])) return true;
+    }
+    return false;
+}
+
+// identifiers whose value is read
+void collect_reads(ASTNode* node, NameSet* out) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_IDENT:
+            nameset_add(out, node->str_value);
+            break;
+        case NODE_PROGRAM:
+            collect_reads(node->program.functions, out);
+            collect_reads(node->program.main_block, out);
+            break;
+        case NODE_FUNC:
+            collect_reads(node->func.body, out);
+            break;
+        case NODE_CALL:
+            collect_reads(node->func_call.args, out);
+            break;
+        case NODE_PRINT:
+            collect_reads(node->print_expr.expr, out);
+            break;
+        case NODE_IF:
+            collect_reads(node->control.condition, out);
+            collect_reads(node->control.if_body, out);
+            collect_reads(node->control.else_body, out);
+            break;
+        case NODE_WHILE:
+            collect_reads(node->control.condition, out);
+            collect_reads(node->control.loop_body, out);
+            break;
+        case NODE_SWITCH:
+            collect_reads(node->switch_stmt.expr, out);
+            collect_reads(node->switch_stmt.cases, out);
+            break;
+        case NODE_CASE:
+            collect_reads(node->case_clause.body, out);
+            break;
+        case NODE_RETURN:
+            collect_reads(node->return_stmt.expr, out);
+            break;
+        case NODE_DECL:
+            collect_reads(node->decl.init_expr, out);
+            break;
+        case NODE_ASSIGN:
+            collect_reads(node->assign.value, out);
+            break;
+        case NODE_BINOP:
+        case NODE_COMPOUND:
+            collect_reads(node->binop.left, out);
+            collect_reads(node->binop.right, out);
+            break;
+        case NODE_UNOP:
+            collect_reads(node->unop.operand, out);
+            break;
+        case NODE_INDEX:
+            collect_reads(node->element.array, out);
+            collect_reads(node->element.index, out);
+            break;
+        case NODE_INDEX_ASSIGN:
+            collect_reads(node->element.index, out);
+            collect_reads(node->element.value, out);
+            break;
+        default:
+            break;
+    }
+}
+
+// variables stored to (a declaration without initializer stores nothing);
+// a store to one element counts as a store to the whole array
+void collect_writes(ASTNode* node, NameSet* out) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_PROGRAM:
+            collect_writes(node->program.functions, out);
+            collect_writes(node->program.main_block, out);
+            break;
+        case NODE_FUNC:
+            collect_params(node, out);
+            collect_writes(node->func.body, out);
+            break;
+        case NODE_IF:
+            collect_writes(node->control.if_body, out);
+            collect_writes(node->control.else_body, out);
+            break;
+        case NODE_WHILE:
+            collect_writes(node->control.loop_body, out);
+            break;
+        case NODE_SWITCH:
+            collect_writes(node->switch_stmt.cases, out);
+            break;
+        case NODE_CASE:
+            collect_writes(node->case_clause.body, out);
+            break;
+        case NODE_DECL:
+            if (node->decl.init_expr) nameset_add(out, node->decl.name);
+            break;
+        case NODE_ASSIGN:
+            nameset_add(out, node->assign.target->str_value);
+            break;
+        case NODE_INDEX_ASSIGN:
+            nameset_add(out, node->element.array->str_value);
+            break;
+        case NODE_COMPOUND:
+            collect_writes(node->binop.left, out);
+            collect_writes(node->binop.right, out);
+            break;
+        default:
+            break;
+    }
+}
+
+void collect_params(ASTNode* func, NameSet* out) {
+    for (ASTNode* p = func->func.params; p; p = p->binop.right) {
+        nameset_add(out, p->binop.left->param.name);
+    }
+}
+
+void collect_declarations(ASTNode* node, NameSet* out) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_PROGRAM:
+            collect_declarations(node->program.functions, out);
+            collect_declarations(node->program.main_block, out);
+            break;
+        case NODE_FUNC:
+            collect_params(node, out);
+            collect_declarations(node->func.body, out);
+            break;
+        case NODE_DECL:
+            nameset_add(out, node->decl.name);
+            break;
+        case NODE_COMPOUND:
+            collect_declarations(node->binop.left, out);
+            collect_declarations(node->binop.right, out);
+            break;
+        case NODE_IF:
+            collect_declarations(node->control.if_body, out);
+            collect_declarations(node->control.else_body, out);
+            break;
+        case NODE_WHILE:
+            collect_declarations(node->control.loop_body, out);
+            break;
+        case NODE_SWITCH:
+            collect_declarations(node->switch_stmt.cases, out);
+            break;
+        case NODE_CASE:
+            collect_declarations(node->case_clause.body, out);
+            break;
+        default:
+            break;
+    }
+}
+
+static void add_type(TypeTable* table, const char* name, const char* type) {
+    if (!nameset_add(&table->names, name)) return;
+    table->types = mem_realloc(table->types, table->names.capacity * sizeof(char*));
+    if (!table->types) {
+        out_of_memory("add_type");
+    }
+    table->types[table->names.count - 1] = mem_strdup(type);
+}
+
+void collect_types(ASTNode* node, TypeTable* out) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_PROGRAM:
+            collect_types(node->program.functions, out);
+            collect_types(node->program.main_block, out);
+            break;
+        case NODE_FUNC:
+            for (ASTNode* p = node->func.params; p; p = p->binop.right) {
+                add_type(out, p->binop.left->param.name, p->binop.left->param.type);
+            }
+            collect_types(node->func.body, out);
+            break;
+        case NODE_DECL:
+            add_type(out, node->decl.name, node->decl.type);
+            break;
+        case NODE_COMPOUND:
+            collect_types(node->binop.left, out);
+            collect_types(node->binop.right, out);
+            break;
+        case NODE_IF:
+            collect_types(node->control.if_body, out);
+            collect_types(node->control.else_body, out);
+            break;
+        case NODE_WHILE:
+            collect_types(node->control.loop_body, out);
+            break;
+        case NODE_SWITCH:
+            collect_types(node->switch_stmt.cases, out);
+            break;
+        case NODE_CASE:
+            collect_types(node->case_clause.body, out);
+            break;
+        default:
+            break;
+    }
+}
+
+const char* type_of(const TypeTable* table, const char* name) {
+    for (int i = 0; i < table->names.count; i++) {
+        if (strcmp(table->names.names[i], name) == 0) return table->types[i];
+    }
+    return "int";
+}
+
+void type_table_free(TypeTable* table) {
+    for (int i = 0; i < table->names.count; i++) mem_free(table->types[i]);
+    mem_free(table->types);
+    table->types = NULL;
+    nameset_free(&table->names);
+}
+
+int count_nodes(ASTNode* node) {
+    if (!node) return 0;
+    switch (node->type) {
+        case NODE_PROGRAM:
+            return 1 + count_nodes(node->program.functions) + count_nodes(node->program.main_block);
+        case NODE_FUNC:
+            return 1 + count_nodes(node->func.params) + count_nodes(node->func.body);
+        case NODE_CALL:
+            return 1 + count_nodes(node->func_call.args);
+        case NODE_PRINT:
+            return 1 + count_nodes(node->print_expr.expr);
+        case NODE_IF:
+            return 1 + count_nodes(node->control.condition) +
+                   count_nodes(node->control.if_body) + count_nodes(node->control.else_body);
+        case NODE_WHILE:
+            return 1 + count_nodes(node->control.condition) + count_nodes(node->control.loop_body);
+        case NODE_SWITCH:
+            return 1 + count_nodes(node->switch_stmt.expr) + count_nodes(node->switch_stmt.cases);
+        case NODE_CASE:
+            return 1 + count_nodes(node->case_clause.body);
+        case NODE_RETURN:
+            return 1 + count_nodes(node->return_stmt.expr);
+        case NODE_DECL:
+            return 1 + count_nodes(node->decl.init_expr);
+        case NODE_ASSIGN:
+            return 1 + count_nodes(node->assign.value);
+        case NODE_BINOP:
+        case NODE_COMPOUND:
+            return 1 + count_nodes(node->binop.left) + count_nodes(node->binop.right);
+        case NODE_UNOP:
+            return 1 + count_nodes(node->unop.operand);
+        case NODE_INDEX:
+        case NODE_INDEX_ASSIGN:
+            return 1 + count_nodes(node->element.index) + count_nodes(node->element.value);
+        default:
+            return 1;
+    }
+}
+
+static bool contains_matching(ASTNode* node, NodeType type, const char* call_name) {
+    if (!node) return false;
+    if (node->type == type) {
+        if (type != NODE_CALL || !call_name) return true;
+        if (strcmp(node->func_call.func_name, call_name) == 0) return true;
+    }
+    switch (node->type) {
+        case NODE_PROGRAM:
+            return contains_matching(node->program.functions, type, call_name) ||
+                   contains_matching(node->program.main_block, type, call_name);
+        case NODE_FUNC:
+            return contains_matching(node->func.body, type, call_name);
+        case NODE_CALL:
+            return contains_matching(node->func_call.args, type, call_name);
+        case NODE_PRINT:
+            return contains_matching(node->print_expr.expr, type, call_name);
+        case NODE_IF:
+            return contains_matching(node->control.condition, type, call_name) ||
+                   contains_matching(node->control.if_body, type, call_name) ||
+                   contains_matching(node->control.else_body, type, call_name);
+        case NODE_WHILE:
+            return contains_matching(node->control.condition, type, call_name) ||
+                   contains_matching(node->control.loop_body, type, call_name);
+        case NODE_SWITCH:
+            return contains_matching(node->switch_stmt.expr, type, call_name) ||
+                   contains_matching(node->switch_stmt.cases, type, call_name);
+        case NODE_CASE:
+            return contains_matching(node->case_clause.body, type, call_name);
+        case NODE_RETURN:
+            return contains_matching(node->return_stmt.expr, type, call_name);
+        case NODE_DECL:
+            return contains_matching(node->decl.init_expr, type, call_name);
+        case NODE_ASSIGN:
+            return contains_matching(node->assign.value, type, call_name);
+        case NODE_BINOP:
+        case NODE_COMPOUND:
+            return contains_matching(node->binop.left, type, call_name) ||
+                   contains_matching(node->binop.right, type, call_name);
+        case NODE_UNOP:
+            return contains_matching(node->unop.operand, type, call_name);
+        case NODE_INDEX:
+        case NODE_INDEX_ASSIGN:
+            return contains_matching(node->element.index, type, call_name) ||
+                   contains_matching(node->element.value, type, call_name);
+        default:
+            return false;
+    }
+}
+
+bool contains_node_type(ASTNode* node, NodeType type) {
+    return contains_matching(node, type, NULL);
+}
+
+bool contains_call_to(ASTNode* node, const char* name) {
+    return contains_matching(node, NODE_CALL, name);
+}
+
+bool same_expr(ASTNode* a, ASTNode* b) {
+    if (!a || !b) return a == b;
+    if (a->type != b->type) return false;
+    switch (a->type) {
+        case NODE_NUM:
+            return a->num_value == b->num_value;
+        case NODE_IDENT:
+            return strcmp(a->str_value, b->str_value) == 0;
+        case NODE_BINOP:
+            return a->binop.op == b->binop.op &&
+                   same_expr(a->binop.left, b->binop.left) &&
+                   same_expr(a->binop.right, b->binop.right);
+        case NODE_UNOP:
+            return a->unop.op == b->unop.op && same_expr(a->unop.operand, b->unop.operand);
+        case NODE_INDEX:
+            return same_expr(a->element.array, b->element.array) &&
+                   same_expr(a->element.index, b->element.index);
+        default:
+            return false;
+    }
+}
+
+bool expr_cannot_fault(ASTNode* node) {
+    switch (node->type) {
+        case NODE_BINOP:
+            if (node->binop.op == OP_DIV || node->binop.op == OP_MOD) {
+                ASTNode* d = node->binop.right;
+                if (d->type != NODE_NUM || d->num_value == 0 || d->num_value == -1) return false;
+            }
+            return expr_cannot_fault(node->binop.left) && expr_cannot_fault(node->binop.right);
+        case NODE_UNOP:
+            return expr_cannot_fault(node->unop.operand);
+        case NODE_NUM:
+        case NODE_IDENT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool breaks_outside_loops(ASTNode* node) {
+    if (!node) return false;
+    switch (node->type) {
+        case NODE_BREAK:
+            return true;
+        case NODE_COMPOUND:
+            return breaks_outside_loops(node->binop.left) ||
+                   breaks_outside_loops(node->binop.right);
+        case NODE_IF:
+            return breaks_outside_loops(node->control.if_body) ||
+                   breaks_outside_loops(node->control.else_body);
+        default:
+            return false;   // a nested loop or switch owns its breaks
+    }
+}
+
+ASTNode* find_function(ASTNode* program, const char* name) {
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        if (strcmp(f->binop.left->func.name, name) == 0) return f->binop.left;
+    }
+    return NULL;
+}
+
+int count_params(ASTNode* func) {
+    int count = 0;
+    for (ASTNode* p = func->func.params; p; p = p->binop.right) count++;
+    return count;
+}
+
+int count_args(ASTNode* call) {
+    int count = 0;
+    for (ASTNode* a = call->func_call.args; a; a = a->binop.right) count++;
+    return count;
+}
+
+static void flatten_into(ASTNode* node, ASTNode*** out, int* count, int* capacity) {
+    if (!node) return;
+    if (node->type == NODE_COMPOUND) {
+        flatten_into(node->binop.left, out, count, capacity);
+        flatten_into(node->binop.right, out, count, capacity);
+        return;
+    }
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 16;
+        *out = mem_realloc(*out, *capacity * sizeof(ASTNode*));
+        if (!*out) {
+            out_of_memory("flatten_statements");
+        }
+    }
+    (*out)[(*count)++] = node;
+}
+
+// the returned array borrows the statements; the compound nodes stay owned by `list`
+int flatten_statements(ASTNode* list, ASTNode*** out) {
+    int count = 0, capacity = 0;
+    *out = NULL;
+    flatten_into(list, out, &count, &capacity);
+    return count;
+}
+
+ASTNode* build_statement_list(ASTNode** stmts, int count) {
+    ASTNode* list = NULL;
+    for (int i = count - 1; i >= 0; i--) {
+        list = create_compound_node(stmts[i], list);
+    }
+    return list ? list : create_compound_node(NULL, NULL);
+}
+
+// frees the compound spine of a list whose statements were moved elsewhere
+void free_statement_list(ASTNode* list) {
+    if (!list || list->type != NODE_COMPOUND) return;
+    free_statement_list(list->binop.left);
+    free_statement_list(list->binop.right);
+    mem_free(list);
+}
+
+void stmt_buffer_push(StmtBuffer* buf, ASTNode* stmt) {
+    if (buf->count == buf->capacity) {
+        buf->capacity = buf->capacity ? buf->capacity * 2 : 16;
+        buf->items = mem_realloc(buf->items, buf->capacity * sizeof(ASTNode*));
+        if (!buf->items) {
+            out_of_memory("stmt_buffer_push");
+        }
+    }
+    buf->items[buf->count++] = stmt;
+}
+
+// appends the statements of `list` and releases its compound spine
+void stmt_buffer_push_list(StmtBuffer* buf, ASTNode* list) {
+    ASTNode** stmts = NULL;
+    int n = flatten_statements(list, &stmts);
+    for (int i = 0; i < n; i++) stmt_buffer_push(buf, stmts[i]);
+    mem_free(stmts);
+    free_statement_list(list);
+}
+
+void collect_callees(ASTNode* node, NameSet* out) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_CALL:
+            nameset_add(out, node->func_call.func_name);
+            collect_callees(node->func_call.args, out);
+            break;
+        case NODE_FUNC:
+            collect_callees(node->func.body, out);
+            break;
+        case NODE_PRINT:
+            collect_callees(node->print_expr.expr, out);
+            break;
+        case NODE_IF:
+            collect_callees(node->control.condition, out);
+            collect_callees(node->control.if_body, out);
+            collect_callees(node->control.else_body, out);
+            break;
+        case NODE_WHILE:
+            collect_callees(node->control.condition, out);
+            collect_callees(node->control.loop_body, out);
+            break;
+        case NODE_SWITCH:
+            collect_callees(node->switch_stmt.expr, out);
+            collect_callees(node->switch_stmt.cases, out);
+            break;
+        case NODE_CASE:
+            collect_callees(node->case_clause.body, out);
+            break;
+        case NODE_RETURN:
+            collect_callees(node->return_stmt.expr, out);
+            break;
+        case NODE_DECL:
+            collect_callees(node->decl.init_expr, out);
+            break;
+        case NODE_ASSIGN:
+            collect_callees(node->assign.value, out);
+            break;
+        case NODE_BINOP:
+        case NODE_COMPOUND:
+            collect_callees(node->binop.left, out);
+            collect_callees(node->binop.right, out);
+            break;
+        case NODE_UNOP:
+            collect_callees(node->unop.operand, out);
+            break;
+        case NODE_INDEX:
+        case NODE_INDEX_ASSIGN:
+            collect_callees(node->element.index, out);
+            collect_callees(node->element.value, out);
+            break;
+        default:
+            break;
+    }
+}
+
+// writes of every function reachable from the calls in `node`
+void collect_expr_call_writes(ASTNode* program, ASTNode* node, NameSet* out) {
+    NameSet pending;
+    nameset_init(&pending);
+    collect_callees(node, &pending);
+    // `pending` only grows, so walking it by index visits each callee once
+    for (int i = 0; i < pending.count; i++) {
+        ASTNode* func = find_function(program, pending.names[i]);
+        if (!func) continue;
+        collect_writes(func, out);
+        collect_callees(func, &pending);
+    }
+    nameset_free(&pending);
+}
+
+void collect_call_writes(ASTNode* program, const char* name, NameSet* out) {
+    ASTNode* func = find_function(program, name);
+    if (!func) return;
+    collect_writes(func, out);
+    collect_expr_call_writes(program, func, out);
+}
@@ -0,0 +1,645 @@
+#include "optimizer/optimizer.h"
+#include "optimizer/analysis.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Compile-time evaluation of calls to pure functions.
+//
+// A function is pure when it prints nothing, only touches its parameters
+// and the variables it declares, and only calls pure functions. Walking each
+// statement list, the pass tracks which variables hold known constants; a
+// call to a pure function whose arguments are all known is run by a small
+// interpreter and replaced by its result. Parameters and locals are global
+// slots, so their final values are stored before the statement unless they
+// already hold them. Values are wrapped to the variable's type on every
+// store, as the generated code truncates them.
+
+typedef struct {
+    char* name;
+    int64_t value;
+} Binding;
+
+typedef struct {
+    Binding* items;
+    int count;
+    int capacity;
+} Env;
+
+static void env_free(Env* env) {
+    for (int i = 0; i < env->count; i++) mem_free(env->items[i].name);
+    mem_free(env->items);
+    env->items = NULL;
+    env->count = env->capacity = 0;
+}
+
+static Binding* env_find(const Env* env, const char* name) {
+    for (int i = 0; i < env->count; i++) {
+        if (strcmp(env->items[i].name, name) == 0) return &env->items[i];
+    }
+    return NULL;
+}
+
+static void env_set(Env* env, const char* name, int64_t value) {
+    Binding* b = env_find(env, name);
+    if (b) {
+        b->value = value;
+        return;
+    }
+    if (env->count == env->capacity) {
+        env->capacity = env->capacity ? env->capacity * 2 : 16;
+        env->items = mem_realloc(env->items, env->capacity * sizeof(Binding));
+        if (!env->items) {
+            out_of_memory("env_set");
+        }
+    }
+    env->items[env->count].name = mem_strdup(name);
+    env->items[env->count].value = value;
+    env->count++;
+}
+
+// env_set of a value as a store to `name` leaves it
+static void env_store(Env* env, const TypeTable* types, const char* name, int64_t value) {
+    env_set(env, name, wrap_to_type(type_of(types, name), value));
+}
+
+static void env_kill(Env* env, const char* name) {
+    Binding* b = env_find(env, name);
+    if (!b) return;
+    mem_free(b->name);
+    *b = env->items[--env->count];
+}
+
+static void env_kill_all(Env* env, const NameSet* names) {
+    for (int i = 0; i < names->count; i++) env_kill(env, names->names[i]);
+}
+
+static Env env_copy(const Env* env) {
+    Env copy = {0};
+    for (int i = 0; i < env->count; i++) env_set(&copy, env->items[i].name, env->items[i].value);
+    return copy;
+}
+
+// --- arithmetic, matching the generated code (64-bit, idiv, masked shifts) ---
+
+static bool apply_binop(Operator op, int64_t x, int64_t y, int64_t* out) {
+    switch (op) {
+        case OP_ADD:    *out = (int64_t)((uint64_t)x + (uint64_t)y); return true;
+        case OP_SUB:    *out = (int64_t)((uint64_t)x - (uint64_t)y); return true;
+        case OP_MUL:    *out = (int64_t)((uint64_t)x * (uint64_t)y); return true;
+        case OP_DIV:
+        case OP_MOD:
+            // leave faulting divisions to run (and fault) at run time
+            if (y == 0 || (x == INT64_MIN && y == -1)) return false;
+            *out = op == OP_DIV ? x / y : x % y;
+            return true;
+        case OP_BAND:   *out = x & y; return true;
+        case OP_BOR:    *out = x | y; return true;
+        case OP_BXOR:   *out = x ^ y; return true;
+        case OP_BNAND:  *out = ~(x & y); return true;
+        case OP_BNOR:   *out = ~(x | y); return true;
+        case OP_BXNOR:  *out = ~(x ^ y); return true;
+        case OP_LSHIFT: *out = (int64_t)((uint64_t)x << (y & 63)); return true;
+        case OP_RSHIFT: *out = x >> (y & 63); return true;
+        case OP_EQ:     *out = x == y; return true;
+        case OP_NEQ:    *out = x != y; return true;
+        case OP_LT:     *out = x < y; return true;
+        case OP_LE:     *out = x <= y; return true;
+        case OP_GT:     *out = x > y; return true;
+        case OP_GE:     *out = x >= y; return true;
+        case OP_LAND:   *out = (x != 0) && (y != 0); return true;
+        case OP_LOR:    *out = (x != 0) || (y != 0); return true;
+        default:        return false;
+    }
+}
+
+static bool apply_unop(Operator op, int64_t x, int64_t* out) {
+    switch (op) {
+        case OP_NEG:  *out = (int64_t)((uint64_t)0 - (uint64_t)x); return true;
+        case OP_POS:  *out = x; return true;
+        case OP_BNOT: *out = ~x; return true;
+        case OP_LNOT: *out = x == 0; return true;
+        default:      return false;
+    }
+}
+
+// --- interpreter for pure function bodies ---
+
+typedef struct {
+    ASTNode* program;
+    const NameSet* pure;
+    const TypeTable* types;
+    Env vars;           // every variable stored during this evaluation
+    long steps;
+    long step_limit;
+    int depth;
+    int depth_limit;
+} Evaluator;
+
+typedef enum { FLOW_NEXT, FLOW_BREAK, FLOW_RETURN, FLOW_FAIL } Flow;
+
+static bool eval_call(Evaluator* ev, ASTNode* func, int64_t* args, int argc, int64_t* out);
+
+static bool eval_expr(Evaluator* ev, ASTNode* node, int64_t* out) {
+    if (++ev->steps > ev->step_limit) return false;
+    switch (node->type) {
+        case NODE_NUM:
+            *out = node->num_value;
+            return true;
+        case NODE_IDENT: {
+            // a variable not stored yet would be read from its global slot
+            Binding* b = env_find(&ev->vars, node->str_value);
+            if (!b) return false;
+            *out = b->value;
+            return true;
+        }
+        case NODE_BINOP: {
+            int64_t x, y;
+            return eval_expr(ev, node->binop.left, &x) &&
+                   eval_expr(ev, node->binop.right, &y) &&
+                   apply_binop(node->binop.op, x, y, out);
+        }
+        case NODE_UNOP: {
+            int64_t x;
+            return eval_expr(ev, node->unop.operand, &x) && apply_unop(node->unop.op, x, out);
+        }
+        case NODE_CALL: {
+            ASTNode* func = find_function(ev->program, node->func_call.func_name);
+            if (!func || !nameset_contains(ev->pure, func->func.name)) return false;
+            int argc = count_args(node);
+            int64_t* args = mem_alloc((argc ? argc : 1) * sizeof(int64_t));
+            if (!args) {
+                out_of_memory("eval_expr");
+            }
+            int i = 0;
+            bool ok = true;
+            for (ASTNode* a = node->func_call.args; a && ok; a = a->binop.right) {
+                ok = eval_expr(ev, a->binop.left, &args[i++]);
+            }
+            ok = ok && eval_call(ev, func, args, argc, out);
+            mem_free(args);
+            return ok;
+        }
+        default:
+            return false;
+    }
+}
+
+static Flow eval_stmt(Evaluator* ev, ASTNode* node, int64_t* ret) {
+    if (!node) return FLOW_NEXT;
+    if (++ev->steps > ev->step_limit) return FLOW_FAIL;
+    int64_t value;
+    switch (node->type) {
+        case NODE_COMPOUND: {
+            Flow flow = eval_stmt(ev, node->binop.left, ret);
+            if (flow != FLOW_NEXT) return flow;
+            return eval_stmt(ev, node->binop.right, ret);
+        }
+        case NODE_DECL:
+            if (!node->decl.init_expr) return FLOW_NEXT;
+            if (!eval_expr(ev, node->decl.init_expr, &value)) return FLOW_FAIL;
+            env_store(&ev->vars, ev->types, node->decl.name, value);
+            return FLOW_NEXT;
+        case NODE_ASSIGN:
+            if (!eval_expr(ev, node->assign.value, &value)) return FLOW_FAIL;
+            env_store(&ev->vars, ev->types, node->assign.target->str_value, value);
+            return FLOW_NEXT;
+        case NODE_IF:
+            if (!eval_expr(ev, node->control.condition, &value)) return FLOW_FAIL;
+            return eval_stmt(ev, value ? node->control.if_body : node->control.else_body, ret);
+        case NODE_WHILE:
+            for (;;) {
+                if (!eval_expr(ev, node->control.condition, &value)) return FLOW_FAIL;
+                if (!value) return FLOW_NEXT;
+                Flow flow = eval_stmt(ev, node->control.loop_body, ret);
+                if (flow == FLOW_BREAK) return FLOW_NEXT;
+                if (flow != FLOW_NEXT) return flow;
+            }
+        case NODE_SWITCH: {
+            if (!eval_expr(ev, node->switch_stmt.expr, &value)) return FLOW_FAIL;
+            ASTNode* start = NULL;
+            for (ASTNode* c = node->switch_stmt.cases; c && !start; c = c->binop.right) {
+                ASTNode* clause = c->binop.left;
+                if (!clause->case_clause.is_default && clause->case_clause.value == value) start = c;
+            }
+            for (ASTNode* c = node->switch_stmt.cases; c && !start; c = c->binop.right) {
+                if (c->binop.left->case_clause.is_default) start = c;
+            }
+            // from the matching clause on, falling through the rest
+            for (ASTNode* c = start; c; c = c->binop.right) {
+                Flow flow = eval_stmt(ev, c->binop.left->case_clause.body, ret);
+                if (flow == FLOW_BREAK) return FLOW_NEXT;
+                if (flow != FLOW_NEXT) return flow;
+            }
+            return FLOW_NEXT;
+        }
+        case NODE_BREAK:
+            return FLOW_BREAK;
+        case NODE_RETURN:
+            if (!node->return_stmt.expr) {
+                *ret = 0;
+            } else if (!eval_expr(ev, node->return_stmt.expr, ret)) {
+                return FLOW_FAIL;
+            }
+            return FLOW_RETURN;
+        case NODE_EMPTY:
+            return FLOW_NEXT;
+        default:
+            return FLOW_FAIL;
+    }
+}
+
+static bool eval_call(Evaluator* ev, ASTNode* func, int64_t* args, int argc, int64_t* out) {
+    if (argc != count_params(func) || ev->depth >= ev->depth_limit) return false;
+    int i = 0;
+    for (ASTNode* p = func->func.params; p; p = p->binop.right) {
+        env_store(&ev->vars, ev->types, p->binop.left->param.name, args[i++]);
+    }
+    ev->depth++;
+    Flow flow = eval_stmt(ev, func->func.body, out);
+    ev->depth--;
+    // falling off the end returns whatever rax held
+    return flow == FLOW_RETURN;
+}
+
+// --- purity ---
+
+static bool only_own_variables(ASTNode* func) {
+    NameSet own, used;
+    nameset_init(&own);
+    nameset_init(&used);
+    collect_declarations(func, &own);
+    collect_reads(func->func.body, &used);
+    collect_writes(func->func.body, &used);
+    bool ok = true;
+    for (int i = 0; i < used.count && ok; i++) {
+        ok = nameset_contains(&own, used.names[i]);
+    }
+    nameset_free(&own);
+    nameset_free(&used);
+    return ok;
+}
+
+static bool calls_only(ASTNode* node, const NameSet* pure) {
+    if (!node) return true;
+    switch (node->type) {
+        case NODE_CALL:
+            if (!nameset_contains(pure, node->func_call.func_name)) return false;
+            return calls_only(node->func_call.args, pure);
+        case NODE_PRINT:
+            return calls_only(node->print_expr.expr, pure);
+        case NODE_IF:
+            return calls_only(node->control.condition, pure) &&
+                   calls_only(node->control.if_body, pure) &&
+                   calls_only(node->control.else_body, pure);
+        case NODE_WHILE:
+            return calls_only(node->control.condition, pure) &&
+                   calls_only(node->control.loop_body, pure);
+        case NODE_SWITCH:
+            return calls_only(node->switch_stmt.expr, pure) &&
+                   calls_only(node->switch_stmt.cases, pure);
+        case NODE_CASE:
+            return calls_only(node->case_clause.body, pure);
+        case NODE_RETURN:
+            return calls_only(node->return_stmt.expr, pure);
+        case NODE_DECL:
+            return calls_only(node->decl.init_expr, pure);
+        case NODE_ASSIGN:
+            return calls_only(node->assign.value, pure);
+        case NODE_BINOP:
+        case NODE_COMPOUND:
+            return calls_only(node->binop.left, pure) && calls_only(node->binop.right, pure);
+        case NODE_UNOP:
+            return calls_only(node->unop.operand, pure);
+        case NODE_INDEX:
+        case NODE_INDEX_ASSIGN:
+            return calls_only(node->element.index, pure) && calls_only(node->element.value, pure);
+        default:
+            return true;
+    }
+}
+
+static void find_pure_functions(ASTNode* program, NameSet* pure) {
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        ASTNode* func = f->binop.left;
+        if (!contains_node_type(func->func.body, NODE_PRINT) && only_own_variables(func)) {
+            nameset_add(pure, func->func.name);
+        }
+    }
+    // drop functions calling impure ones until nothing changes
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < pure->count; i++) {
+            ASTNode* func = find_function(program, pure->names[i]);
+            if (!calls_only(func->func.body, pure)) {
+                mem_free(pure->names[i]);
+                pure->names[i] = pure->names[--pure->count];
+                changed = true;
+                break;
+            }
+        }
+    }
+}
+
+// --- the pass ---
+
+typedef struct {
+    ASTNode* program;
+    NameSet pure;
+    TypeTable types;
+    long step_limit;
+    int depth_limit;
+    int folded;
+} Folder;
+
+// value of an expression from the constants known at this point, without calls
+static bool known_value(const Env* env, ASTNode* node, int64_t* out) {
+    switch (node->type) {
+        case NODE_NUM:
+            *out = node->num_value;
+            return true;
+        case NODE_IDENT: {
+            Binding* b = env_find(env, node->str_value);
+            if (!b) return false;
+            *out = b->value;
+            return true;
+        }
+        case NODE_BINOP: {
+            int64_t x, y;
+            return known_value(env, node->binop.left, &x) &&
+                   known_value(env, node->binop.right, &y) &&
+                   apply_binop(node->binop.op, x, y, out);
+        }
+        case NODE_UNOP: {
+            int64_t x;
+            return known_value(env, node->unop.operand, &x) && apply_unop(node->unop.op, x, out);
+        }
+        default:
+            return false;
+    }
+}
+
+static int count_calls(ASTNode* node) {
+    if (!node) return 0;
+    switch (node->type) {
+        case NODE_CALL:
+            return 1 + count_calls(node->func_call.args);
+        case NODE_BINOP:
+            return count_calls(node->binop.left) + count_calls(node->binop.right);
+        case NODE_UNOP:
+            return count_calls(node->unop.operand);
+        default:
+            return 0;
+    }
+}
+
+static void collect_other_call_writes(ASTNode* program, ASTNode* node, ASTNode* skip, NameSet* out) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_CALL:
+            if (node != skip) collect_call_writes(program, node->func_call.func_name, out);
+            for (ASTNode* a = node->func_call.args; a; a = a->binop.right) {
+                collect_other_call_writes(program, a->binop.left, skip, out);
+            }
+            return;
+        case NODE_BINOP:
+            collect_other_call_writes(program, node->binop.left, skip, out);
+            collect_other_call_writes(program, node->binop.right, skip, out);
+            return;
+        case NODE_UNOP:
+            collect_other_call_writes(program, node->unop.operand, skip, out);
+            return;
+        default:
+            return;
+    }
+}
+
+// Folds the pure calls inside *slot, innermost first. `stmt_expr` is the whole
+// expression of the statement: stores of the callee's final variable values
+// are hoisted in front of it, which is only allowed when the statement reads
+// none of them and contains no other call that could observe them early.
+static void fold_calls(Folder* fd, Env* env, ASTNode* stmt_expr, ASTNode** slot, StmtBuffer* out) {
+    ASTNode* node = *slot;
+    if (!node) return;
+    switch (node->type) {
+        case NODE_BINOP:
+            fold_calls(fd, env, stmt_expr, &node->binop.left, out);
+            fold_calls(fd, env, stmt_expr, &node->binop.right, out);
+            return;
+        case NODE_UNOP:
+            fold_calls(fd, env, stmt_expr, &node->unop.operand, out);
+            return;
+        case NODE_CALL:
+            break;
+        default:
+            return;
+    }
+
+    for (ASTNode* a = node->func_call.args; a; a = a->binop.right) {
+        fold_calls(fd, env, stmt_expr, &a->binop.left, out);
+    }
+
+    ASTNode* func = find_function(fd->program, node->func_call.func_name);
+    if (!func || !nameset_contains(&fd->pure, func->func.name)) return;
+
+    int argc = count_args(node);
+    int64_t* args = mem_alloc((argc ? argc : 1) * sizeof(int64_t));
+    if (!args) {
+        out_of_memory("fold_calls");
+    }
+    // an argument is only known if no other call in the statement can store
+    // to what it reads before it is evaluated
+    NameSet clobbered, reads;
+    nameset_init(&clobbered);
+    nameset_init(&reads);
+    collect_other_call_writes(fd->program, stmt_expr, node, &clobbered);
+    collect_reads(node->func_call.args, &reads);
+    bool ok = !nameset_intersects(&clobbered, &reads);
+    nameset_free(&clobbered);
+    nameset_free(&reads);
+
+    int i = 0;
+    for (ASTNode* a = node->func_call.args; a && ok; a = a->binop.right) {
+        ok = known_value(env, a->binop.left, &args[i++]);
+    }
+
+    Evaluator ev = {0};
+    ev.program = fd->program;
+    ev.pure = &fd->pure;
+    ev.types = &fd->types;
+    ev.step_limit = fd->step_limit;
+    ev.depth_limit = fd->depth_limit;
+    int64_t result = 0;
+    ok = ok && eval_call(&ev, func, args, argc, &result);
+    mem_free(args);
+
+    // stores needed to leave the variables as the call would
+    Env stores = {0};
+    for (i = 0; ok && i < ev.vars.count; i++) {
+        Binding* known = env_find(env, ev.vars.items[i].name);
+        if (known && known->value == ev.vars.items[i].value) continue;
+        env_set(&stores, ev.vars.items[i].name, ev.vars.items[i].value);
+    }
+    if (ok && stores.count > 0) {
+        NameSet stmt_reads;
+        nameset_init(&stmt_reads);
+        collect_reads(stmt_expr, &stmt_reads);
+        for (i = 0; i < stores.count && ok; i++) {
+            ok = !nameset_contains(&stmt_reads, stores.items[i].name);
+        }
+        nameset_free(&stmt_reads);
+        // the call being folded is still in the tree; any other is one too many
+        ok = ok && count_calls(stmt_expr) <= 1;
+    }
+
+    if (ok) {
+        for (i = 0; i < stores.count; i++) {
+            stmt_buffer_push(out, create_decl_node((char*)type_of(&fd->types, stores.items[i].name),
+                                                   stores.items[i].name,
+                                                   create_num_node(stores.items[i].value)));
+            env_set(env, stores.items[i].name, stores.items[i].value);
+        }
+        *slot = create_num_node(result);
+        free_ast(node);
+        fd->folded++;
+    }
+    env_free(&stores);
+    env_free(&ev.vars);
+}
+
+static void fold_list(Folder* fd, Env* env, ASTNode** list_slot);
+
+static void kill_calls(Folder* fd, Env* env, ASTNode* node) {
+    NameSet writes;
+    nameset_init(&writes);
+    collect_expr_call_writes(fd->program, node, &writes);
+    env_kill_all(env, &writes);
+    nameset_free(&writes);
+}
+
+static void kill_writes(Folder* fd, Env* env, ASTNode* node) {
+    NameSet writes;
+    nameset_init(&writes);
+    collect_writes(node, &writes);
+    collect_expr_call_writes(fd->program, node, &writes);
+    env_kill_all(env, &writes);
+    nameset_free(&writes);
+}
+
+static void fold_statement(Folder* fd, Env* env, ASTNode* stmt, StmtBuffer* out) {
+    int64_t value;
+    switch (stmt->type) {
+        case NODE_DECL:
+        case NODE_ASSIGN: {
+            ASTNode** slot = stmt->type == NODE_DECL ? &stmt->decl.init_expr : &stmt->assign.value;
+            const char* target = stmt->type == NODE_DECL ? stmt->decl.name
+                                                         : stmt->assign.target->str_value;
+            if (!*slot) break;
+            fold_calls(fd, env, *slot, slot, out);
+            kill_calls(fd, env, *slot);
+            if (known_value(env, *slot, &value)) {
+                env_store(env, &fd->types, target, value);
+            } else {
+                env_kill(env, target);
+            }
+            break;
+        }
+        case NODE_PRINT:
+            fold_calls(fd, env, stmt->print_expr.expr, &stmt->print_expr.expr, out);
+            kill_calls(fd, env, stmt->print_expr.expr);
+            break;
+        case NODE_INDEX_ASSIGN:
+            fold_calls(fd, env, stmt->element.index, &stmt->element.index, out);
+            kill_calls(fd, env, stmt->element.index);
+            fold_calls(fd, env, stmt->element.value, &stmt->element.value, out);
+            kill_calls(fd, env, stmt->element.value);
+            break;
+        case NODE_RETURN:
+            if (stmt->return_stmt.expr) {
+                fold_calls(fd, env, stmt->return_stmt.expr, &stmt->return_stmt.expr, out);
+            }
+            break;
+        case NODE_IF: {
+            fold_calls(fd, env, stmt->control.condition, &stmt->control.condition, out);
+            kill_calls(fd, env, stmt->control.condition);
+            Env then_env = env_copy(env);
+            Env else_env = env_copy(env);
+            fold_list(fd, &then_env, &stmt->control.if_body);
+            if (stmt->control.else_body) fold_list(fd, &else_env, &stmt->control.else_body);
+            env_free(&then_env);
+            env_free(&else_env);
+            kill_writes(fd, env, stmt->control.if_body);
+            kill_writes(fd, env, stmt->control.else_body);
+            break;
+        }
+        case NODE_WHILE: {
+            // anything the loop stores is unknown on every iteration
+            kill_writes(fd, env, stmt->control.loop_body);
+            kill_calls(fd, env, stmt->control.condition);
+            Env body_env = env_copy(env);
+            fold_list(fd, &body_env, &stmt->control.loop_body);
+            env_free(&body_env);
+            break;
+        }
+        case NODE_SWITCH: {
+            fold_calls(fd, env, stmt->switch_stmt.expr, &stmt->switch_stmt.expr, out);
+            kill_calls(fd, env, stmt->switch_stmt.expr);
+            // a clause may be entered by falling out of any clause before it
+            kill_writes(fd, env, stmt->switch_stmt.cases);
+            for (ASTNode* c = stmt->switch_stmt.cases; c; c = c->binop.right) {
+                Env case_env = env_copy(env);
+                fold_list(fd, &case_env, &c->binop.left->case_clause.body);
+                env_free(&case_env);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+    stmt_buffer_push(out, stmt);
+}
+
+static void fold_list(Folder* fd, Env* env, ASTNode** list_slot) {
+    if (!*list_slot) return;
+    ASTNode** stmts = NULL;
+    int n = flatten_statements(*list_slot, &stmts);
+    StmtBuffer out = {0};
+    for (int i = 0; i < n; i++) {
+        fold_statement(fd, env, stmts[i], &out);
+    }
+    free_statement_list(*list_slot);
+    *list_slot = build_statement_list(out.items, out.count);
+    mem_free(out.items);
+    mem_free(stmts);
+}
+
+int fold_pure_calls(ASTNode* program, long step_limit, int depth_limit) {
+    Folder fd = {0};
+    fd.program = program;
+    fd.step_limit = step_limit;
+    fd.depth_limit = depth_limit;
+    nameset_init(&fd.pure);
+    nameset_init(&fd.types.names);
+    find_pure_functions(program, &fd.pure);
+    collect_types(program, &fd.types);
+
+    if (fd.pure.count > 0) {
+        for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+            Env env = {0};
+            fold_list(&fd, &env, &f->binop.left->func.body);
+            env_free(&env);
+        }
+        Env env = {0};
+        fold_list(&fd, &env, &program->program.main_block);
+        env_free(&env);
+    }
+
+    nameset_free(&fd.pure);
+    type_table_free(&fd.types);
+    return fd.folded;
+}
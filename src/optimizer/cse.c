@@ -0,0 +1,289 @@
+#include "optimizer/optimizer.h"
+#include "optimizer/analysis.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Common subexpression elimination by value numbering over the statement
+// tree.
+//
+// Every call-free BINOP/UNOP subtree evaluated by a statement becomes an
+// available value until a statement (or a call) stores to a variable it
+// reads. A later subtree equal to an available one reuses it: the first
+// occurrence is moved into a `cse.N` temporary declared right before its
+// statement, and both places read the temporary. Values available before an
+// `if` stay available in both arms, and those the loop never invalidates
+// stay available inside a `while` body, so reuse follows the dominator tree
+// of the structured program. Children are numbered before their parents, so
+// temporaries are always declared before the ones built from them.
+
+typedef struct Block Block;
+
+typedef struct {
+    ASTNode* node;      // first occurrence
+    ASTNode** slot;     // where it sits in its statement
+    Block* block;       // block and statement index the temporary goes before
+    int index;
+    char* temp;         // NULL until the value is reused
+    NameSet reads;
+} Value;
+
+typedef struct {
+    Value** items;
+    int count;
+    int capacity;
+} ValueList;
+
+struct Block {
+    ASTNode** stmts;
+    StmtBuffer* prefixes;   // temporaries declared in front of each statement
+    int count;
+    ValueList numbered;     // values first seen in this block
+};
+
+typedef struct {
+    ASTNode* program;
+    int temp_counter;
+    int reused;
+} Cse;
+
+static void values_push(ValueList* list, Value* value) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity ? list->capacity * 2 : 16;
+        list->items = mem_realloc(list->items, list->capacity * sizeof(Value*));
+        if (!list->items) {
+            out_of_memory("values_push");
+        }
+    }
+    list->items[list->count++] = value;
+}
+
+static ValueList values_copy(const ValueList* list) {
+    ValueList copy = {0};
+    for (int i = 0; i < list->count; i++) values_push(&copy, list->items[i]);
+    return copy;
+}
+
+// drops every value reading one of `written`
+static void values_kill(ValueList* list, const NameSet* written) {
+    int kept = 0;
+    for (int i = 0; i < list->count; i++) {
+        if (!nameset_intersects(&list->items[i]->reads, written)) {
+            list->items[kept++] = list->items[i];
+        }
+    }
+    list->count = kept;
+}
+
+static void values_free(ValueList* list) {
+    for (int i = 0; i < list->count; i++) {
+        nameset_free(&list->items[i]->reads);
+        mem_free(list->items[i]->temp);
+        mem_free(list->items[i]);
+    }
+    mem_free(list->items);
+}
+
+static const char* materialize(Cse* c, Value* value) {
+    if (value->temp) return value->temp;
+    char name[64];
+    snprintf(name, sizeof(name), "cse.%d", c->temp_counter++);
+    value->temp = mem_strdup(name);
+    stmt_buffer_push(&value->block->prefixes[value->index],
+                     create_decl_node("int", name, value->node));
+    *value->slot = create_ident_node(name);
+    return value->temp;
+}
+
+typedef struct {
+    Cse* cse;
+    ValueList* values;
+    Block* block;
+    int index;
+    const NameSet* clobbered;   // stored by calls in the statement
+} Numbering;
+
+// `x + c` or `x - c` for a constant c
+static bool is_offset_index(ASTNode* index) {
+    return index->type == NODE_BINOP && (index->binop.op == OP_ADD || index->binop.op == OP_SUB) &&
+           index->binop.right->type == NODE_NUM;
+}
+
+static void number_expr(Numbering* n, ASTNode** slot) {
+    ASTNode* node = *slot;
+    if (!node) return;
+    switch (node->type) {
+        case NODE_BINOP:
+            number_expr(n, &node->binop.left);
+            number_expr(n, &node->binop.right);
+            break;
+        case NODE_UNOP:
+            number_expr(n, &node->unop.operand);
+            break;
+        case NODE_CALL:
+            for (ASTNode* a = node->func_call.args; a; a = a->binop.right) {
+                number_expr(n, &a->binop.left);
+            }
+            return;
+        case NODE_INDEX: {
+            // `a[i + c]` keeps its index: the constant becomes part of the
+            // address, and element-wise loops stay recognisable
+            ASTNode** index = &node->element.index;
+            if (is_offset_index(*index)) index = &(*index)->binop.left;
+            number_expr(n, index);
+            return;
+        }
+        default:
+            return;
+    }
+    if (!expr_cannot_fault(node)) return;
+
+    NameSet reads;
+    nameset_init(&reads);
+    collect_reads(node, &reads);
+    if (nameset_intersects(&reads, n->clobbered)) {
+        nameset_free(&reads);
+        return;
+    }
+    for (int i = 0; i < n->values->count; i++) {
+        Value* value = n->values->items[i];
+        if (value->node == node || !same_expr(value->node, node)) continue;
+        *slot = create_ident_node((char*)materialize(n->cse, value));
+        free_ast(node);
+        nameset_free(&reads);
+        n->cse->reused++;
+        return;
+    }
+
+    Value* value = mem_calloc(1, sizeof(Value));
+    if (!value) {
+        out_of_memory("number_expr");
+    }
+    value->node = node;
+    value->slot = slot;
+    value->block = n->block;
+    value->index = n->index;
+    value->reads = reads;
+    values_push(n->values, value);
+    values_push(&n->block->numbered, value);
+}
+
+// numbers the expression of one statement, then invalidates what it stores
+static void number_statement_expr(Cse* c, ValueList* values, Block* block, int index,
+                                  ASTNode** slot, const char* target) {
+    NameSet written;
+    nameset_init(&written);
+    if (*slot) collect_expr_call_writes(c->program, *slot, &written);
+    Numbering n = { c, values, block, index, &written };
+    number_expr(&n, slot);
+    if (target) nameset_add(&written, target);
+    values_kill(values, &written);
+    nameset_free(&written);
+}
+
+// numbers a nested statement list; values from `outer` stay available in
+// it, values first seen in it are dropped at its end
+static void cse_list(Cse* c, const ValueList* outer, ASTNode** list_slot);
+
+static void kill_stored_in(Cse* c, ValueList* values, ASTNode* node) {
+    NameSet written;
+    nameset_init(&written);
+    collect_writes(node, &written);
+    collect_expr_call_writes(c->program, node, &written);
+    values_kill(values, &written);
+    nameset_free(&written);
+}
+
+static void cse_statement(Cse* c, ValueList* values, Block* block, int index) {
+    ASTNode* stmt = block->stmts[index];
+    switch (stmt->type) {
+        case NODE_PRINT:
+            number_statement_expr(c, values, block, index, &stmt->print_expr.expr, NULL);
+            break;
+        case NODE_DECL:
+            if (stmt->decl.init_expr) {
+                number_statement_expr(c, values, block, index, &stmt->decl.init_expr, stmt->decl.name);
+            }
+            break;
+        case NODE_ASSIGN:
+            number_statement_expr(c, values, block, index, &stmt->assign.value,
+                                  stmt->assign.target->str_value);
+            break;
+        case NODE_RETURN:
+            number_statement_expr(c, values, block, index, &stmt->return_stmt.expr, NULL);
+            break;
+        case NODE_INDEX_ASSIGN:
+            number_statement_expr(c, values, block, index, &stmt->element.index, NULL);
+            number_statement_expr(c, values, block, index, &stmt->element.value,
+                                  stmt->element.array->str_value);
+            break;
+        case NODE_IF: {
+            number_statement_expr(c, values, block, index, &stmt->control.condition, NULL);
+            cse_list(c, values, &stmt->control.if_body);
+            cse_list(c, values, &stmt->control.else_body);
+            kill_stored_in(c, values, stmt);
+            break;
+        }
+        case NODE_WHILE: {
+            // only values the loop leaves alone are the same on every iteration
+            kill_stored_in(c, values, stmt);
+            cse_list(c, values, &stmt->control.loop_body);
+            break;
+        }
+        case NODE_SWITCH: {
+            number_statement_expr(c, values, block, index, &stmt->switch_stmt.expr, NULL);
+            // a clause is also entered by falling out of the one before it
+            kill_stored_in(c, values, stmt);
+            for (ASTNode* clause = stmt->switch_stmt.cases; clause; clause = clause->binop.right) {
+                cse_list(c, values, &clause->binop.left->case_clause.body);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void cse_list(Cse* c, const ValueList* outer, ASTNode** list_slot) {
+    if (!*list_slot) return;
+    Block block = {0};
+    block.count = flatten_statements(*list_slot, &block.stmts);
+    block.prefixes = mem_calloc(block.count ? block.count : 1, sizeof(StmtBuffer));
+    if (!block.prefixes) {
+        out_of_memory("cse_list");
+    }
+    ValueList values = values_copy(outer);
+    for (int i = 0; i < block.count; i++) {
+        cse_statement(c, &values, &block, i);
+    }
+    mem_free(values.items);
+
+    StmtBuffer out = {0};
+    for (int i = 0; i < block.count; i++) {
+        for (int j = 0; j < block.prefixes[i].count; j++) {
+            stmt_buffer_push(&out, block.prefixes[i].items[j]);
+        }
+        mem_free(block.prefixes[i].items);
+        stmt_buffer_push(&out, block.stmts[i]);
+    }
+    free_statement_list(*list_slot);
+    *list_slot = build_statement_list(out.items, out.count);
+    mem_free(out.items);
+    mem_free(block.prefixes);
+    mem_free(block.stmts);
+    values_free(&block.numbered);
+}
+
+int eliminate_common_subexpressions(ASTNode* program) {
+    Cse c = {0};
+    c.program = program;
+    ValueList none = {0};
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        cse_list(&c, &none, &f->binop.left->func.body);
+    }
+    cse_list(&c, &none, &program->program.main_block);
+    return c.reused;
+}
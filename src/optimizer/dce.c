@@ -0,0 +1,439 @@
+#include "optimizer/optimizer.h"
+#include "optimizer/analysis.h"
+#include "driver/memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Dead code elimination, in three steps:
+//
+//  1. unreachable statements: anything after a `return`, a `break`, an
+//     `if`/`else` whose arms both leave, or a `while` on a nonzero constant
+//     that never breaks; `if`s and `while`s on constant conditions lose the
+//     arm (or loop) that cannot run
+//  2. dead stores: an assignment whose value is overwritten or never
+//     observed before the variable is read again. Liveness runs backwards
+//     over each statement list; since variables are global slots, a call or
+//     leaving a function (other than main, after which the program exits)
+//     counts as reading every variable
+//  3. unreachable functions: those not in the call graph rooted at `main`,
+//     or at the main block when there is no main function
+//
+// Declarations are kept as long as a remaining statement names the
+// variable, so the symbol table the backends build is unchanged.
+
+typedef struct {
+    ASTNode* program;
+    NameSet universe;   // every variable that is ever stored
+    NameSet never_read;
+    DceStats stats;
+} Dce;
+
+// --- name set helpers for the liveness state ---
+
+static void nameset_remove_all(NameSet* set, const NameSet* other) {
+    int kept = 0;
+    for (int i = 0; i < set->count; i++) {
+        if (nameset_contains(other, set->names[i])) {
+            mem_free(set->names[i]);
+        } else {
+            set->names[kept++] = set->names[i];
+        }
+    }
+    set->count = kept;
+}
+
+static void nameset_retain(NameSet* set, const NameSet* other) {
+    int kept = 0;
+    for (int i = 0; i < set->count; i++) {
+        if (nameset_contains(other, set->names[i])) {
+            set->names[kept++] = set->names[i];
+        } else {
+            mem_free(set->names[i]);
+        }
+    }
+    set->count = kept;
+}
+
+static void nameset_clear(NameSet* set) {
+    for (int i = 0; i < set->count; i++) mem_free(set->names[i]);
+    set->count = 0;
+}
+
+static void nameset_assign(NameSet* set, const NameSet* other) {
+    nameset_clear(set);
+    for (int i = 0; i < other->count; i++) nameset_add(set, other->names[i]);
+}
+
+// --- 1. unreachable statements ---
+
+static bool leaves(ASTNode* stmt);
+
+static bool list_leaves(ASTNode* list) {
+    ASTNode** stmts = NULL;
+    int n = flatten_statements(list, &stmts);
+    bool result = n > 0 && leaves(stmts[n - 1]);
+    mem_free(stmts);
+    return result;
+}
+
+// control never reaches the statement after `stmt`
+static bool leaves(ASTNode* stmt) {
+    switch (stmt->type) {
+        case NODE_RETURN:
+        case NODE_BREAK:
+            return true;
+        case NODE_IF:
+            return stmt->control.else_body &&
+                   list_leaves(stmt->control.if_body) && list_leaves(stmt->control.else_body);
+        case NODE_WHILE:
+            return stmt->control.condition->type == NODE_NUM &&
+                   stmt->control.condition->num_value != 0 &&
+                   !breaks_outside_loops(stmt->control.loop_body);
+        default:
+            return false;
+    }
+}
+
+static int count_statements(ASTNode* list) {
+    ASTNode** stmts = NULL;
+    int n = flatten_statements(list, &stmts);
+    mem_free(stmts);
+    return n;
+}
+
+static void prune_list(Dce* d, ASTNode** list_slot);
+
+// pushes what remains of `stmt` onto out; returns true if control leaves
+static bool prune_statement(Dce* d, ASTNode* stmt, StmtBuffer* out) {
+    switch (stmt->type) {
+        case NODE_IF: {
+            prune_list(d, &stmt->control.if_body);
+            prune_list(d, &stmt->control.else_body);
+            if (stmt->control.condition->type != NODE_NUM) break;
+            // constant condition: keep the statements of the arm that runs
+            bool taken = stmt->control.condition->num_value != 0;
+            ASTNode** kept = taken ? &stmt->control.if_body : &stmt->control.else_body;
+            ASTNode** dropped = taken ? &stmt->control.else_body : &stmt->control.if_body;
+            d->stats.unreachable += count_statements(*dropped);
+            ASTNode** stmts = NULL;
+            int n = flatten_statements(*kept, &stmts);
+            free_statement_list(*kept);
+            *kept = NULL;
+            bool left = false;
+            for (int i = 0; i < n; i++) {
+                if (left) {
+                    free_ast(stmts[i]);
+                } else {
+                    stmt_buffer_push(out, stmts[i]);
+                    left = leaves(stmts[i]);
+                }
+            }
+            mem_free(stmts);
+            free_ast(stmt);
+            return left;
+        }
+        case NODE_WHILE:
+            prune_list(d, &stmt->control.loop_body);
+            if (stmt->control.condition->type == NODE_NUM && stmt->control.condition->num_value == 0) {
+                d->stats.unreachable += 1 + count_statements(stmt->control.loop_body);
+                free_ast(stmt);
+                return false;
+            }
+            break;
+        case NODE_SWITCH:
+            for (ASTNode* c = stmt->switch_stmt.cases; c; c = c->binop.right) {
+                prune_list(d, &c->binop.left->case_clause.body);
+            }
+            break;
+        default:
+            break;
+    }
+    stmt_buffer_push(out, stmt);
+    return leaves(stmt);
+}
+
+static void prune_list(Dce* d, ASTNode** list_slot) {
+    if (!*list_slot) return;
+    ASTNode** stmts = NULL;
+    int n = flatten_statements(*list_slot, &stmts);
+    // statements may be freed below; drop the old spine while they are intact
+    free_statement_list(*list_slot);
+    StmtBuffer out = {0};
+    int i = 0;
+    while (i < n && !prune_statement(d, stmts[i], &out)) i++;
+    for (i++; i < n; i++) {
+        d->stats.unreachable++;
+        free_ast(stmts[i]);
+    }
+    *list_slot = build_statement_list(out.items, out.count);
+    mem_free(out.items);
+    mem_free(stmts);
+}
+
+// --- 2. dead stores ---
+
+// the statement reads `node`'s variables; a call may read any of them
+static void mark_read(NameSet* dead, ASTNode* node) {
+    if (!node) return;
+    if (contains_node_type(node, NODE_CALL)) {
+        nameset_clear(dead);
+        return;
+    }
+    NameSet reads;
+    nameset_init(&reads);
+    collect_reads(node, &reads);
+    nameset_remove_all(dead, &reads);
+    nameset_free(&reads);
+}
+
+static bool store_is_dead(Dce* d, const NameSet* dead, const char* name, ASTNode* value) {
+    if (!nameset_contains(dead, name) && !nameset_contains(&d->never_read, name)) return false;
+    // the value itself must be safe to skip
+    return expr_cannot_fault(value);
+}
+
+// `dead` holds the variables whose value is not observed after the list;
+// on return it holds those not observed from its start
+static void dse_list(Dce* d, ASTNode** list_slot, NameSet* dead, const NameSet* exit_dead);
+
+static void dse_statement(Dce* d, ASTNode** slot, NameSet* dead, const NameSet* exit_dead) {
+    ASTNode* stmt = *slot;
+    switch (stmt->type) {
+        case NODE_DECL:
+            if (!stmt->decl.init_expr) break;
+            if (store_is_dead(d, dead, stmt->decl.name, stmt->decl.init_expr)) {
+                // keep the declaration, drop the store
+                free_ast(stmt->decl.init_expr);
+                stmt->decl.init_expr = NULL;
+                d->stats.dead_stores++;
+                break;
+            }
+            nameset_add(dead, stmt->decl.name);
+            mark_read(dead, stmt->decl.init_expr);
+            break;
+        case NODE_ASSIGN:
+            if (store_is_dead(d, dead, stmt->assign.target->str_value, stmt->assign.value)) {
+                free_ast(stmt);
+                *slot = NULL;
+                d->stats.dead_stores++;
+                break;
+            }
+            nameset_add(dead, stmt->assign.target->str_value);
+            mark_read(dead, stmt->assign.value);
+            break;
+        case NODE_PRINT:
+            mark_read(dead, stmt->print_expr.expr);
+            break;
+        case NODE_INDEX_ASSIGN:
+            // other elements keep their values: the array stays as it was
+            mark_read(dead, stmt->element.index);
+            mark_read(dead, stmt->element.value);
+            break;
+        case NODE_RETURN:
+            nameset_assign(dead, exit_dead);
+            mark_read(dead, stmt->return_stmt.expr);
+            break;
+        case NODE_BREAK:
+            // the statements after the loop are not tracked
+            nameset_clear(dead);
+            break;
+        case NODE_IF: {
+            NameSet else_dead;
+            nameset_init(&else_dead);
+            nameset_assign(&else_dead, dead);
+            dse_list(d, &stmt->control.if_body, dead, exit_dead);
+            dse_list(d, &stmt->control.else_body, &else_dead, exit_dead);
+            nameset_retain(dead, &else_dead);
+            nameset_free(&else_dead);
+            mark_read(dead, stmt->control.condition);
+            break;
+        }
+        case NODE_WHILE: {
+            // the body runs again after itself, so nothing is known at its end
+            NameSet body_dead;
+            nameset_init(&body_dead);
+            dse_list(d, &stmt->control.loop_body, &body_dead, exit_dead);
+            nameset_free(&body_dead);
+            // the loop may run zero times; whatever it reads is live before it
+            NameSet reads;
+            nameset_init(&reads);
+            collect_reads(stmt, &reads);
+            nameset_remove_all(dead, &reads);
+            nameset_free(&reads);
+            if (contains_node_type(stmt, NODE_CALL) || contains_node_type(stmt, NODE_RETURN)) {
+                nameset_clear(dead);
+            }
+            break;
+        }
+        case NODE_SWITCH: {
+            // clauses from last to first, each falling into the one after it;
+            // the switch starts at any clause, or past them all without a default
+            ASTNode** clauses = NULL;
+            int n = flatten_statements(stmt->switch_stmt.cases, &clauses);
+            bool has_default = false;
+            NameSet next, entry;
+            nameset_init(&next);
+            nameset_init(&entry);
+            nameset_assign(&next, dead);
+            for (int i = n - 1; i >= 0; i--) {
+                dse_list(d, &clauses[i]->case_clause.body, &next, exit_dead);
+                if (i == n - 1) {
+                    nameset_assign(&entry, &next);
+                } else {
+                    nameset_retain(&entry, &next);
+                }
+                has_default = has_default || clauses[i]->case_clause.is_default;
+            }
+            if (n == 0) {
+                nameset_assign(&entry, dead);
+            } else if (!has_default) {
+                nameset_retain(&entry, dead);
+            }
+            nameset_assign(dead, &entry);
+            nameset_free(&next);
+            nameset_free(&entry);
+            mem_free(clauses);
+            mark_read(dead, stmt->switch_stmt.expr);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void dse_list(Dce* d, ASTNode** list_slot, NameSet* dead, const NameSet* exit_dead) {
+    if (!*list_slot) return;
+    ASTNode** stmts = NULL;
+    int n = flatten_statements(*list_slot, &stmts);
+    // statements may be freed below; drop the old spine while they are intact
+    free_statement_list(*list_slot);
+    for (int i = n - 1; i >= 0; i--) {
+        dse_statement(d, &stmts[i], dead, exit_dead);
+    }
+    StmtBuffer out = {0};
+    for (int i = 0; i < n; i++) {
+        if (stmts[i]) stmt_buffer_push(&out, stmts[i]);
+    }
+    *list_slot = build_statement_list(out.items, out.count);
+    mem_free(out.items);
+    mem_free(stmts);
+}
+
+// --- 3. unreachable functions ---
+
+static ASTNode* entry_function(ASTNode* program) {
+    return find_function(program, "main");
+}
+
+static void remove_unreachable_functions(Dce* d) {
+    ASTNode* program = d->program;
+    ASTNode* main_func = entry_function(program);
+    NameSet reachable;
+    nameset_init(&reachable);
+    if (main_func) {
+        nameset_add(&reachable, "main");
+    } else {
+        collect_callees(program->program.main_block, &reachable);
+    }
+    // `reachable` only grows, so walking it by index visits each function once
+    for (int i = 0; i < reachable.count; i++) {
+        ASTNode* func = find_function(program, reachable.names[i]);
+        if (func) collect_callees(func, &reachable);
+    }
+
+    ASTNode* kept = NULL;
+    ASTNode* next;
+    for (ASTNode* f = program->program.functions; f; f = next) {
+        next = f->binop.right;
+        f->binop.right = NULL;
+        if (nameset_contains(&reachable, f->binop.left->func.name)) {
+            kept = append_function(kept, f->binop.left);
+        } else {
+            free_ast(f->binop.left);
+            d->stats.functions++;
+        }
+        f->binop.left = NULL;
+        mem_free(f);
+    }
+    program->program.functions = kept;
+    nameset_free(&reachable);
+}
+
+// re-declares (without a store) variables whose only declarations were removed
+static void keep_declarations(Dce* d, const TypeTable* declared_before) {
+    NameSet declared, used;
+    nameset_init(&declared);
+    nameset_init(&used);
+    collect_declarations(d->program, &declared);
+    collect_reads(d->program, &used);
+    collect_writes(d->program, &used);
+
+    ASTNode* main_func = entry_function(d->program);
+    ASTNode** entry = main_func ? &main_func->func.body : &d->program->program.main_block;
+    for (int i = 0; i < used.count; i++) {
+        const char* name = used.names[i];
+        if (nameset_contains(&declared, name) || !nameset_contains(&declared_before->names, name)) continue;
+        *entry = create_compound_node(create_decl_node((char*)type_of(declared_before, name), (char*)name, NULL),
+                                      *entry);
+    }
+    nameset_free(&declared);
+    nameset_free(&used);
+}
+
+DceStats eliminate_dead_code(ASTNode* program) {
+    Dce d = {0};
+    d.program = program;
+
+    TypeTable declared_before = {0};
+    nameset_init(&declared_before.names);
+    collect_types(program, &declared_before);
+
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        prune_list(&d, &f->binop.left->func.body);
+    }
+    prune_list(&d, &program->program.main_block);
+
+    nameset_init(&d.universe);
+    nameset_init(&d.never_read);
+    collect_writes(program, &d.universe);
+    NameSet reads;
+    nameset_init(&reads);
+    collect_reads(program, &reads);
+    for (int i = 0; i < d.universe.count; i++) {
+        if (!nameset_contains(&reads, d.universe.names[i])) nameset_add(&d.never_read, d.universe.names[i]);
+    }
+    nameset_free(&reads);
+
+    // after main (or the main block) the program exits, so no store there
+    // is observed later, unless main is also called from somewhere
+    NameSet none, dead;
+    nameset_init(&none);
+    nameset_init(&dead);
+    ASTNode* main_func = entry_function(program);
+    bool main_called = false;
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        main_called = main_called || contains_call_to(f->binop.left, "main");
+    }
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        ASTNode* func = f->binop.left;
+        const NameSet* exit_dead = func == main_func && !main_called ? &d.universe : &none;
+        nameset_assign(&dead, exit_dead);
+        dse_list(&d, &func->func.body, &dead, exit_dead);
+    }
+    if (!main_func) {
+        nameset_assign(&dead, &d.universe);
+        dse_list(&d, &program->program.main_block, &dead, &d.universe);
+    }
+    nameset_free(&none);
+    nameset_free(&dead);
+
+    remove_unreachable_functions(&d);
+    keep_declarations(&d, &declared_before);
+
+    type_table_free(&declared_before);
+    nameset_free(&d.universe);
+    nameset_free(&d.never_read);
+    return d.stats;
+}
@@ -0,0 +1,348 @@
+#include "optimizer/optimizer.h"
+#include "optimizer/analysis.h"
+#include "driver/profile.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+// Inlining of small leaf functions.
+//
+// Variables are global slots shared by name, so an inlined body can keep
+// its identifiers as they are: the call `f(x, y)` becomes
+//     int p0 = x; int p1 = y;   (the stores the callee would do on entry)
+//     <body, with `return e` rewritten to `f.retN = e`>
+// hoisted in front of the statement, and the call itself is replaced by
+// `f.retN`. Names containing '.' cannot clash with source identifiers.
+
+typedef struct {
+    ASTNode* program;
+    int budget;
+    int site_counter;
+    int inlined;
+    ASTNode** candidates;
+    int candidate_count;
+} Inliner;
+
+static bool returns_in_loops(ASTNode* node, bool in_loop) {
+    if (!node) return false;
+    switch (node->type) {
+        case NODE_RETURN:
+            return in_loop;
+        case NODE_COMPOUND:
+            return returns_in_loops(node->binop.left, in_loop) ||
+                   returns_in_loops(node->binop.right, in_loop);
+        case NODE_IF:
+            return returns_in_loops(node->control.if_body, in_loop) ||
+                   returns_in_loops(node->control.else_body, in_loop);
+        case NODE_WHILE:
+            return returns_in_loops(node->control.loop_body, true);
+        case NODE_SWITCH:
+            // cases fall through, so the rest cannot be moved into them either
+            return returns_in_loops(node->switch_stmt.cases, true);
+        case NODE_CASE:
+            return returns_in_loops(node->case_clause.body, in_loop);
+        default:
+            return false;
+    }
+}
+
+// Rewrites stmts[0..n) so that each `return e` becomes `ret = e` and control
+// falls off the end instead. A statement following an `if` that returns in
+// one arm is only reached through the other arm, so the remainder of the
+// list is moved into both arms (the arm that returns drops it again).
+static ASTNode* convert_returns(ASTNode** stmts, int n, const char* ret_var) {
+    ASTNode** out = mem_alloc((n + 1) * sizeof(ASTNode*));
+    if (!out) {
+        out_of_memory("convert_returns");
+    }
+    int count = 0;
+
+    for (int i = 0; i < n; i++) {
+        ASTNode* stmt = stmts[i];
+        if (stmt->type == NODE_RETURN) {
+            ASTNode* value = stmt->return_stmt.expr ? clone_ast(stmt->return_stmt.expr)
+                                                    : create_num_node(0);
+            out[count++] = create_assign_node((char*)ret_var, value);
+            break;
+        }
+        if (stmt->type == NODE_IF && contains_node_type(stmt, NODE_RETURN)) {
+            ASTNode* arms[2] = { stmt->control.if_body, stmt->control.else_body };
+            ASTNode* converted[2];
+            for (int a = 0; a < 2; a++) {
+                ASTNode** arm = NULL;
+                int arm_count = flatten_statements(arms[a], &arm);
+                arm = mem_realloc(arm, (arm_count + n - i) * sizeof(ASTNode*));
+                if (!arm) {
+                    out_of_memory("convert_returns");
+                }
+                for (int j = i + 1; j < n; j++) {
+                    arm[arm_count++] = stmts[j];
+                }
+                converted[a] = convert_returns(arm, arm_count, ret_var);
+                mem_free(arm);
+            }
+            out[count] = create_if_node(clone_ast(stmt->control.condition),
+                                        converted[0], converted[1]);
+            out[count++]->line = stmt->line;
+            break;
+        }
+        out[count++] = clone_ast(stmt);
+    }
+
+    ASTNode* list = build_statement_list(out, count);
+    mem_free(out);
+    return list;
+}
+
+// with a profile, functions that never ran are left alone and hot ones may
+// be this many times the budget
+#define HOT_INLINE_FACTOR 2
+
+static bool is_candidate(Inliner* in, ASTNode* func) {
+    if (strcmp(func->func.name, "main") == 0) return false;
+    if (profile_cold("func", func->line)) return false;
+    int budget = profile_hot("func", func->line) ? in->budget * HOT_INLINE_FACTOR : in->budget;
+    if (contains_node_type(func->func.body, NODE_CALL)) return false;
+    if (count_nodes(func->func.body) > budget) return false;
+    if (returns_in_loops(func->func.body, false)) return false;
+    if (breaks_outside_loops(func->func.body)) return false;
+
+    // moving the remainder into both arms of each returning `if` can
+    // multiply the body; keep the result within a small factor of the budget
+    ASTNode** stmts = NULL;
+    int n = flatten_statements(func->func.body, &stmts);
+    ASTNode* converted = convert_returns(stmts, n, "ret");
+    bool fits = count_nodes(converted) <= 2 * budget;
+    free_ast(converted);
+    mem_free(stmts);
+    return fits;
+}
+
+static ASTNode* lookup_candidate(Inliner* in, const char* name) {
+    for (int i = 0; i < in->candidate_count; i++) {
+        if (strcmp(in->candidates[i]->func.name, name) == 0) return in->candidates[i];
+    }
+    return NULL;
+}
+
+// slot holding the first call executed while evaluating *slot (arguments run before their call)
+static ASTNode** first_call(ASTNode** slot) {
+    ASTNode* node = *slot;
+    if (!node) return NULL;
+    ASTNode** found = NULL;
+    switch (node->type) {
+        case NODE_CALL:
+            for (ASTNode* arg = node->func_call.args; arg && !found; arg = arg->binop.right) {
+                found = first_call(&arg->binop.left);
+            }
+            return found ? found : slot;
+        case NODE_BINOP:
+            found = first_call(&node->binop.left);
+            return found ? found : first_call(&node->binop.right);
+        case NODE_UNOP:
+            return first_call(&node->unop.operand);
+        case NODE_INDEX:
+            return first_call(&node->element.index);
+        default:
+            return NULL;
+    }
+}
+
+// variables read while evaluating `expr` before `target` runs
+static bool collect_reads_before(ASTNode* expr, ASTNode* target, NameSet* out) {
+    if (!expr) return false;
+    if (expr == target) return true;
+    switch (expr->type) {
+        case NODE_IDENT:
+            nameset_add(out, expr->str_value);
+            return false;
+        case NODE_BINOP:
+            return collect_reads_before(expr->binop.left, target, out) ||
+                   collect_reads_before(expr->binop.right, target, out);
+        case NODE_UNOP:
+            return collect_reads_before(expr->unop.operand, target, out);
+        case NODE_INDEX:
+            if (collect_reads_before(expr->element.index, target, out)) return true;
+            nameset_add(out, expr->element.array->str_value);
+            return false;
+        case NODE_CALL:
+            for (ASTNode* arg = expr->func_call.args; arg; arg = arg->binop.right) {
+                if (collect_reads_before(arg->binop.left, target, out)) return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+static ASTNode** expression_slot(ASTNode* stmt) {
+    switch (stmt->type) {
+        case NODE_PRINT:  return &stmt->print_expr.expr;
+        case NODE_ASSIGN: return &stmt->assign.value;
+        case NODE_DECL:   return stmt->decl.init_expr ? &stmt->decl.init_expr : NULL;
+        case NODE_RETURN: return stmt->return_stmt.expr ? &stmt->return_stmt.expr : NULL;
+        case NODE_IF:     return &stmt->control.condition;
+        case NODE_SWITCH: return &stmt->switch_stmt.expr;
+        default:          return NULL;
+    }
+}
+
+// emits the inlined body for *call_slot in front of `stmt` and
+// replaces the call by the variable holding its result
+static bool inline_call(Inliner* in, ASTNode** expr_slot, ASTNode** call_slot, StmtBuffer* out) {
+    ASTNode* call = *call_slot;
+    ASTNode* func = lookup_candidate(in, call->func_call.func_name);
+    if (!func || count_args(call) != count_params(func)) return false;
+
+    // hoisting is only valid if nothing evaluated before the call reads a
+    // variable the callee stores to
+    NameSet written, read_before;
+    nameset_init(&written);
+    nameset_init(&read_before);
+    collect_writes(func, &written);
+    collect_reads_before(*expr_slot, call, &read_before);
+    bool safe = !nameset_intersects(&read_before, &written);
+    nameset_free(&read_before);
+    if (!safe) {
+        nameset_free(&written);
+        return false;
+    }
+
+    int site = in->site_counter++;
+    char name[256];
+
+    // arguments are all evaluated before any parameter is stored; go through
+    // temporaries only when a later argument reads an earlier parameter
+    int argc = count_args(call);
+    ASTNode** args = mem_alloc((argc ? argc : 1) * sizeof(ASTNode*));
+    ASTNode** params = mem_alloc((argc ? argc : 1) * sizeof(ASTNode*));
+    if (!args || !params) {
+        out_of_memory("inline_call");
+    }
+    int i = 0;
+    for (ASTNode* a = call->func_call.args, *p = func->func.params; a; a = a->binop.right, p = p->binop.right) {
+        args[i] = a->binop.left;
+        params[i] = p->binop.left;
+        i++;
+    }
+    bool use_temps = false;
+    NameSet assigned;
+    nameset_init(&assigned);
+    for (i = 0; i < argc && !use_temps; i++) {
+        NameSet reads;
+        nameset_init(&reads);
+        collect_reads(args[i], &reads);
+        use_temps = nameset_intersects(&reads, &assigned);
+        nameset_free(&reads);
+        nameset_add(&assigned, params[i]->param.name);
+    }
+    nameset_free(&assigned);
+
+    for (i = 0; i < argc; i++) {
+        if (use_temps) {
+            snprintf(name, sizeof(name), "%s.arg%d_%d", func->func.name, site, i);
+            stmt_buffer_push(out, create_decl_node("int", name, clone_ast(args[i])));
+        } else {
+            stmt_buffer_push(out, create_decl_node(params[i]->param.type, params[i]->param.name,
+                                              clone_ast(args[i])));
+        }
+    }
+    if (use_temps) {
+        for (i = 0; i < argc; i++) {
+            snprintf(name, sizeof(name), "%s.arg%d_%d", func->func.name, site, i);
+            stmt_buffer_push(out, create_decl_node(params[i]->param.type, params[i]->param.name,
+                                              create_ident_node(name)));
+        }
+    }
+
+    snprintf(name, sizeof(name), "%s.ret%d", func->func.name, site);
+    stmt_buffer_push(out, create_decl_node("int", name, NULL));
+
+    ASTNode** body = NULL;
+    int n = flatten_statements(func->func.body, &body);
+    stmt_buffer_push_list(out, convert_returns(body, n, name));
+    mem_free(body);
+
+    *call_slot = create_ident_node(name);
+    free_ast(call);
+    mem_free(args);
+    mem_free(params);
+    nameset_free(&written);
+    in->inlined++;
+    return true;
+}
+
+static void inline_in_list(Inliner* in, ASTNode** list_slot);
+
+static void inline_in_statement(Inliner* in, ASTNode* stmt, StmtBuffer* out) {
+    switch (stmt->type) {
+        case NODE_IF:
+            inline_in_list(in, &stmt->control.if_body);
+            if (stmt->control.else_body) inline_in_list(in, &stmt->control.else_body);
+            break;
+        case NODE_WHILE:
+            inline_in_list(in, &stmt->control.loop_body);
+            break;
+        case NODE_SWITCH:
+            for (ASTNode* c = stmt->switch_stmt.cases; c; c = c->binop.right) {
+                inline_in_list(in, &c->binop.left->case_clause.body);
+            }
+            break;
+        default:
+            break;
+    }
+
+    ASTNode** slot = expression_slot(stmt);
+    if (slot) {
+        ASTNode** call_slot;
+        while ((call_slot = first_call(slot)) && inline_call(in, slot, call_slot, out)) {
+        }
+    }
+    stmt_buffer_push(out, stmt);
+}
+
+static void inline_in_list(Inliner* in, ASTNode** list_slot) {
+    if (!*list_slot) return;
+    ASTNode** stmts = NULL;
+    int n = flatten_statements(*list_slot, &stmts);
+
+    StmtBuffer out = {0};
+    for (int i = 0; i < n; i++) {
+        inline_in_statement(in, stmts[i], &out);
+    }
+    free_statement_list(*list_slot);
+    *list_slot = build_statement_list(out.items, out.count);
+    mem_free(out.items);
+    mem_free(stmts);
+}
+
+int inline_functions(ASTNode* program, int budget) {
+    Inliner in = {0};
+    in.program = program;
+    in.budget = budget;
+
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        ASTNode* func = f->binop.left;
+        if (is_candidate(&in, func)) {
+            in.candidates = mem_realloc(in.candidates, (in.candidate_count + 1) * sizeof(ASTNode*));
+            if (!in.candidates) {
+                out_of_memory("inline_functions");
+            }
+            in.candidates[in.candidate_count++] = func;
+        }
+    }
+
+    if (in.candidate_count > 0) {
+        for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+            inline_in_list(&in, &f->binop.left->func.body);
+        }
+        inline_in_list(&in, &program->program.main_block);
+    }
+
+    mem_free(in.candidates);
+    return in.inlined;
+}
@@ -0,0 +1,205 @@
+#include "optimizer/optimizer.h"
+#include "optimizer/analysis.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Loop-invariant code motion.
+//
+// An expression inside a while loop is invariant when it makes no call and
+// none of the variables it reads is stored by the loop, either directly or
+// by a function called from it. The largest such BINOP/UNOP subtrees are
+// computed once into `licm.N` in front of the loop (the preheader) and the
+// loop reads the temporary instead. Equal expressions share a temporary.
+// Inner loops are processed first, so an expression can move out of several
+// levels of nesting.
+
+typedef struct {
+    ASTNode* expr;      // hoisted expression, owned by the preheader decl
+    char* name;
+} Hoisted;
+
+typedef struct {
+    ASTNode* program;
+    int temp_counter;   // one per hoisted expression
+
+    // state of the loop being processed
+    NameSet variant;
+    Hoisted* items;
+    int count;
+    int capacity;
+} Licm;
+
+static bool is_invariant(Licm* l, ASTNode* node) {
+    if (!expr_cannot_fault(node)) return false;
+    NameSet reads;
+    nameset_init(&reads);
+    collect_reads(node, &reads);
+    bool invariant = !nameset_intersects(&reads, &l->variant);
+    nameset_free(&reads);
+    return invariant;
+}
+
+static bool worth_hoisting(ASTNode* node) {
+    if (node->type == NODE_BINOP) return true;
+    return node->type == NODE_UNOP &&
+           node->unop.operand->type != NODE_NUM && node->unop.operand->type != NODE_IDENT;
+}
+
+static const char* temp_for(Licm* l, ASTNode* expr) {
+    for (int i = 0; i < l->count; i++) {
+        if (same_expr(l->items[i].expr, expr)) return l->items[i].name;
+    }
+    if (l->count == l->capacity) {
+        l->capacity = l->capacity ? l->capacity * 2 : 8;
+        l->items = mem_realloc(l->items, l->capacity * sizeof(Hoisted));
+        if (!l->items) {
+            out_of_memory("temp_for");
+        }
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "licm.%d", l->temp_counter++);
+    l->items[l->count].expr = clone_ast(expr);
+    l->items[l->count].name = mem_strdup(name);
+    return l->items[l->count++].name;
+}
+
+static void hoist_expr(Licm* l, ASTNode** slot) {
+    ASTNode* node = *slot;
+    if (!node) return;
+    if (worth_hoisting(node) && is_invariant(l, node)) {
+        *slot = create_ident_node((char*)temp_for(l, node));
+        free_ast(node);
+        return;
+    }
+    switch (node->type) {
+        case NODE_BINOP:
+            hoist_expr(l, &node->binop.left);
+            hoist_expr(l, &node->binop.right);
+            break;
+        case NODE_UNOP:
+            hoist_expr(l, &node->unop.operand);
+            break;
+        case NODE_INDEX:
+            hoist_expr(l, &node->element.index);
+            break;
+        case NODE_CALL:
+            for (ASTNode* a = node->func_call.args; a; a = a->binop.right) {
+                hoist_expr(l, &a->binop.left);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void hoist_in_stmt(Licm* l, ASTNode* node) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_COMPOUND:
+            hoist_in_stmt(l, node->binop.left);
+            hoist_in_stmt(l, node->binop.right);
+            break;
+        case NODE_PRINT:
+            hoist_expr(l, &node->print_expr.expr);
+            break;
+        case NODE_DECL:
+            hoist_expr(l, &node->decl.init_expr);
+            break;
+        case NODE_ASSIGN:
+            hoist_expr(l, &node->assign.value);
+            break;
+        case NODE_INDEX_ASSIGN:
+            hoist_expr(l, &node->element.index);
+            hoist_expr(l, &node->element.value);
+            break;
+        case NODE_RETURN:
+            hoist_expr(l, &node->return_stmt.expr);
+            break;
+        case NODE_IF:
+            hoist_expr(l, &node->control.condition);
+            hoist_in_stmt(l, node->control.if_body);
+            hoist_in_stmt(l, node->control.else_body);
+            break;
+        case NODE_WHILE:
+            hoist_expr(l, &node->control.condition);
+            hoist_in_stmt(l, node->control.loop_body);
+            break;
+        case NODE_SWITCH:
+            hoist_expr(l, &node->switch_stmt.expr);
+            hoist_in_stmt(l, node->switch_stmt.cases);
+            break;
+        case NODE_CASE:
+            hoist_in_stmt(l, node->case_clause.body);
+            break;
+        default:
+            break;
+    }
+}
+
+static void hoist_loop(Licm* l, ASTNode* loop, StmtBuffer* out) {
+    nameset_init(&l->variant);
+    collect_writes(loop->control.loop_body, &l->variant);
+    collect_expr_call_writes(l->program, loop, &l->variant);
+    l->count = 0;
+
+    hoist_expr(l, &loop->control.condition);
+    hoist_in_stmt(l, loop->control.loop_body);
+
+    for (int i = 0; i < l->count; i++) {
+        stmt_buffer_push(out, create_decl_node("int", l->items[i].name, l->items[i].expr));
+        mem_free(l->items[i].name);
+    }
+    nameset_free(&l->variant);
+}
+
+static void licm_list(Licm* l, ASTNode** list_slot);
+
+static void licm_statement(Licm* l, ASTNode* stmt, StmtBuffer* out) {
+    switch (stmt->type) {
+        case NODE_IF:
+            licm_list(l, &stmt->control.if_body);
+            if (stmt->control.else_body) licm_list(l, &stmt->control.else_body);
+            break;
+        case NODE_WHILE:
+            licm_list(l, &stmt->control.loop_body);
+            hoist_loop(l, stmt, out);
+            break;
+        case NODE_SWITCH:
+            for (ASTNode* c = stmt->switch_stmt.cases; c; c = c->binop.right) {
+                licm_list(l, &c->binop.left->case_clause.body);
+            }
+            break;
+        default:
+            break;
+    }
+    stmt_buffer_push(out, stmt);
+}
+
+static void licm_list(Licm* l, ASTNode** list_slot) {
+    if (!*list_slot) return;
+    ASTNode** stmts = NULL;
+    int n = flatten_statements(*list_slot, &stmts);
+    StmtBuffer out = {0};
+    for (int i = 0; i < n; i++) {
+        licm_statement(l, stmts[i], &out);
+    }
+    free_statement_list(*list_slot);
+    *list_slot = build_statement_list(out.items, out.count);
+    mem_free(out.items);
+    mem_free(stmts);
+}
+
+int hoist_loop_invariants(ASTNode* program) {
+    Licm l = {0};
+    l.program = program;
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        licm_list(&l, &f->binop.left->func.body);
+    }
+    licm_list(&l, &program->program.main_block);
+    mem_free(l.items);
+    return l.temp_counter;
+}
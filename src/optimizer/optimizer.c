@@ -0,0 +1,40 @@
+#include "optimizer/optimizer.h"
+#include "codegen/helpers.h"
+#include "codegen/symbol.h"
+
+#include <stdio.h>
+
+// AST-level passes, run before either backend sees the tree
+void optimize_program(ASTNode* program, const CompilerOptions* opts) {
+    if (!program || program->type != NODE_PROGRAM || opts->opt_level < 1) return;
+
+    // report undeclared variables before a pass can delete the code using them
+    init_symbol_table();
+    collect_variables(program);
+    verify_symbols(program);
+    free_symbol_table();
+
+    int folded = fold_pure_calls(program, opts->eval_steps, opts->eval_depth);
+    int inlined = inline_functions(program, opts->inline_budget);
+    int hoisted = hoist_loop_invariants(program);
+    int reused = eliminate_common_subexpressions(program);
+    int vectorized = 0;
+    if (opts->opt_level >= 2 && opts->vector_isa != VECTOR_NONE) vectorized = vectorize_loops(program);
+    UnrollStats unrolled = {0, 0};
+    if (opts->opt_level >= 2) unrolled = unroll_loops(program, opts->unroll_factor);
+    DceStats dce = eliminate_dead_code(program);
+    TailCallStats tail = mark_tail_calls(program);
+
+    if (opts->opt_report) {
+        fprintf(stderr, "consteval: %d calls folded\n", folded);
+        fprintf(stderr, "inline: %d call sites\n", inlined);
+        fprintf(stderr, "licm: %d expressions hoisted\n", hoisted);
+        fprintf(stderr, "cse: %d expressions reused\n", reused);
+        fprintf(stderr, "vectorize: %d loops (%s)\n", vectorized, vector_isa_name(opts->vector_isa));
+        fprintf(stderr, "unroll: %d loops fully, %d by %d\n",
+                unrolled.full, unrolled.partial, opts->unroll_factor);
+        fprintf(stderr, "dce: %d unreachable statements, %d dead stores, %d functions\n",
+                dce.unreachable, dce.dead_stores, dce.functions);
+        fprintf(stderr, "tail calls: %d self, %d sibling\n", tail.self_calls, tail.sibling_calls);
+    }
+}
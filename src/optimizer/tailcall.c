@@ -0,0 +1,53 @@
+#include "optimizer/optimizer.h"
+#include "optimizer/analysis.h"
+
+#include <string.h>
+
+// Marks `return f(...)` inside functions. The backends then reuse the
+// current frame: a self call becomes a jump back to the parameter stores,
+// any other call a jump into the callee after the frame is torn down.
+
+static void mark_in(ASTNode* program, ASTNode* func, ASTNode* node, TailCallStats* stats) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_COMPOUND:
+            mark_in(program, func, node->binop.left, stats);
+            mark_in(program, func, node->binop.right, stats);
+            break;
+        case NODE_IF:
+            mark_in(program, func, node->control.if_body, stats);
+            mark_in(program, func, node->control.else_body, stats);
+            break;
+        case NODE_WHILE:
+            mark_in(program, func, node->control.loop_body, stats);
+            break;
+        case NODE_SWITCH:
+            mark_in(program, func, node->switch_stmt.cases, stats);
+            break;
+        case NODE_CASE:
+            mark_in(program, func, node->case_clause.body, stats);
+            break;
+        case NODE_RETURN: {
+            ASTNode* expr = node->return_stmt.expr;
+            if (!expr || expr->type != NODE_CALL) break;
+            if (!find_function(program, expr->func_call.func_name)) break;
+            node->return_stmt.tail_call = 1;
+            if (strcmp(expr->func_call.func_name, func->func.name) == 0) {
+                stats->self_calls++;
+            } else {
+                stats->sibling_calls++;
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+TailCallStats mark_tail_calls(ASTNode* program) {
+    TailCallStats stats = {0};
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        mark_in(program, f->binop.left, f->binop.left->func.body, &stats);
+    }
+    return stats;
+}
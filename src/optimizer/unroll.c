@@ -0,0 +1,282 @@
+#include "optimizer/optimizer.h"
+#include "optimizer/analysis.h"
+#include "driver/profile.h"
+#include "driver/memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Unrolling of counted while loops.
+//
+// A loop is counted when its condition compares a variable `i` against a
+// loop-invariant bound and the last statement of its body is `i = i + c` or
+// `i = i - c` for a constant c, with nothing else in the loop storing to i.
+//
+// With a constant start value (the statement just before the loop) and a
+// constant bound, a loop of at most MAX_FULL_UNROLL iterations is replaced
+// by that many copies of its body. Otherwise the body is repeated `factor`
+// times under a condition that holds only when all copies will run, and the
+// original loop follows as the remainder:
+//     while (i + (factor-1)*c < n) { body; body; ... }
+//     while (i < n) { body }
+// The guard is computed without the wraparound of a narrow i, so only
+// 64-bit induction variables are unrolled partially.
+
+#define MAX_FULL_UNROLL 16
+#define UNROLL_NODE_BUDGET 256
+
+typedef struct {
+    ASTNode* program;
+    TypeTable types;
+    int factor;
+    int full;
+    int partial;
+} Unroller;
+
+typedef struct {
+    const char* var;    // induction variable
+    Operator op;        // var op bound
+    ASTNode* bound;
+    int64_t step;
+} CountedLoop;
+
+static bool constant_value(ASTNode* node, int64_t* out) {
+    if (node->type == NODE_NUM) {
+        *out = node->num_value;
+        return true;
+    }
+    if (node->type == NODE_UNOP && node->unop.op == OP_NEG && node->unop.operand->type == NODE_NUM) {
+        *out = -(int64_t)node->unop.operand->num_value;
+        return true;
+    }
+    return false;
+}
+
+static Operator mirrored(Operator op) {
+    switch (op) {
+        case OP_LT: return OP_GT;
+        case OP_LE: return OP_GE;
+        case OP_GT: return OP_LT;
+        case OP_GE: return OP_LE;
+        default:    return op;
+    }
+}
+
+// `var = var + c` / `var = var - c`
+static bool step_of(ASTNode* stmt, const char* var, int64_t* step) {
+    if (stmt->type != NODE_ASSIGN || strcmp(stmt->assign.target->str_value, var) != 0) return false;
+    ASTNode* value = stmt->assign.value;
+    if (value->type != NODE_BINOP) return false;
+    if (value->binop.op != OP_ADD && value->binop.op != OP_SUB) return false;
+    ASTNode* left = value->binop.left;
+    ASTNode* right = value->binop.right;
+    int64_t c;
+    if (left->type == NODE_IDENT && strcmp(left->str_value, var) == 0 && constant_value(right, &c)) {
+        *step = value->binop.op == OP_ADD ? c : -c;
+    } else if (value->binop.op == OP_ADD && right->type == NODE_IDENT &&
+               strcmp(right->str_value, var) == 0 && constant_value(left, &c)) {
+        *step = c;
+    } else {
+        return false;
+    }
+    return *step != 0;
+}
+
+static bool match_counted(Unroller* u, ASTNode* loop, ASTNode** body, int n, CountedLoop* out) {
+    ASTNode* cond = loop->control.condition;
+    if (n == 0 || cond->type != NODE_BINOP) return false;
+    Operator op = cond->binop.op;
+    if (op != OP_LT && op != OP_LE && op != OP_GT && op != OP_GE && op != OP_NEQ) return false;
+
+    if (cond->binop.left->type == NODE_IDENT) {
+        out->var = cond->binop.left->str_value;
+        out->bound = cond->binop.right;
+        out->op = op;
+    } else if (cond->binop.right->type == NODE_IDENT) {
+        out->var = cond->binop.right->str_value;
+        out->bound = cond->binop.left;
+        out->op = mirrored(op);
+    } else {
+        return false;
+    }
+    if (!step_of(body[n - 1], out->var, &out->step)) return false;
+    if (contains_node_type(out->bound, NODE_CALL)) return false;
+
+    // only the final increment may store to the induction variable, and
+    // nothing in the loop may store to what the bound reads
+    NameSet writes, bound_reads;
+    nameset_init(&writes);
+    nameset_init(&bound_reads);
+    for (int i = 0; i < n - 1; i++) collect_writes(body[i], &writes);
+    collect_expr_call_writes(u->program, loop, &writes);
+    bool ok = !nameset_contains(&writes, out->var);
+    nameset_add(&writes, out->var);
+    collect_reads(out->bound, &bound_reads);
+    ok = ok && !nameset_intersects(&writes, &bound_reads);
+    nameset_free(&writes);
+    nameset_free(&bound_reads);
+    return ok;
+}
+
+static bool compare(Operator op, int64_t x, int64_t y) {
+    switch (op) {
+        case OP_LT:  return x < y;
+        case OP_LE:  return x <= y;
+        case OP_GT:  return x > y;
+        case OP_GE:  return x >= y;
+        case OP_NEQ: return x != y;
+        default:     return false;
+    }
+}
+
+// iterations of the loop if `prev` gives the induction variable a constant
+// start value and the bound is constant; -1 when unknown or too many
+static int constant_trip_count(const Unroller* u, const CountedLoop* loop, ASTNode* prev) {
+    const char* type = type_of(&u->types, loop->var);
+    int64_t value, bound;
+    if (!prev || !constant_value(loop->bound, &bound)) return -1;
+    if (prev->type == NODE_DECL && prev->decl.init_expr &&
+        strcmp(prev->decl.name, loop->var) == 0) {
+        if (!constant_value(prev->decl.init_expr, &value)) return -1;
+    } else if (prev->type == NODE_ASSIGN && strcmp(prev->assign.target->str_value, loop->var) == 0) {
+        if (!constant_value(prev->assign.value, &value)) return -1;
+    } else {
+        return -1;
+    }
+    int trips = 0;
+    value = wrap_to_type(type, value);
+    while (compare(loop->op, value, bound)) {
+        if (++trips > MAX_FULL_UNROLL) return -1;
+        value = wrap_to_type(type, value + loop->step);
+    }
+    return trips;
+}
+
+static void push_copies(StmtBuffer* out, ASTNode** body, int n, int copies) {
+    for (int c = 0; c < copies; c++) {
+        for (int i = 0; i < n; i++) stmt_buffer_push(out, clone_ast(body[i]));
+    }
+}
+
+// `var + offset` as an AST, with the offset folded into a literal
+static ASTNode* offset_expr(const char* var, int64_t offset) {
+    if (offset < 0) {
+        return create_binop_node(OP_SUB, create_ident_node((char*)var), create_num_node(-offset));
+    }
+    return create_binop_node(OP_ADD, create_ident_node((char*)var), create_num_node(offset));
+}
+
+// appends the replacement for `loop` to out; false leaves the loop alone
+static bool unroll_loop(Unroller* u, ASTNode* loop, ASTNode* prev, StmtBuffer* out) {
+    if (loop->control.vectorize) return false;     // its lanes already do the work
+    if (profile_cold("loop", loop->line)) return false;    // the copies would never run
+    ASTNode** body = NULL;
+    int n = flatten_statements(loop->control.loop_body, &body);
+    CountedLoop counted;
+    if (!match_counted(u, loop, body, n, &counted)) {
+        mem_free(body);
+        return false;
+    }
+    int size = count_nodes(loop->control.loop_body);
+    bool has_break = breaks_outside_loops(loop->control.loop_body);
+
+    int trips = constant_trip_count(u, &counted, prev);
+    if (trips >= 0 && trips * size <= UNROLL_NODE_BUDGET) {
+        if (has_break && trips > 0) {
+            // run the copies inside a loop that exits after one pass, so a
+            // `break` in any copy still leaves the whole sequence
+            StmtBuffer once = {0};
+            push_copies(&once, body, n, trips);
+            stmt_buffer_push(&once, create_break_node());
+            ASTNode* pass = create_while_node(create_num_node(1), build_statement_list(once.items, once.count));
+            pass->line = loop->line;
+            stmt_buffer_push(out, pass);
+            mem_free(once.items);
+        } else {
+            push_copies(out, body, n, trips);
+        }
+        free_ast(loop);
+        mem_free(body);
+        u->full++;
+        return true;
+    }
+
+    // a break in an unrolled copy would fall into the remainder loop; the
+    // guard also needs a direction in which the variable approaches the bound
+    bool approaches = ((counted.op == OP_LT || counted.op == OP_LE) && counted.step > 0) ||
+                      ((counted.op == OP_GT || counted.op == OP_GE) && counted.step < 0);
+    int64_t span = (int64_t)(u->factor - 1) * counted.step;
+    if (u->factor < 2 || has_break || !approaches || size * u->factor > UNROLL_NODE_BUDGET ||
+        type_size(type_of(&u->types, counted.var)) != 8 ||
+        span > INT32_MAX || span < -INT32_MAX) {
+        mem_free(body);
+        return false;
+    }
+
+    StmtBuffer copies = {0};
+    push_copies(&copies, body, n, u->factor);
+    ASTNode* guard = create_binop_node(counted.op, offset_expr(counted.var, span),
+                                       clone_ast(counted.bound));
+    ASTNode* unrolled = create_while_node(guard, build_statement_list(copies.items, copies.count));
+    unrolled->line = loop->line;     // counted as the same source loop
+    stmt_buffer_push(out, unrolled);
+    stmt_buffer_push(out, loop);
+    mem_free(copies.items);
+    mem_free(body);
+    u->partial++;
+    return true;
+}
+
+static void unroll_list(Unroller* u, ASTNode** list_slot);
+
+static void unroll_statement(Unroller* u, ASTNode* stmt, StmtBuffer* out) {
+    switch (stmt->type) {
+        case NODE_IF:
+            unroll_list(u, &stmt->control.if_body);
+            if (stmt->control.else_body) unroll_list(u, &stmt->control.else_body);
+            break;
+        case NODE_WHILE:
+            unroll_list(u, &stmt->control.loop_body);
+            if (unroll_loop(u, stmt, out->count > 0 ? out->items[out->count - 1] : NULL, out)) return;
+            break;
+        case NODE_SWITCH:
+            for (ASTNode* c = stmt->switch_stmt.cases; c; c = c->binop.right) {
+                unroll_list(u, &c->binop.left->case_clause.body);
+            }
+            break;
+        default:
+            break;
+    }
+    stmt_buffer_push(out, stmt);
+}
+
+static void unroll_list(Unroller* u, ASTNode** list_slot) {
+    if (!*list_slot) return;
+    ASTNode** stmts = NULL;
+    int n = flatten_statements(*list_slot, &stmts);
+    // statements may be freed below; drop the old spine while they are intact
+    free_statement_list(*list_slot);
+    StmtBuffer out = {0};
+    for (int i = 0; i < n; i++) {
+        unroll_statement(u, stmts[i], &out);
+    }
+    *list_slot = build_statement_list(out.items, out.count);
+    mem_free(out.items);
+    mem_free(stmts);
+}
+
+UnrollStats unroll_loops(ASTNode* program, int factor) {
+    Unroller u = {0};
+    u.program = program;
+    u.factor = factor;
+    nameset_init(&u.types.names);
+    collect_types(program, &u.types);
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        unroll_list(&u, &f->binop.left->func.body);
+    }
+    unroll_list(&u, &program->program.main_block);
+    type_table_free(&u.types);
+    return (UnrollStats){ u.full, u.partial };
+}
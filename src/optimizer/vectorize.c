@@ -0,0 +1,183 @@
+#include "optimizer/optimizer.h"
+#include "optimizer/analysis.h"
+#include "driver/memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Marks element-wise array loops for the vector code generator.
+//
+// A loop qualifies when it has the shape
+//     while (i < n) {          // or i <= n; n a constant or a variable
+//         X[i] = expr;         // one or more element stores
+//         ...
+//         i = i + 1;
+//     }
+// where every expr is built from Y[i], Y[i + c] and Y[i - c] loads,
+// variables and constants the loop does not store to, and the operators
+// + - & | ^ and << by a constant. Each iteration then touches only its own
+// elements, so consecutive iterations can run side by side in the lanes of
+// a vector register. Offset loads are allowed only from arrays the loop
+// never stores to; otherwise one iteration would read what another wrote.
+//
+// The code generator keeps the scalar loop as the tail, so nothing about
+// the trip count needs to be known here. Lanes are 64 bits wide: i and
+// every array must be int.
+
+#define VECTOR_REGISTERS 16
+
+typedef struct {
+    const char* var;        // induction variable
+    const TypeTable* types;
+    NameSet stored;         // arrays stored in the loop
+    NameSet invariants;     // distinct scalar names and constants broadcast
+    int registers;          // temporaries needed by the deepest expression
+} VectorLoop;
+
+// `i`, `i + c` or `i - c`
+static bool element_index(ASTNode* index, const char* var, int* offset) {
+    if (index->type == NODE_IDENT) {
+        *offset = 0;
+        return strcmp(index->str_value, var) == 0;
+    }
+    if (index->type != NODE_BINOP || (index->binop.op != OP_ADD && index->binop.op != OP_SUB)) return false;
+    ASTNode* left = index->binop.left;
+    ASTNode* right = index->binop.right;
+    if (left->type != NODE_IDENT || strcmp(left->str_value, var) != 0 || right->type != NODE_NUM) return false;
+    *offset = index->binop.op == OP_ADD ? right->num_value : -right->num_value;
+    return true;
+}
+
+// temporaries needed to evaluate `node`, or -1 when it cannot be vectorized
+static int lane_registers(VectorLoop* v, ASTNode* node) {
+    char constant[32];
+    int offset;
+    switch (node->type) {
+        case NODE_NUM:
+            snprintf(constant, sizeof(constant), "%lld", (long long)node->num_value);
+            nameset_add(&v->invariants, constant);
+            return 1;
+        case NODE_IDENT:
+            if (strcmp(node->str_value, v->var) == 0) return -1;   // differs per lane
+            nameset_add(&v->invariants, node->str_value);
+            return 1;
+        case NODE_INDEX:
+            if (!element_index(node->element.index, v->var, &offset)) return -1;
+            if (type_size(type_of(v->types, node->element.array->str_value)) != 8) return -1;
+            if (offset != 0 && nameset_contains(&v->stored, node->element.array->str_value)) return -1;
+            return 1;
+        case NODE_BINOP: {
+            Operator op = node->binop.op;
+            if (op == OP_LSHIFT) {
+                ASTNode* count = node->binop.right;
+                if (count->type != NODE_NUM || count->num_value < 0 || count->num_value > 63) return -1;
+                return lane_registers(v, node->binop.left);
+            }
+            if (op != OP_ADD && op != OP_SUB && op != OP_BAND && op != OP_BOR && op != OP_BXOR) return -1;
+            int left = lane_registers(v, node->binop.left);
+            int right = lane_registers(v, node->binop.right);
+            if (left < 0 || right < 0) return -1;
+            return left > right + 1 ? left : right + 1;
+        }
+        default:
+            return -1;
+    }
+}
+
+static bool match_vector_loop(const TypeTable* types, ASTNode* loop) {
+    ASTNode* cond = loop->control.condition;
+    if (cond->type != NODE_BINOP || (cond->binop.op != OP_LT && cond->binop.op != OP_LE)) return false;
+    ASTNode* var = cond->binop.left;
+    ASTNode* bound = cond->binop.right;
+    if (var->type != NODE_IDENT || type_size(type_of(types, var->str_value)) != 8) return false;
+    if (bound->type != NODE_NUM &&
+        (bound->type != NODE_IDENT || strcmp(bound->str_value, var->str_value) == 0)) {
+        return false;
+    }
+
+    ASTNode** body = NULL;
+    int n = flatten_statements(loop->control.loop_body, &body);
+    bool ok = n >= 2;
+
+    // the last statement is `i = i + 1`
+    ASTNode* step = ok ? body[n - 1] : NULL;
+    ok = ok && step->type == NODE_ASSIGN && strcmp(step->assign.target->str_value, var->str_value) == 0 &&
+         step->assign.value->type == NODE_BINOP && step->assign.value->binop.op == OP_ADD &&
+         step->assign.value->binop.left->type == NODE_IDENT &&
+         strcmp(step->assign.value->binop.left->str_value, var->str_value) == 0 &&
+         step->assign.value->binop.right->type == NODE_NUM &&
+         step->assign.value->binop.right->num_value == 1;
+
+    VectorLoop v = { .var = var->str_value, .types = types };
+    nameset_init(&v.stored);
+    nameset_init(&v.invariants);
+    int offset;
+    for (int i = 0; ok && i < n - 1; i++) {
+        ok = body[i]->type == NODE_INDEX_ASSIGN &&
+             element_index(body[i]->element.index, v.var, &offset) && offset == 0 &&
+             type_size(type_of(types, body[i]->element.array->str_value)) == 8;
+        if (ok) nameset_add(&v.stored, body[i]->element.array->str_value);
+    }
+    for (int i = 0; ok && i < n - 1; i++) {
+        int registers = lane_registers(&v, body[i]->element.value);
+        ok = registers > 0;
+        if (registers > v.registers) v.registers = registers;
+    }
+    ok = ok && v.registers + v.invariants.count <= VECTOR_REGISTERS;
+
+    nameset_free(&v.stored);
+    nameset_free(&v.invariants);
+    mem_free(body);
+    return ok;
+}
+
+static int vectorize_list(const TypeTable* types, ASTNode* list);
+
+static int vectorize_statement(const TypeTable* types, ASTNode* stmt) {
+    int marked = 0;
+    switch (stmt->type) {
+        case NODE_IF:
+            marked += vectorize_list(types, stmt->control.if_body);
+            marked += vectorize_list(types, stmt->control.else_body);
+            break;
+        case NODE_WHILE:
+            marked += vectorize_list(types, stmt->control.loop_body);
+            if (match_vector_loop(types, stmt)) {
+                stmt->control.vectorize = 1;
+                marked++;
+            }
+            break;
+        case NODE_SWITCH:
+            for (ASTNode* c = stmt->switch_stmt.cases; c; c = c->binop.right) {
+                marked += vectorize_list(types, c->binop.left->case_clause.body);
+            }
+            break;
+        default:
+            break;
+    }
+    return marked;
+}
+
+static int vectorize_list(const TypeTable* types, ASTNode* list) {
+    if (!list) return 0;
+    ASTNode** stmts = NULL;
+    int n = flatten_statements(list, &stmts);
+    int marked = 0;
+    for (int i = 0; i < n; i++) marked += vectorize_statement(types, stmts[i]);
+    mem_free(stmts);
+    return marked;
+}
+
+int vectorize_loops(ASTNode* program) {
+    TypeTable types = {0};
+    nameset_init(&types.names);
+    collect_types(program, &types);
+    int marked = 0;
+    for (ASTNode* f = program->program.functions; f; f = f->binop.right) {
+        marked += vectorize_list(&types, f->binop.left->func.body);
+    }
+    marked += vectorize_list(&types, program->program.main_block);
+    type_table_free(&types);
+    return marked;
+}
@@ -1,88 +1,101 @@
 #include "parser/ast.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+long ast_nodes_created[NODE_TYPE_COUNT];
+int ast_line = 0;
+
 // implementations of AST constructors
 ASTNode* create_print_node(ASTNode *expr) {
-    ASTNode *node = malloc(sizeof(ASTNode));
+    ASTNode *node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_print_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_print_node");
     }
     node->type = NODE_PRINT;
+    ast_nodes_created[NODE_PRINT]++;
+    node->line = ast_line;
     node->print_expr.expr = expr;
+    node->print_expr.message = 0;
     return node;
 }
 
 ASTNode* create_str_node(char* str) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_str_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_str_node");
     }
     node->type = NODE_STR;
-    node->str_value = strdup(str);
+    ast_nodes_created[NODE_STR]++;
+    node->line = ast_line;
+    node->str_value = mem_strdup(str);
     return node;
 }
 
 ASTNode* create_ident_node(char* id) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_ident_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_ident_node");
     }
     node->type = NODE_IDENT;
-    node->str_value = strdup(id);
+    ast_nodes_created[NODE_IDENT]++;
+    node->line = ast_line;
+    node->str_value = mem_strdup(id);
     return node;
 }
 
-ASTNode* create_num_node(int value) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+ASTNode* create_num_node(int64_t value) {
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_num_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_num_node");
     }
     node->type = NODE_NUM;
+    ast_nodes_created[NODE_NUM]++;
+    node->line = ast_line;
     node->num_value = value;
     return node;
 }
 
 ASTNode* create_program_node(ASTNode* functions, ASTNode* main_block) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_program_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_program_node");
     }
     node->type = NODE_PROGRAM;
+    ast_nodes_created[NODE_PROGRAM]++;
+    node->line = ast_line;
     node->program.functions = functions;
     node->program.main_block = main_block;
     return node;
 }
 
 ASTNode* create_func_node(char* return_type, char* name, ASTNode* params, ASTNode* body) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_func_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_func_node");
     }
     node->type = NODE_FUNC;
-    node->func.return_type = strdup(return_type);
-    node->func.name = strdup(name);
+    ast_nodes_created[NODE_FUNC]++;
+    node->line = ast_line;
+    node->func.return_type = mem_strdup(return_type);
+    node->func.name = mem_strdup(name);
     node->func.params = params;
     node->func.body = body;
     return node;
 }
 
 ASTNode* create_call_node(char* func_name, ASTNode* args) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_call_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_call_node");
     }
     node->type = NODE_CALL;
-    node->func_call.func_name = strdup(func_name);
+    ast_nodes_created[NODE_CALL]++;
+    node->line = ast_line;
+    node->func_call.func_name = mem_strdup(func_name);
     node->func_call.args = args;
     return node;
 }
@@ -112,14 +125,15 @@ ASTNode* append_function(ASTNode* func_list, ASTNode* func) {
 }
 
 ASTNode* create_param_node(char* type, char* name) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_param_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_param_node");
     }
     node->type = NODE_PARAM;
-    node->param.type = strdup(type);
-    node->param.name = strdup(name);
+    ast_nodes_created[NODE_PARAM]++;
+    node->line = ast_line;
+    node->param.type = mem_strdup(type);
+    node->param.name = mem_strdup(name);
     return node;
 }
 
@@ -136,75 +150,139 @@ ASTNode* append_param(ASTNode* param_list, ASTNode* param) {
 }
 
 ASTNode* create_if_node(ASTNode* cond, ASTNode* if_body, ASTNode* else_body) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_if_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_if_node");
     }
     node->type = NODE_IF;
+    ast_nodes_created[NODE_IF]++;
+    node->line = ast_line;
     node->control.condition = cond;
     node->control.if_body = if_body;
     node->control.else_body = else_body;
+    node->control.vectorize = 0;
     return node;
 }
 
 ASTNode* create_while_node(ASTNode* cond, ASTNode* body) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_while_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_while_node");
     }
     node->type = NODE_WHILE;
+    ast_nodes_created[NODE_WHILE]++;
+    node->line = ast_line;
     node->control.condition = cond;
     node->control.loop_body = body;
+    node->control.vectorize = 0;
+    return node;
+}
+
+ASTNode* create_switch_node(ASTNode* expr, ASTNode* cases) {
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
+    if (!node) {
+        out_of_memory("create_switch_node");
+    }
+    node->type = NODE_SWITCH;
+    ast_nodes_created[NODE_SWITCH]++;
+    node->line = ast_line;
+    node->switch_stmt.expr = expr;
+    node->switch_stmt.cases = cases;
+    return node;
+}
+
+ASTNode* create_case_node(int value, int is_default, ASTNode* body) {
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
+    if (!node) {
+        out_of_memory("create_case_node");
+    }
+    node->type = NODE_CASE;
+    ast_nodes_created[NODE_CASE]++;
+    node->line = ast_line;
+    node->case_clause.value = value;
+    node->case_clause.is_default = is_default;
+    node->case_clause.body = body;
     return node;
 }
 
+ASTNode* append_case(ASTNode* case_list, ASTNode* clause) {
+    if (!case_list) {
+        return create_compound_node(clause, NULL);
+    }
+    ASTNode* current = case_list;
+    while (current->binop.right != NULL) {
+        current = current->binop.right;
+    }
+    current->binop.right = create_compound_node(clause, NULL);
+    return case_list;
+}
+
 ASTNode* create_break_node(void) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed for break node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_break_node");
     }
     node->type = NODE_BREAK;
+    ast_nodes_created[NODE_BREAK]++;
+    node->line = ast_line;
     return node;
 }
 
 ASTNode* create_return_node(ASTNode* expr) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
+    if (!node) {
+        out_of_memory("create_return_node");
+    }
     node->type = NODE_RETURN;
+    ast_nodes_created[NODE_RETURN]++;
+    node->line = ast_line;
     node->return_stmt.expr = expr;
+    node->return_stmt.tail_call = 0;
     return node;
 }
 
 ASTNode* create_decl_node(char* type, char* name, ASTNode* init_expr) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
+    if (!node) {
+        out_of_memory("create_decl_node");
+    }
     node->type = NODE_DECL;
-    node->decl.type = strdup(type);
-    node->decl.name = strdup(name);
+    ast_nodes_created[NODE_DECL]++;
+    node->line = ast_line;
+    node->decl.type = mem_strdup(type);
+    node->decl.name = mem_strdup(name);
     node->decl.init_expr = init_expr;
+    node->decl.size = 0;
+    return node;
+}
+
+ASTNode* create_array_decl_node(char* type, char* name, int size) {
+    ASTNode* node = create_decl_node(type, name, NULL);
+    node->decl.size = size;
     return node;
 }
 
 ASTNode* create_assign_node(char* id, ASTNode* value) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_assign_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_assign_node");
     }
     node->type = NODE_ASSIGN;
+    ast_nodes_created[NODE_ASSIGN]++;
+    node->line = ast_line;
     node->assign.target = create_ident_node(id);
     node->assign.value = value;
     return node;
 }
 
 ASTNode* create_binop_node(Operator op, ASTNode* left, ASTNode* right) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_binop_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_binop_node");
     }
     node->type = NODE_BINOP;
+    ast_nodes_created[NODE_BINOP]++;
+    node->line = ast_line;
     node->binop.op = op;
     node->binop.left = left;
     node->binop.right = right;
@@ -212,12 +290,13 @@ ASTNode* create_binop_node(Operator op, ASTNode* left, ASTNode* right) {
 }
 
 ASTNode* create_compound_node(ASTNode* stmt, ASTNode* next) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_compound_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_compound_node");
     }
     node->type = NODE_COMPOUND;
+    ast_nodes_created[NODE_COMPOUND]++;
+    node->line = ast_line;
     node->binop.left = stmt;
     node->binop.right = next;
     return node;
@@ -242,32 +321,78 @@ ASTNode* append_statement(ASTNode* compound, ASTNode* stmt) {
 }
 
 ASTNode* create_unop_node(Operator op, ASTNode* operand) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed in create_unop_node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_unop_node");
     }
     node->type = NODE_UNOP;
+    ast_nodes_created[NODE_UNOP]++;
+    node->line = ast_line;
     node->unop.op = op;
     node->unop.operand = operand;
     return node;
 }
 
+ASTNode* create_index_node(char* array, ASTNode* index) {
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
+    if (!node) {
+        out_of_memory("create_index_node");
+    }
+    node->type = NODE_INDEX;
+    ast_nodes_created[NODE_INDEX]++;
+    node->line = ast_line;
+    node->element.array = create_ident_node(array);
+    node->element.index = index;
+    node->element.value = NULL;
+    return node;
+}
+
+ASTNode* create_index_assign_node(char* array, ASTNode* index, ASTNode* value) {
+    ASTNode* node = create_index_node(array, index);
+    node->type = NODE_INDEX_ASSIGN;
+    ast_nodes_created[NODE_INDEX_ASSIGN]++;
+    node->line = ast_line;
+    node->element.value = value;
+    return node;
+}
+
 ASTNode* create_empty_node(void) {
-    ASTNode* node = malloc(sizeof(ASTNode));
+    ASTNode* node = mem_alloc(sizeof(ASTNode));
     if (!node) {
-        fprintf(stderr, "Memory allocation failed for empty node\n");
-        exit(EXIT_FAILURE);
+        out_of_memory("create_empty_node");
     }
     node->type = NODE_EMPTY;
+    ast_nodes_created[NODE_EMPTY]++;
+    node->line = ast_line;
     return node;
 }
 
 void free_ast(ASTNode* node) {
     if (!node) return;
     switch (node->type) {
+        case NODE_PROGRAM:
+            free_ast(node->program.functions);
+            free_ast(node->program.main_block);
+            break;
+        case NODE_FUNC:
+            mem_free(node->func.return_type);
+            mem_free(node->func.name);
+            free_ast(node->func.params);
+            free_ast(node->func.body);
+            break;
+        case NODE_PARAM:
+            mem_free(node->param.type);
+            mem_free(node->param.name);
+            break;
+        case NODE_DECL:
+            mem_free(node->decl.type);
+            mem_free(node->decl.name);
+            free_ast(node->decl.init_expr);
+            break;
+        case NODE_NUM:
+            break;
         case NODE_CALL:
-            free(node->func_call.func_name);
+            mem_free(node->func_call.func_name);
             free_ast(node->func_call.args);
             break;
         case NODE_ASSIGN:
@@ -276,7 +401,7 @@ void free_ast(ASTNode* node) {
             break;
         case NODE_IDENT:
         case NODE_STR:
-            free(node->str_value);
+            mem_free(node->str_value);
             break;
         case NODE_BINOP:
             free_ast(node->binop.left);
@@ -293,6 +418,13 @@ void free_ast(ASTNode* node) {
             break;
         case NODE_BREAK:
             break;
+        case NODE_SWITCH:
+            free_ast(node->switch_stmt.expr);
+            free_ast(node->switch_stmt.cases);
+            break;
+        case NODE_CASE:
+            free_ast(node->case_clause.body);
+            break;
         case NODE_RETURN:
            free_ast(node->return_stmt.expr);
            break;
@@ -306,10 +438,94 @@ void free_ast(ASTNode* node) {
         case NODE_UNOP:
             free_ast(node->unop.operand);
             break;
+        case NODE_INDEX:
+        case NODE_INDEX_ASSIGN:
+            free_ast(node->element.array);
+            free_ast(node->element.index);
+            free_ast(node->element.value);
+            break;
         case NODE_EMPTY:
             break;
     }
-    free(node);
+    mem_free(node);
+}
+
+static ASTNode* clone_node(ASTNode* node) {
+    switch (node->type) {
+        case NODE_PROGRAM:
+            return create_program_node(clone_ast(node->program.functions),
+                                       clone_ast(node->program.main_block));
+        case NODE_FUNC:
+            return create_func_node(node->func.return_type, node->func.name,
+                                    clone_ast(node->func.params), clone_ast(node->func.body));
+        case NODE_CALL:
+            return create_call_node(node->func_call.func_name, clone_ast(node->func_call.args));
+        case NODE_PARAM:
+            return create_param_node(node->param.type, node->param.name);
+        case NODE_PRINT:
+            return create_print_node(clone_ast(node->print_expr.expr));
+        case NODE_IF:
+            return create_if_node(clone_ast(node->control.condition),
+                                  clone_ast(node->control.if_body),
+                                  clone_ast(node->control.else_body));
+        case NODE_WHILE: {
+            ASTNode* copy = create_while_node(clone_ast(node->control.condition),
+                                              clone_ast(node->control.loop_body));
+            copy->control.vectorize = node->control.vectorize;
+            return copy;
+        }
+        case NODE_BREAK:
+            return create_break_node();
+        case NODE_SWITCH:
+            return create_switch_node(clone_ast(node->switch_stmt.expr),
+                                      clone_ast(node->switch_stmt.cases));
+        case NODE_CASE:
+            return create_case_node(node->case_clause.value, node->case_clause.is_default,
+                                    clone_ast(node->case_clause.body));
+        case NODE_RETURN: {
+            ASTNode* copy = create_return_node(clone_ast(node->return_stmt.expr));
+            copy->return_stmt.tail_call = node->return_stmt.tail_call;
+            return copy;
+        }
+        case NODE_DECL:
+            if (node->decl.size > 0) {
+                return create_array_decl_node(node->decl.type, node->decl.name, node->decl.size);
+            }
+            return create_decl_node(node->decl.type, node->decl.name,
+                                    clone_ast(node->decl.init_expr));
+        case NODE_ASSIGN:
+            return create_assign_node(node->assign.target->str_value, clone_ast(node->assign.value));
+        case NODE_BINOP:
+            return create_binop_node(node->binop.op, clone_ast(node->binop.left),
+                                     clone_ast(node->binop.right));
+        case NODE_IDENT:
+            return create_ident_node(node->str_value);
+        case NODE_NUM:
+            return create_num_node(node->num_value);
+        case NODE_STR:
+            return create_str_node(node->str_value);
+        case NODE_COMPOUND:
+            return create_compound_node(clone_ast(node->binop.left), clone_ast(node->binop.right));
+        case NODE_UNOP:
+            return create_unop_node(node->unop.op, clone_ast(node->unop.operand));
+        case NODE_INDEX:
+            return create_index_node(node->element.array->str_value, clone_ast(node->element.index));
+        case NODE_INDEX_ASSIGN:
+            return create_index_assign_node(node->element.array->str_value,
+                                            clone_ast(node->element.index),
+                                            clone_ast(node->element.value));
+        case NODE_EMPTY:
+            return create_empty_node();
+    }
+    return NULL;
+}
+
+// deep copy, used by passes that duplicate subtrees; copies keep the line
+ASTNode* clone_ast(ASTNode* node) {
+    if (!node) return NULL;
+    ASTNode* copy = clone_node(node);
+    if (copy) copy->line = node->line;
+    return copy;
 }
 
 const char* operator_to_string(Operator op) {
@@ -343,66 +559,170 @@ const char* operator_to_string(Operator op) {
     }
 }
 
-void print_ast(ASTNode* node, int indent) {
+int type_size(const char* type) {
+    if (strcmp(type, "i8") == 0 || strcmp(type, "u8") == 0) return 1;
+    if (strcmp(type, "i16") == 0 || strcmp(type, "u16") == 0) return 2;
+    if (strcmp(type, "i32") == 0 || strcmp(type, "u32") == 0) return 4;
+    return 8;
+}
+
+bool type_is_signed(const char* type) {
+    return type[0] != 'u';
+}
+
+int64_t wrap_to_type(const char* type, int64_t value) {
+    switch (type_size(type)) {
+        case 1:  return type_is_signed(type) ? (int64_t)(int8_t)value : (int64_t)(uint8_t)value;
+        case 2:  return type_is_signed(type) ? (int64_t)(int16_t)value : (int64_t)(uint16_t)value;
+        case 4:  return type_is_signed(type) ? (int64_t)(int32_t)value : (int64_t)(uint32_t)value;
+        default: return value;
+    }
+}
+
+const char* node_type_name(NodeType type) {
+    switch (type) {
+        case NODE_PROGRAM:       return "PROGRAM";
+        case NODE_FUNC:          return "FUNC";
+        case NODE_CALL:          return "CALL";
+        case NODE_PARAM:         return "PARAM";
+        case NODE_PRINT:         return "PRINT";
+        case NODE_IF:            return "IF";
+        case NODE_WHILE:         return "WHILE";
+        case NODE_BREAK:         return "BREAK";
+        case NODE_RETURN:        return "RETURN";
+        case NODE_DECL:          return "DECL";
+        case NODE_ASSIGN:        return "ASSIGN";
+        case NODE_BINOP:         return "BINOP";
+        case NODE_IDENT:         return "IDENT";
+        case NODE_NUM:           return "NUM";
+        case NODE_STR:           return "STR";
+        case NODE_COMPOUND:      return "COMPOUND";
+        case NODE_UNOP:          return "UNOP";
+        case NODE_SWITCH:        return "SWITCH";
+        case NODE_CASE:          return "CASE";
+        case NODE_INDEX:         return "INDEX";
+        case NODE_INDEX_ASSIGN:  return "INDEX_ASSIGN";
+        case NODE_EMPTY:         return "EMPTY";
+    }
+    return "UNKNOWN";
+}
+
+void print_ast(ASTNode* node, int indent, FILE* output) {
     if (!node) return;
-    for (int i = 0; i < indent; i++) printf("  ");
+    fprintf(output, "%*s", indent * 2, "");
     switch (node->type) {
+        case NODE_PROGRAM:
+            fprintf(output, "PROGRAM\n");
+            print_ast(node->program.functions, indent+1, output);
+            if (node->program.main_block) {
+                fprintf(output, "%*sMAIN:\n", indent*2, "");
+                print_ast(node->program.main_block, indent+1, output);
+            }
+            break;
+        case NODE_FUNC:
+            fprintf(output, "FUNC(%s %s)\n", node->func.return_type, node->func.name);
+            print_ast(node->func.params, indent+1, output);
+            fprintf(output, "%*sBODY:\n", indent*2, "");
+            print_ast(node->func.body, indent+1, output);
+            break;
+        case NODE_PARAM:
+            fprintf(output, "PARAM(%s %s)\n", node->param.type, node->param.name);
+            break;
+        case NODE_CALL:
+            fprintf(output, "CALL(%s)\n", node->func_call.func_name);
+            print_ast(node->func_call.args, indent+1, output);
+            break;
+        case NODE_RETURN:
+            fprintf(output, node->return_stmt.tail_call ? "RETURN(tail)\n" : "RETURN\n");
+            print_ast(node->return_stmt.expr, indent+1, output);
+            break;
+        case NODE_DECL:
+            if (node->decl.size > 0) {
+                fprintf(output, "DECL(%s %s[%d])\n", node->decl.type, node->decl.name, node->decl.size);
+            } else {
+                fprintf(output, "DECL(%s %s)\n", node->decl.type, node->decl.name);
+            }
+            print_ast(node->decl.init_expr, indent+1, output);
+            break;
         case NODE_PRINT:
-            printf("PRINT\n");
-            print_ast(node->print_expr.expr, indent+1);
+            fprintf(output, "PRINT\n");
+            print_ast(node->print_expr.expr, indent+1, output);
             break;
         case NODE_BINOP:
-            printf("BINOP(%s)\n", operator_to_string(node->binop.op));
-            print_ast(node->binop.left, indent+1);
-            print_ast(node->binop.right, indent+1);
+            fprintf(output, "BINOP(%s)\n", operator_to_string(node->binop.op));
+            print_ast(node->binop.left, indent+1, output);
+            print_ast(node->binop.right, indent+1, output);
             break;
         case NODE_NUM:
-            printf("NUM(%d)\n", node->num_value);
+            fprintf(output, "NUM(%lld)\n", (long long)node->num_value);
             break;
         case NODE_STR:
-            printf("STR(%s)\n", node->str_value);
+            fprintf(output, "STR(%s)\n", node->str_value);
             break;
         case NODE_IDENT:
-            printf("IDENT(%s)\n", node->str_value);
+            fprintf(output, "IDENT(%s)\n", node->str_value);
             break;
         case NODE_IF:
-            printf("IF\n");
-            print_ast(node->control.condition, indent+1);
-            printf("%*sTHEN:\n", indent*2, "");
-            print_ast(node->control.if_body, indent+1);
+            fprintf(output, "IF\n");
+            print_ast(node->control.condition, indent+1, output);
+            fprintf(output, "%*sTHEN:\n", indent*2, "");
+            print_ast(node->control.if_body, indent+1, output);
             if (node->control.else_body) {
-                printf("%*sELSE:\n", indent*2, "");
-                print_ast(node->control.else_body, indent+1);
+                fprintf(output, "%*sELSE:\n", indent*2, "");
+                print_ast(node->control.else_body, indent+1, output);
             }
             break;
         case NODE_WHILE:
-            printf("WHILE\n");
-            print_ast(node->control.condition, indent+1);
-            printf("%*sBODY:\n", indent*2, "");
-            print_ast(node->control.loop_body, indent+1);
+            fprintf(output, node->control.vectorize ? "WHILE(vectorized)\n" : "WHILE\n");
+            print_ast(node->control.condition, indent+1, output);
+            fprintf(output, "%*sBODY:\n", indent*2, "");
+            print_ast(node->control.loop_body, indent+1, output);
             break;
         case NODE_BREAK:
-            printf("BREAK\n");
+            fprintf(output, "BREAK\n");
+            break;
+        case NODE_SWITCH:
+            fprintf(output, "SWITCH\n");
+            print_ast(node->switch_stmt.expr, indent+1, output);
+            print_ast(node->switch_stmt.cases, indent+1, output);
+            break;
+        case NODE_CASE:
+            if (node->case_clause.is_default) {
+                fprintf(output, "DEFAULT\n");
+            } else {
+                fprintf(output, "CASE(%d)\n", node->case_clause.value);
+            }
+            print_ast(node->case_clause.body, indent+1, output);
             break;
         case NODE_ASSIGN:
-            printf("ASSIGN\n");
-            // For assignment, print both the left-hand side (target) and the right-hand side (expression)
-            printf("%*sLHS:\n", indent*2, "");
-            print_ast(node->binop.left, indent+1);
-            printf("%*sRHS:\n", indent*2, "");
-            print_ast(node->binop.right, indent+1);
+            fprintf(output, "ASSIGN\n");
+            fprintf(output, "%*sLHS:\n", indent*2, "");
+            print_ast(node->assign.target, indent+1, output);
+            fprintf(output, "%*sRHS:\n", indent*2, "");
+            print_ast(node->assign.value, indent+1, output);
             break;
         case NODE_COMPOUND:
-            printf("COMPOUND\n");
-            print_ast(node->binop.left, indent+1);
-            print_ast(node->binop.right, indent);
+            fprintf(output, "COMPOUND\n");
+            print_ast(node->binop.left, indent+1, output);
+            print_ast(node->binop.right, indent, output);
             break;
         case NODE_UNOP:
-            printf("UNOP(%s)\n", operator_to_string(node->unop.op));
-            print_ast(node->unop.operand, indent+1);
+            fprintf(output, "UNOP(%s)\n", operator_to_string(node->unop.op));
+            print_ast(node->unop.operand, indent+1, output);
+            break;
+        case NODE_INDEX:
+            fprintf(output, "INDEX(%s)\n", node->element.array->str_value);
+            print_ast(node->element.index, indent+1, output);
+            break;
+        case NODE_INDEX_ASSIGN:
+            fprintf(output, "INDEX_ASSIGN(%s)\n", node->element.array->str_value);
+            fprintf(output, "%*sINDEX:\n", indent*2, "");
+            print_ast(node->element.index, indent+1, output);
+            fprintf(output, "%*sRHS:\n", indent*2, "");
+            print_ast(node->element.value, indent+1, output);
             break;
         case NODE_EMPTY:
-            printf("EMPTY\n");
+            fprintf(output, "EMPTY\n");
             break;
     }
 }
\ No newline at end of file
@@ -1,46 +1,88 @@
 %define api.header.include {"parser/parser.tab.h"}
+%define parse.trace
+%locations
 
 %code requires {
     #include "parser/parser.tab.h"
     #include "parser/ast.h"
+    #include <stdio.h>
+}
+
+%code provides {
+    // Parses `input` into the program; NULL once its syntax errors have
+    // been reported.
+    ASTNode* parse_program(FILE* input);
+    // forgets a parse that an error ended part way through
+    void parser_reset(void);
 }
 
 %{
 #include "parser/ast.h"
-#include "codegen/codegen.h"
+#include "trace/trace.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
 
 #include <stdio.h>
+#include <stdarg.h>
 #include <stddef.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 
 extern FILE* yyin;
 extern int yyerror(char* msg);
 extern int yylex(void);
+extern int yylex_destroy(void);
 extern char* yytext;
+extern int yyleng;
 extern int yylineno; 
 
 ASTNode* root = NULL;
 int parse_errors = 0;
+
+// bison's debug output, switched on through yydebug, feeds the reductions trace
+static int trace_parser_output(FILE* stream, const char* fmt, ...);
+#define YYFPRINTF trace_parser_output
+
+// a grown parser stack is released with the rest of an abandoned compile
+#define YYMALLOC mem_alloc
+#define YYFREE mem_free
+
+// bison's default location rule, plus: nodes built by a rule's action get
+// the line of the rule's first token
+#define YYLLOC_DEFAULT(Current, Rhs, N)                                 \
+    do {                                                                \
+        if (N) {                                                        \
+            (Current).first_line = YYRHSLOC(Rhs, 1).first_line;         \
+            (Current).first_column = YYRHSLOC(Rhs, 1).first_column;     \
+            (Current).last_line = YYRHSLOC(Rhs, N).last_line;           \
+            (Current).last_column = YYRHSLOC(Rhs, N).last_column;       \
+        } else {                                                        \
+            (Current).first_line = (Current).last_line = YYRHSLOC(Rhs, 0).last_line;       \
+            (Current).first_column = (Current).last_column = YYRHSLOC(Rhs, 0).last_column; \
+        }                                                               \
+        ast_line = (Current).first_line;                                \
+    } while (0)
 %}
 
 %union {
     ASTNode* node;
-    int num;
+    int64_t num;
     char* str;
 }
 
 // tokens
 %token ERROR
 %token MAIN TYPE_INT 
+%token TYPE_I8 TYPE_I16 TYPE_I32 TYPE_I64 TYPE_U8 TYPE_U16 TYPE_U32
 %token TRUE FALSE
-%token PRINT IF ELSE WHILE BREAK RETURN
+%token PRINT IF ELSE WHILE BREAK RETURN SWITCH CASE DEFAULT
 %token NUMBER IDENTIFIER STRING
 %token ASSIGN 
 %token EQ GE LE LT GT NEQ LAND LOR LNOT
 %token BNOT BAND BOR BXOR BNAND BNOR BXNOR LSHIFT RSHIFT
 %token PLUS MINUS MULT DIV MOD
-%token SEMICOLON COMMA NEWLINE LPAREN RPAREN LBRACE RBRACE
+%token SEMICOLON COMMA COLON NEWLINE LPAREN RPAREN LBRACE RBRACE LBRACKET RBRACKET
 
 // optional declaration conflict
 %nonassoc DECL_PREC
@@ -67,9 +109,9 @@ int parse_errors = 0;
 %nonassoc UMINUS UPLUS
 
 // types
-%type <node> program statements statement expression block functions function_decl arg_list params param_list param main_block decl optional_init
-%type <str> IDENTIFIER STRING
-%type <num> NUMBER
+%type <node> program statements statement expression block functions function_decl arg_list params param_list param main_block decl optional_init case_list case_clause
+%type <str> IDENTIFIER STRING type
+%type <num> NUMBER case_value
 
 %%
 
@@ -105,7 +147,7 @@ function_decl:
     TYPE_INT IDENTIFIER LPAREN params RPAREN block %prec FUNCTION_PREC
         { $$ = create_func_node("int", $2, $4, $6); }
     | TYPE_INT MAIN LPAREN params RPAREN block %prec FUNCTION_PREC
-        { $$ = create_func_node("int", strdup("main"), $4, $6); }
+        { $$ = create_func_node("int", mem_strdup("main"), $4, $6); }
     ;
 
 arg_list:
@@ -125,13 +167,37 @@ param_list:
     ;
 
 param:
-    TYPE_INT IDENTIFIER
-        { $$ = create_param_node("int", $2); }
+    type IDENTIFIER
+        { $$ = create_param_node($1, $2); }
+    ;
+
+// integer types of variables; functions return int
+type:
+      TYPE_INT { $$ = "int"; }
+    | TYPE_I8  { $$ = "i8"; }
+    | TYPE_I16 { $$ = "i16"; }
+    | TYPE_I32 { $$ = "i32"; }
+    | TYPE_I64 { $$ = "i64"; }
+    | TYPE_U8  { $$ = "u8"; }
+    | TYPE_U16 { $$ = "u16"; }
+    | TYPE_U32 { $$ = "u32"; }
     ;
 
 decl: 
-    TYPE_INT IDENTIFIER optional_init %prec DECL_PREC  
-        { $$ = create_decl_node("int", $2, $3); }
+    type IDENTIFIER optional_init %prec DECL_PREC  
+        { $$ = create_decl_node($1, $2, $3); }
+    | type IDENTIFIER LBRACKET NUMBER RBRACKET
+        {
+            if ($4 <= 0) {
+                yyerror("array size must be positive");
+                YYERROR;
+            }
+            if ($4 > INT_MAX) {
+                yyerror("array size too large");
+                YYERROR;
+            }
+            $$ = create_array_decl_node($1, $2, (int)$4);
+        }
     ;
 
 optional_init:
@@ -151,6 +217,8 @@ statement:
         { $$ = $1; }
     | IDENTIFIER ASSIGN expression SEMICOLON
         { $$ = create_assign_node($1, $3); }
+    | IDENTIFIER LBRACKET expression RBRACKET ASSIGN expression SEMICOLON
+        { $$ = create_index_assign_node($1, $3, $6); }
     | block
     | PRINT expression SEMICOLON
         { $$ = create_print_node($2); }
@@ -160,6 +228,8 @@ statement:
         { $$ = create_if_node($3, $5, $7); }
     | WHILE LPAREN expression RPAREN statement
         { $$ = create_while_node($3, $5); }
+    | SWITCH LPAREN expression RPAREN LBRACE newlines case_list RBRACE
+        { $$ = create_switch_node($3, $7); }
     | BREAK SEMICOLON
         { $$ = create_break_node(); }
     | RETURN expression SEMICOLON
@@ -168,6 +238,35 @@ statement:
         { yyerrok; yyclearin; $$ = create_empty_node(); }
     ;
 
+// the statements of a clause take the newlines that follow them
+case_list:
+      /* empty */ { $$ = NULL; }
+    | case_list case_clause { $$ = append_case($1, $2); }
+    ;
+
+newlines:
+      /* empty */
+    | newlines NEWLINE
+    ;
+
+case_clause:
+      CASE case_value COLON statements
+        {
+            if ($2 < INT_MIN || $2 > INT_MAX) {
+                yyerror("case value out of range");
+                YYERROR;
+            }
+            $$ = create_case_node((int)$2, 0, $4);
+        }
+    | DEFAULT COLON statements
+        { $$ = create_case_node(0, 1, $3); }
+    ;
+
+case_value:
+      NUMBER { $$ = $1; }
+    | MINUS NUMBER { $$ = -$2; }
+    ;
+
 expression:
       LPAREN expression RPAREN { $$ = $2; }
 
@@ -210,46 +309,73 @@ expression:
     | expression MOD    expression { $$ = create_binop_node(OP_MOD, $1, $3); }
     
     | IDENTIFIER LPAREN arg_list RPAREN { $$ = create_call_node($1, $3); }
+    | IDENTIFIER LBRACKET expression RBRACKET { $$ = create_index_node($1, $3); }
     ;
 
 %%
 
 int yyerror(char* msg) {
 
-    const char* token = (yytext && yytext[0]) ? yytext : "end of input";
-    fprintf(stderr, "Syntax error at line %d: %s (near '%s')\n", yylineno, msg, token);
+    // yytext may be a slice of the input (scanner.c), so it is printed by length
+    if (yytext && yytext[0] && yyleng > 0) {
+        report(DIAGNOSTIC_ERROR, yylineno, "Syntax error at line %d: %s (near '%.*s')", yylineno, msg, yyleng, yytext);
+    } else {
+        report(DIAGNOSTIC_ERROR, yylineno, "Syntax error at line %d: %s (near 'end of input')", yylineno, msg);
+    }
     parse_errors++;
     return 1;
 }
 
-int main(int argc, char* argv[]) {
-
-    if (argc > 2) {
-        fprintf(stderr, "Usage: %s [input_file]\n", argv[0]);
-        return 1;
-    } else if (argc < 2) {
-        fprintf(stderr, "No input file provided. Defaulting to /dev/stdin.\nEnter input (press Ctrl+D when done): ");
-        yyin = fopen("/dev/stdin", "r");
-    } else {
-        yyin = fopen(argv[1], "r");
-    }
-
-    if (!yyin) {
-        perror("Error opening file");
-        return 1;
+// Collects bison's trace output a line at a time and keeps one event per
+// reduction: "Reducing stack by rule N (line L):" is followed, after the
+// right-hand side, by "-> $$ = nterm NAME (...)".
+static int trace_parser_output(FILE* stream, const char* fmt, ...) {
+    static char line[512];
+    static size_t length = 0;
+    static int rule = -1, rule_line = 0;
+    (void)stream;
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(line + length, sizeof(line) - length, fmt, args);
+    va_end(args);
+    if (n < 0) return n;
+    length += (size_t)n < sizeof(line) - length ? (size_t)n : sizeof(line) - length - 1;
+    // bison ends every line with a format of its own that ends in "\n"
+    size_t fmt_length = strlen(fmt);
+    if (fmt_length == 0 || fmt[fmt_length - 1] != '\n') return n;
+
+    char lhs[64];
+    if (sscanf(line, "Reducing stack by rule %d (line %d)", &rule, &rule_line) == 2) {
+        // the event is written once the result symbol is known
+    } else if (rule >= 0 && sscanf(line, "-> $$ = nterm %63s", lhs) == 1) {
+        trace_printf(TRACE_REDUCTIONS, yylineno, lhs, "rule %d (parser.y:%d)", rule, rule_line);
+        rule = -1;
     }
+    length = 0;
+    return n;
+}
 
-    int parse_result = yyparse();
-    fclose(yyin);
-
-    if (parse_result != 0) {
-        fprintf(stderr, "Parsing failed with %d errors.\n", parse_errors);
-        return 1;
+ASTNode* parse_program(FILE* input) {
+    root = NULL;
+    parse_errors = 0;
+    yydebug = trace_enabled(TRACE_REDUCTIONS);
+    yyin = input;
+    int result = yyparse();
+    yylex_destroy();
+    // nodes the optimizer makes up have no line of their own
+    ast_line = 0;
+
+    if (result != 0 || parse_errors > 0) {
+        report(DIAGNOSTIC_ERROR, 0, "Parsing failed with %d errors.", parse_errors);
+        return NULL;
     }
+    return root;
+}
 
-    generate_code_to_file(root);
-
-    free_ast(root);
-
-    return 0;
-}
\ No newline at end of file
+void parser_reset(void) {
+    yylex_destroy();
+    root = NULL;
+    parse_errors = 0;
+    ast_line = 0;
+}
@@ -0,0 +1,145 @@
+// compiler-client: bin/compiler's command line, compiled by a running
+// `compiler --server`. Prints what the compiler prints, writes
+// build/asm/program.asm and exits with the compiler's status.
+
+#include "server/protocol.h"
+#include "driver/options.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+static char* read_source(FILE* input, size_t* length) {
+    size_t capacity = 1 << 16;
+    char* source = malloc(capacity);
+    size_t n;
+    *length = 0;
+    while (source && (n = fread(source + *length, 1, capacity - *length, input)) > 0) {
+        *length += n;
+        if (*length == capacity) source = realloc(source, capacity *= 2);
+    }
+    if (!source) {
+        fprintf(stderr, "Memory allocation failed in read_source\n");
+        exit(EXIT_FAILURE);
+    }
+    return source;
+}
+
+static int connect_server(const char* path) {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path '%s' is too long\n", path);
+        return -1;
+    }
+    strcpy(address.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        fprintf(stderr, "Error: No compile server on %s (start one with compiler --server)\n", path);
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main(int argc, char* argv[]) {
+
+    // the same options as bin/compiler, so mistakes are reported before
+    // anything is sent
+    CompilerOptions opts;
+    if (parse_options(argc, argv, &opts) != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (opts.server_socket) {
+        fprintf(stderr, "--server cannot be sent to a server\n");
+        return 1;
+    }
+
+    FILE* input;
+    if (!opts.input_file) {
+        fprintf(stderr, "No input file provided. Defaulting to /dev/stdin.\nEnter input (press Ctrl+D when done): ");
+        input = stdin;
+    } else {
+        input = fopen(opts.input_file, "r");
+    }
+    if (!input) {
+        perror("Error opening file");
+        return 1;
+    }
+    size_t source_length;
+    char* source = read_source(input, &source_length);
+    if (input != stdin) fclose(input);
+    if (source_length > MAX_FRAME_LENGTH) {
+        fprintf(stderr, "Error: %s is too large to send to the server\n", opts.input_file);
+        return 1;
+    }
+
+    const char* path = getenv("COMPILER_SOCKET");
+    int fd = connect_server(path && *path ? path : DEFAULT_SERVER_SOCKET);
+    if (fd < 0) return 1;
+    signal(SIGPIPE, SIG_IGN);
+
+    char directory[PATH_MAX];
+    if (!getcwd(directory, sizeof(directory))) {
+        perror("getcwd");
+        return 1;
+    }
+    int sent = write_frame(fd, FRAME_DIRECTORY, directory, strlen(directory));
+    for (int i = 1; i < argc && sent == 0; i++) {
+        sent = write_frame(fd, FRAME_ARGUMENT, argv[i], strlen(argv[i]));
+    }
+    if (sent == 0) sent = write_frame(fd, FRAME_SOURCE, source, source_length);
+    if (sent == 0) sent = write_frame(fd, FRAME_END, "", 0);
+    free(source);
+
+    // the assembly file is only replaced when the server sends one
+    FILE* output = NULL;
+    int status = -1;
+    FrameType type;
+    char* data;
+    uint32_t length;
+    while (sent == 0 && status < 0 && read_frame(fd, &type, &data, &length) == 0) {
+        switch (type) {
+            case FRAME_STDOUT:
+                fwrite(data, 1, length, stdout);
+                break;
+            case FRAME_STDERR:
+                fflush(stdout);
+                fwrite(data, 1, length, stderr);
+                break;
+            case FRAME_ASM:
+                if (!output && !(output = fopen("build/asm/program.asm", "w"))) {
+                    perror("Failed to open output file");
+                    status = 1;
+                    break;
+                }
+                fwrite(data, 1, length, output);
+                break;
+            case FRAME_STATUS:
+                if (length == sizeof(int32_t)) {
+                    int32_t value;
+                    memcpy(&value, data, sizeof(value));
+                    status = value;
+                }
+                break;
+            default:
+                break;
+        }
+        free(data);
+    }
+    close(fd);
+    if (output && fclose(output) != 0) {
+        perror("Failed to write output file");
+        status = 1;
+    }
+    if (status < 0) {
+        fprintf(stderr, "Error: The compile server closed the connection\n");
+        return 1;
+    }
+    return status;
+}
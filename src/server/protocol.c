@@ -0,0 +1,59 @@
+#include "server/protocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+static int write_all(int fd, const void* data, size_t length) {
+    const char* p = data;
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        length -= n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void* data, size_t length) {
+    char* p = data;
+    while (length > 0) {
+        ssize_t n = read(fd, p, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        length -= n;
+    }
+    return 0;
+}
+
+int write_frame(int fd, FrameType type, const void* data, uint32_t length) {
+    char header[5];
+    header[0] = (char)type;
+    memcpy(header + 1, &length, sizeof(length));
+    if (write_all(fd, header, sizeof(header)) != 0) return -1;
+    return write_all(fd, data, length);
+}
+
+int read_frame(int fd, FrameType* type, char** data, uint32_t* length) {
+    char header[5];
+    if (read_all(fd, header, sizeof(header)) != 0) return -1;
+    *type = (FrameType)header[0];
+    memcpy(length, header + 1, sizeof(*length));
+    if (*length > MAX_FRAME_LENGTH) return -1;
+    *data = malloc(*length + 1);
+    if (!*data) {
+        fprintf(stderr, "Memory allocation failed in read_frame\n");
+        exit(EXIT_FAILURE);
+    }
+    if (read_all(fd, *data, *length) != 0) {
+        free(*data);
+        *data = NULL;
+        return -1;
+    }
+    (*data)[*length] = '\0';
+    return 0;
+}
@@ -0,0 +1,264 @@
+#include "server/server.h"
+#include "server/protocol.h"
+#include "lib/compiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+typedef struct {
+    char* directory;        // the client's, where paths in the arguments start
+    char** args;            // argv as bin/compiler would get it
+    int arg_count;
+    char* source;
+    uint32_t source_length;
+} Request;
+
+// accepted connections waiting for a thread
+#define QUEUE_SIZE 64
+static int queue[QUEUE_SIZE];
+static int queue_head = 0;
+static int queue_length = 0;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_ready = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queue_space = PTHREAD_COND_INITIALIZER;
+
+// A child that inherited the write end of another request's pipe would
+// keep that request from seeing the end of its output, so pipes are made,
+// forked and closed one request at a time.
+static pthread_mutex_t fork_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int listen_fd = -1;
+
+static void add_connection(int fd) {
+    pthread_mutex_lock(&queue_lock);
+    while (queue_length == QUEUE_SIZE) pthread_cond_wait(&queue_space, &queue_lock);
+    queue[(queue_head + queue_length++) % QUEUE_SIZE] = fd;
+    pthread_cond_signal(&queue_ready);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+static int take_connection(void) {
+    pthread_mutex_lock(&queue_lock);
+    while (queue_length == 0) pthread_cond_wait(&queue_ready, &queue_lock);
+    int fd = queue[queue_head];
+    queue_head = (queue_head + 1) % QUEUE_SIZE;
+    queue_length--;
+    pthread_cond_signal(&queue_space);
+    pthread_mutex_unlock(&queue_lock);
+    return fd;
+}
+
+static void free_request(Request* request) {
+    free(request->directory);
+    for (int i = 1; i < request->arg_count; i++) free(request->args[i]);
+    free(request->args);
+    free(request->source);
+}
+
+static void add_argument(Request* request, char* arg) {
+    // one more for the NULL that ends argv
+    request->args = realloc(request->args, (request->arg_count + 2) * sizeof(char*));
+    if (!request->args) {
+        fprintf(stderr, "Memory allocation failed in add_argument\n");
+        exit(EXIT_FAILURE);
+    }
+    request->args[request->arg_count++] = arg;
+    request->args[request->arg_count] = NULL;
+}
+
+// 0 once a whole request has arrived, -1 when the client sent garbage or left
+static int read_request(int fd, Request* request) {
+    memset(request, 0, sizeof(Request));
+    add_argument(request, "compiler");
+    FrameType type;
+    char* data;
+    uint32_t length;
+    while (read_frame(fd, &type, &data, &length) == 0) {
+        switch (type) {
+            case FRAME_DIRECTORY:
+                free(request->directory);
+                request->directory = data;
+                break;
+            case FRAME_ARGUMENT:
+                add_argument(request, data);
+                break;
+            case FRAME_SOURCE:
+                free(request->source);
+                request->source = data;
+                request->source_length = length;
+                break;
+            case FRAME_END:
+                free(data);
+                return request->directory && request->source ? 0 : -1;
+            default:
+                free(data);
+                return -1;
+        }
+    }
+    return -1;
+}
+
+static void print_diagnostic(const Diagnostic* diagnostic, void* context) {
+    (void)context;
+    fprintf(stderr, "%s\n", diagnostic->message);
+}
+
+// In the child: compiles as bin/compiler would have in the client's
+// directory, with stdout and stderr going to their pipes. The assembly is
+// sent whole once the compile has succeeded.
+static void compile_request(const Request* request, int out_fd, int err_fd, int asm_fd) {
+    close(listen_fd);
+    if (dup2(out_fd, STDOUT_FILENO) < 0 || dup2(err_fd, STDERR_FILENO) < 0) _exit(1);
+    close(out_fd);
+    close(err_fd);
+    if (chdir(request->directory) != 0) {
+        perror(request->directory);
+        exit(1);
+    }
+
+    CompilerOptions opts;
+    if (parse_options(request->arg_count, request->args, &opts) != 0) {
+        print_usage("compiler");
+        exit(1);
+    }
+    if (opts.server_socket) {
+        fprintf(stderr, "--server cannot be sent to a server\n");
+        exit(1);
+    }
+
+    CompilerHooks hooks = { NULL, print_diagnostic, NULL };
+    CompileResult result;
+    int status = compiler_compile(request->source, request->source_length, &opts, &hooks, &result);
+    FILE* asm_pipe = fdopen(asm_fd, "w");
+    if (result.assembly && asm_pipe) fwrite(result.assembly, 1, result.assembly_length, asm_pipe);
+    if (result.signal) {
+        // the status sent for a child killed by it is bin/compiler's
+        raise(result.signal);
+    }
+    exit(status);
+}
+
+// Forks the compile of `request` and streams its output back on `fd` as it
+// comes; the exit status follows once the child is gone.
+static void run_request(int fd, const Request* request) {
+    int pipes[3][2];
+    int made = 0;
+    pthread_mutex_lock(&fork_lock);
+    while (made < 3 && pipe(pipes[made]) == 0) made++;
+    pid_t pid = made == 3 ? fork() : -1;
+    if (pid == 0) {
+        for (int i = 0; i < 3; i++) close(pipes[i][0]);
+        compile_request(request, pipes[0][1], pipes[1][1], pipes[2][1]);
+    }
+    for (int i = 0; i < made; i++) close(pipes[i][1]);
+    pthread_mutex_unlock(&fork_lock);
+    if (pid < 0) {
+        perror("Failed to start a compile");
+        for (int i = 0; i < made; i++) close(pipes[i][0]);
+        return;
+    }
+
+    static const FrameType types[3] = { FRAME_STDOUT, FRAME_STDERR, FRAME_ASM };
+    struct pollfd fds[3];
+    for (int i = 0; i < 3; i++) fds[i] = (struct pollfd){ pipes[i][0], POLLIN, 0 };
+    // a client that went away still has its child drained and reaped
+    bool connected = true;
+    int open = 3;
+    char buffer[65536];
+    while (open > 0) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < 3; i++) {
+            if (fds[i].fd < 0 || fds[i].revents == 0) continue;
+            ssize_t n = read(fds[i].fd, buffer, sizeof(buffer));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                close(fds[i].fd);
+                fds[i].fd = -1;
+                open--;
+            } else if (connected && write_frame(fd, types[i], buffer, (uint32_t)n) != 0) {
+                connected = false;
+            }
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        if (fds[i].fd >= 0) close(fds[i].fd);
+    }
+
+    int wait_status;
+    while (waitpid(pid, &wait_status, 0) < 0 && errno == EINTR) {}
+    int32_t status = WIFEXITED(wait_status) ? WEXITSTATUS(wait_status) : 128 + WTERMSIG(wait_status);
+    if (connected) write_frame(fd, FRAME_STATUS, &status, sizeof(status));
+}
+
+static void* serve_connections(void* unused) {
+    (void)unused;
+    for (;;) {
+        int fd = take_connection();
+        Request request;
+        if (read_request(fd, &request) == 0) run_request(fd, &request);
+        free_request(&request);
+        close(fd);
+    }
+    return NULL;
+}
+
+int run_server(const CompilerOptions* opts) {
+    const char* path = opts->server_socket;
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path '%s' is too long\n", path);
+        return 1;
+    }
+    strcpy(address.sun_path, path);
+    // a client that hangs up must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    // the socket of a server that is gone is replaced, a live one is not
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0 && connect(probe, (struct sockaddr*)&address, sizeof(address)) == 0) {
+        fprintf(stderr, "Error: A server is already listening on %s\n", path);
+        close(probe);
+        return 1;
+    }
+    if (probe >= 0) close(probe);
+    unlink(path);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(listen_fd, SOMAXCONN) != 0) {
+        perror(path);
+        return 1;
+    }
+
+    for (int i = 0; i < opts->server_threads; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, serve_connections, NULL) != 0) {
+            fprintf(stderr, "Error: Failed to start server thread %d\n", i);
+            return 1;
+        }
+        pthread_detach(thread);
+    }
+    fprintf(stderr, "Serving compile requests on %s with %d threads\n", path, opts->server_threads);
+
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EINTR && errno != ECONNABORTED) perror("accept");
+            continue;
+        }
+        add_connection(fd);
+    }
+}
@@ -0,0 +1,301 @@
+#include "trace/trace.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+// Binary trace file: the magic, then records. A record starting with
+// NAME_RECORD gives a name its id the first time it is used:
+//     0xFF, u16 id, u16 length, name bytes
+// any other first byte is the category of an event:
+//     category, u32 line, u16 name id, u32 text length, text bytes
+// All integers are little-endian.
+
+#define TRACE_MAGIC "CTRACE1\n"
+#define NAME_RECORD 0xFF
+#define SINK_BUFFER (1 << 16)
+#define MAX_NAMES 0xFFFF
+// the id every name past MAX_NAMES is written with, defined as "?"
+#define OVERFLOW_NAME 0xFFFF
+
+unsigned trace_mask = 0;
+
+static const char* category_names[TRACE_CATEGORY_COUNT] = {
+    "tokens", "reductions", "ast", "symbols", "codegen",
+};
+
+static FILE* sink = NULL;
+static bool binary = false;
+static char* sink_buffer = NULL;
+
+// names already written to the binary file, by id
+static char** names = NULL;
+static int name_count = 0;
+static bool overflowed = false;
+
+// the event being written through trace_begin
+static struct {
+    FILE* stream;
+    char* text;
+    size_t length;
+    TraceCategory category;
+    int line;
+    const char* name;
+} pending;
+
+const char* trace_category_name(TraceCategory category) {
+    if (category < 0 || category >= TRACE_CATEGORY_COUNT) return "unknown";
+    return category_names[category];
+}
+
+static int parse_categories(const char* list, unsigned* mask) {
+    *mask = 0;
+    const char* p = list;
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        bool found = len == 3 && strncmp(p, "all", 3) == 0;
+        if (found) *mask = (1u << TRACE_CATEGORY_COUNT) - 1;
+        for (int i = 0; i < TRACE_CATEGORY_COUNT && !found; i++) {
+            if (strlen(category_names[i]) == len && strncmp(p, category_names[i], len) == 0) {
+                *mask |= 1u << i;
+                found = true;
+            }
+        }
+        if (!found) {
+            report(DIAGNOSTIC_ERROR, 0, "Unknown trace category '%.*s'", (int)len, p);
+            return -1;
+        }
+        p += len;
+        if (*p == ',') p++;
+    }
+    return 0;
+}
+
+int trace_open(const char* categories, const char* path) {
+    if (!categories && !path) return 0;
+    unsigned mask = (1u << TRACE_CATEGORY_COUNT) - 1;
+    if (categories && parse_categories(categories, &mask) != 0) return -1;
+
+    if (path) {
+        sink = fopen(path, "wb");
+        binary = true;
+    } else {
+        // a stream of our own, so error messages on stderr stay unbuffered
+        int fd = dup(STDERR_FILENO);
+        sink = fd >= 0 ? fdopen(fd, "w") : NULL;
+    }
+    if (!sink) {
+        report(DIAGNOSTIC_ERROR, 0, "%s: %s", path ? path : "Failed to open the trace stream", strerror(errno));
+        return -1;
+    }
+    sink_buffer = mem_alloc(SINK_BUFFER);
+    if (sink_buffer) setvbuf(sink, sink_buffer, _IOFBF, SINK_BUFFER);
+    if (binary) fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), sink);
+    trace_mask = mask;
+    return 0;
+}
+
+void trace_close(void) {
+    if (pending.stream) trace_end(pending.stream);
+    if (sink) fclose(sink);
+    mem_free(sink_buffer);
+    for (int i = 0; i < name_count; i++) mem_free(names[i]);
+    mem_free(names);
+    sink = NULL;
+    binary = false;
+    sink_buffer = NULL;
+    names = NULL;
+    name_count = 0;
+    overflowed = false;
+    trace_mask = 0;
+}
+
+static void put_u16(unsigned value) {
+    fputc(value & 0xFF, sink);
+    fputc((value >> 8) & 0xFF, sink);
+}
+
+static void put_u32(uint32_t value) {
+    put_u16(value & 0xFFFF);
+    put_u16(value >> 16);
+}
+
+static void put_name(unsigned id, const char* name) {
+    size_t len = strlen(name);
+    if (len > 0xFFFF) len = 0xFFFF;
+    fputc(NAME_RECORD, sink);
+    put_u16(id);
+    put_u16(len);
+    fwrite(name, 1, len, sink);
+}
+
+// id of `name` in the binary file, writing its definition on first use
+static int name_id(const char* name) {
+    for (int i = 0; i < name_count; i++) {
+        if (strcmp(names[i], name) == 0) return i;
+    }
+    if (name_count == MAX_NAMES) {
+        if (!overflowed) put_name(OVERFLOW_NAME, "?");
+        overflowed = true;
+        return OVERFLOW_NAME;
+    }
+    names = mem_realloc(names, (name_count + 1) * sizeof(char*));
+    if (!names || !(names[name_count] = mem_strdup(name))) {
+        out_of_memory("name_id");
+    }
+    put_name(name_count, name);
+    return name_count++;
+}
+
+static void write_event(TraceCategory category, int line, const char* name, const char* text, size_t length) {
+    if (!sink) return;
+    if (!binary) {
+        trace_format(sink, category, line, name, text, length);
+        return;
+    }
+    int id = name_id(name);
+    fputc(category, sink);
+    put_u32(line);
+    put_u16(id);
+    put_u32(length);
+    if (length > 0) fwrite(text, 1, length, sink);
+}
+
+void trace_event(TraceCategory category, int line, const char* name, const char* text) {
+    write_event(category, line, name, text, text ? strlen(text) : 0);
+}
+
+void trace_printf(TraceCategory category, int line, const char* name, const char* fmt, ...) {
+    char text[512];
+    va_list args;
+    va_start(args, fmt);
+    int length = vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    if (length < 0) return;
+    write_event(category, line, name, text, (size_t)length < sizeof(text) ? (size_t)length : sizeof(text) - 1);
+}
+
+FILE* trace_begin(TraceCategory category, int line, const char* name) {
+    if (pending.stream) trace_end(pending.stream);
+    pending.stream = mem_stream(&pending.text, &pending.length);
+    if (!pending.stream) {
+        out_of_memory("trace_begin");
+    }
+    pending.category = category;
+    pending.line = line;
+    pending.name = name;
+    return pending.stream;
+}
+
+void trace_end(FILE* stream) {
+    if (!stream || stream != pending.stream) return;
+    fclose(stream);
+    pending.stream = NULL;
+    write_event(pending.category, pending.line, pending.name, pending.text, pending.length);
+    mem_free(pending.text);
+    pending.text = NULL;
+}
+
+void trace_format(FILE* output, TraceCategory category, int line, const char* name,
+                  const char* text, size_t length) {
+    fprintf(output, "[%s]", trace_category_name(category));
+    if (line > 0) fprintf(output, " %d:", line);
+    fprintf(output, " %s", name);
+    if (length == 0) {
+        fputc('\n', output);
+    } else if (memchr(text, '\n', length)) {
+        // multi-line text (a tree, a table) starts on its own line
+        fputc('\n', output);
+        fwrite(text, 1, length, output);
+        if (text[length - 1] != '\n') fputc('\n', output);
+    } else {
+        fprintf(output, " %.*s\n", (int)length, text);
+    }
+}
+
+// --- reading a binary trace ---
+
+static bool get_u16(FILE* input, unsigned* out) {
+    int lo = fgetc(input), hi = fgetc(input);
+    if (lo == EOF || hi == EOF) return false;
+    *out = (unsigned)lo | ((unsigned)hi << 8);
+    return true;
+}
+
+static bool get_u32(FILE* input, uint32_t* out) {
+    unsigned lo, hi;
+    if (!get_u16(input, &lo) || !get_u16(input, &hi)) return false;
+    *out = lo | ((uint32_t)hi << 16);
+    return true;
+}
+
+static char* get_bytes(FILE* input, size_t length) {
+    char* bytes = mem_alloc(length + 1);
+    if (!bytes) {
+        out_of_memory("get_bytes");
+    }
+    if (fread(bytes, 1, length, input) != length) {
+        mem_free(bytes);
+        return NULL;
+    }
+    bytes[length] = '\0';
+    return bytes;
+}
+
+int trace_dump(FILE* input, FILE* output) {
+    char magic[sizeof(TRACE_MAGIC) - 1];
+    if (fread(magic, 1, sizeof(magic), input) != sizeof(magic) ||
+        memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0) {
+        fprintf(stderr, "Error: Not a trace file\n");
+        return -1;
+    }
+
+    char** table = NULL;
+    int table_size = 0;
+    int status = 0;
+    int kind;
+    while ((kind = fgetc(input)) != EOF) {
+        if (kind == NAME_RECORD) {
+            unsigned id, length;
+            char* name = NULL;
+            if (!get_u16(input, &id) || !get_u16(input, &length) || !(name = get_bytes(input, length))) {
+                status = -1;
+                break;
+            }
+            if ((int)id >= table_size) {
+                table = mem_realloc(table, (id + 1) * sizeof(char*));
+                if (!table) {
+                    out_of_memory("trace_dump");
+                }
+                memset(table + table_size, 0, (id + 1 - table_size) * sizeof(char*));
+                table_size = id + 1;
+            }
+            mem_free(table[id]);
+            table[id] = name;
+            continue;
+        }
+        uint32_t line, length;
+        unsigned id;
+        char* text = NULL;
+        if (kind >= TRACE_CATEGORY_COUNT || !get_u32(input, &line) || !get_u16(input, &id) ||
+            !get_u32(input, &length) || !(text = get_bytes(input, length))) {
+            status = -1;
+            break;
+        }
+        const char* name = (int)id < table_size && table[id] ? table[id] : "?";
+        trace_format(output, (TraceCategory)kind, (int)line, name, text, length);
+        mem_free(text);
+    }
+    if (status != 0) fprintf(stderr, "Error: Truncated or corrupt trace record\n");
+
+    for (int i = 0; i < table_size; i++) mem_free(table[i]);
+    mem_free(table);
+    return status;
+}
@@ -0,0 +1,21 @@
+#include "trace/trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// tracedump: prints a binary trace written with --trace-file as text, in
+// the same format --trace writes to stderr.
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s trace_file\n", argv[0]);
+        return 1;
+    }
+    FILE* input = fopen(argv[1], "rb");
+    if (!input) {
+        perror("Error opening file");
+        return 1;
+    }
+    int status = trace_dump(input, stdout);
+    fclose(input);
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+#include "vm/bytecode.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char* opcode_names[] = {
+#define BC_NAME(name, fmt) #name,
+    BYTECODE_OPS(BC_NAME)
+#undef BC_NAME
+};
+
+static const char* opcode_formats[] = {
+#define BC_FORMAT(name, fmt) fmt,
+    BYTECODE_OPS(BC_FORMAT)
+#undef BC_FORMAT
+};
+
+BytecodeProgram* bytecode_create(void) {
+    BytecodeProgram* prog = mem_calloc(1, sizeof(BytecodeProgram));
+    if (!prog) {
+        out_of_memory("bytecode_create");
+    }
+    return prog;
+}
+
+void bytecode_free(BytecodeProgram* prog) {
+    if (!prog) return;
+    for (int i = 0; i < prog->func_count; i++) {
+        mem_free(prog->funcs[i].name);
+        mem_free(prog->funcs[i].param_slots);
+    }
+    for (int i = 0; i < prog->string_count; i++) {
+        mem_free(prog->strings[i]);
+    }
+    mem_free(prog->funcs);
+    mem_free(prog->strings);
+    mem_free(prog->string_lens);
+    mem_free(prog->consts);
+    mem_free(prog->code);
+    mem_free(prog);
+}
+
+int bytecode_emit(BytecodeProgram* prog, Opcode op, int a, int b, int c, int32_t imm) {
+    if (prog->count == prog->capacity) {
+        prog->capacity = prog->capacity ? prog->capacity * 2 : 256;
+        prog->code = mem_realloc(prog->code, prog->capacity * sizeof(Instr));
+        if (!prog->code) {
+            out_of_memory("bytecode_emit");
+        }
+    }
+    Instr* ins = &prog->code[prog->count];
+    ins->op = (uint8_t)op;
+    ins->a = (uint8_t)a;
+    ins->b = (uint8_t)b;
+    ins->c = (uint8_t)c;
+    ins->imm = imm;
+    return prog->count++;
+}
+
+void bytecode_patch(BytecodeProgram* prog, int at, int32_t target) {
+    prog->code[at].imm = target;
+}
+
+int bytecode_add_string(BytecodeProgram* prog, const char* str) {
+    prog->strings = mem_realloc(prog->strings, (prog->string_count + 1) * sizeof(char*));
+    prog->string_lens = mem_realloc(prog->string_lens, (prog->string_count + 1) * sizeof(int));
+    if (!prog->strings || !prog->string_lens) {
+        out_of_memory("bytecode_add_string");
+    }
+    // stored with the trailing newline, like the 0xA appended in .data
+    int len = (int)strlen(str);
+    char* copy = mem_alloc(len + 1);
+    if (!copy) {
+        out_of_memory("bytecode_add_string");
+    }
+    memcpy(copy, str, len);
+    copy[len] = '\n';
+    prog->strings[prog->string_count] = copy;
+    prog->string_lens[prog->string_count] = len + 1;
+    return prog->string_count++;
+}
+
+int bytecode_add_const(BytecodeProgram* prog, int64_t value) {
+    for (int i = 0; i < prog->const_count; i++) {
+        if (prog->consts[i] == value) return i;
+    }
+    prog->consts = mem_realloc(prog->consts, (prog->const_count + 1) * sizeof(int64_t));
+    if (!prog->consts) {
+        out_of_memory("bytecode_add_const");
+    }
+    prog->consts[prog->const_count] = value;
+    return prog->const_count++;
+}
+
+int bytecode_add_func(BytecodeProgram* prog, const char* name) {
+    prog->funcs = mem_realloc(prog->funcs, (prog->func_count + 1) * sizeof(BytecodeFunc));
+    if (!prog->funcs) {
+        out_of_memory("bytecode_add_func");
+    }
+    BytecodeFunc* fn = &prog->funcs[prog->func_count];
+    memset(fn, 0, sizeof(BytecodeFunc));
+    fn->name = mem_strdup(name);
+    fn->entry = -1;
+    return prog->func_count++;
+}
+
+int bytecode_find_func(BytecodeProgram* prog, const char* name) {
+    for (int i = 0; i < prog->func_count; i++) {
+        if (strcmp(prog->funcs[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char* opcode_name(Opcode op) {
+    if (op < 0 || op >= BC_OPCOUNT) return "UNKNOWN";
+    return opcode_names[op];
+}
+
+void bytecode_dump(BytecodeProgram* prog, FILE* output) {
+    for (int i = 0; i < prog->count; i++) {
+        for (int f = 0; f < prog->func_count; f++) {
+            if (prog->funcs[f].entry == i) {
+                fprintf(output, "%s:  ; regs=%d params=%d\n", prog->funcs[f].name,
+                        prog->funcs[f].nregs, prog->funcs[f].nparams);
+            }
+        }
+        if (i == prog->entry) {
+            fprintf(output, "_start:  ; regs=%d\n", prog->entry_nregs);
+        }
+
+        Instr* ins = &prog->code[i];
+        fprintf(output, "%5d  %-7s", i, opcode_name(ins->op));
+        switch (opcode_formats[ins->op][0]) {
+            case 'R':
+                fprintf(output, "r%d, r%d, r%d\n", ins->a, ins->b, ins->c);
+                break;
+            case 'I':
+                if (ins->op == BC_JTAB) {
+                    fprintf(output, "r%d - r%d, %d entries + default\n", ins->a, ins->b, ins->imm);
+                } else if (ins->op == BC_LOADX || ins->op == BC_STOREX) {
+                    fprintf(output, "r%d, [%d + r%d]\n", ins->a, ins->imm, ins->b);
+                } else if (ins->op == BC_LOADK) {
+                    fprintf(output, "r%d, %lld\n", ins->a, (long long)prog->consts[ins->imm]);
+                } else if (ins->op == BC_EXT) {
+                    fprintf(output, "r%d, %c%d\n", ins->a, ins->imm < 0 ? 'i' : 'u',
+                            ins->imm < 0 ? -ins->imm : ins->imm);
+                } else if (ins->op == BC_CALL || ins->op == BC_TAILCALL) {
+                    fprintf(output, "r%d, %s(r%d..%d)\n", ins->a,
+                            prog->funcs[ins->imm].name, ins->b, ins->b + ins->c);
+                } else {
+                    fprintf(output, "r%d, %d\n", ins->a, ins->imm);
+                }
+                break;
+            case 'J':
+                fprintf(output, "r%d, r%d -> %d\n", ins->a, ins->b, ins->imm);
+                break;
+        }
+    }
+}
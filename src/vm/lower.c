@@ -0,0 +1,434 @@
+#include "vm/vm.h"
+#include "vm/bytecode.h"
+#include "codegen/helpers.h"
+#include "codegen/symbol.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+    BytecodeProgram* prog;
+    int max_reg;        // register high-water mark of the current function
+    int* breaks;        // pending break jumps, patched when their loop or switch closes
+    int break_count;
+    int break_capacity;
+    int break_depth;    // enclosing loops and switches
+    bool in_function;
+} Lowerer;
+
+static void lower_stmt(Lowerer* l, ASTNode* node);
+static void lower_expr(Lowerer* l, ASTNode* node, int dst);
+
+static int use_reg(Lowerer* l, int reg) {
+    if (reg >= BC_MAX_REGS) {
+        compile_error(0, "Expression too deep for the bytecode register window");
+    }
+    if (reg + 1 > l->max_reg) l->max_reg = reg + 1;
+    return reg;
+}
+
+static int slot_of(const char* name) {
+    Symbol* sym = lookup_symbol(name);
+    if (!sym) {
+        compile_error(0, "Undefined variable '%s'", name);
+    }
+    return sym->index;
+}
+
+// narrows r[reg] to the type of variable `name` before it is stored
+static void lower_narrow(Lowerer* l, int reg, const char* name) {
+    Symbol* sym = lookup_symbol(name);
+    int size = type_size(sym->type);
+    if (size < 8) {
+        bytecode_emit(l->prog, BC_EXT, reg, 0, 0, type_is_signed(sym->type) ? -8 * size : 8 * size);
+    }
+}
+
+// r[dst] = the value of a literal
+static void lower_constant(Lowerer* l, int64_t value, int dst) {
+    if (value >= INT32_MIN && value <= INT32_MAX) {
+        bytecode_emit(l->prog, BC_LOADI, dst, 0, 0, (int32_t)value);
+    } else {
+        bytecode_emit(l->prog, BC_LOADK, dst, 0, 0, bytecode_add_const(l->prog, value));
+    }
+}
+
+static Opcode binop_opcode(Operator op) {
+    switch (op) {
+        case OP_ADD:    return BC_ADD;
+        case OP_SUB:    return BC_SUB;
+        case OP_MUL:    return BC_MUL;
+        case OP_DIV:    return BC_DIV;
+        case OP_MOD:    return BC_MOD;
+        case OP_BAND:   return BC_AND;
+        case OP_BOR:    return BC_OR;
+        case OP_BXOR:   return BC_XOR;
+        case OP_BNAND:  return BC_NAND;
+        case OP_BNOR:   return BC_NOR;
+        case OP_BXNOR:  return BC_XNOR;
+        case OP_LSHIFT: return BC_SHL;
+        case OP_RSHIFT: return BC_SHR;
+        case OP_EQ:     return BC_EQ;
+        case OP_NEQ:    return BC_NE;
+        case OP_LT:     return BC_LT;
+        case OP_LE:     return BC_LE;
+        case OP_GT:     return BC_GT;
+        case OP_GE:     return BC_GE;
+        case OP_LAND:   return BC_LAND;
+        case OP_LOR:    return BC_LOR;
+        default:
+            compile_error(0, "Unsupported binary operator %s", operator_to_string(op));
+    }
+}
+
+// compare-and-branch opcode taken when `op` holds, or when it fails if negate is set
+static bool branch_opcode(Operator op, bool negate, Opcode* out) {
+    switch (op) {
+        case OP_EQ:  *out = negate ? BC_JNE : BC_JEQ; return true;
+        case OP_NEQ: *out = negate ? BC_JEQ : BC_JNE; return true;
+        case OP_LT:  *out = negate ? BC_JGE : BC_JLT; return true;
+        case OP_LE:  *out = negate ? BC_JGT : BC_JLE; return true;
+        case OP_GT:  *out = negate ? BC_JLE : BC_JGT; return true;
+        case OP_GE:  *out = negate ? BC_JLT : BC_JGE; return true;
+        default:     return false;
+    }
+}
+
+static void lower_call(Lowerer* l, ASTNode* node, int dst, Opcode op) {
+    int func = bytecode_find_func(l->prog, node->func_call.func_name);
+    if (func < 0) {
+        compile_error(0, "Undefined function '%s'", node->func_call.func_name);
+    }
+
+    int argc = 0;
+    for (ASTNode* arg = node->func_call.args; arg; arg = arg->binop.right) {
+        lower_expr(l, arg->binop.left, use_reg(l, dst + argc));
+        argc++;
+    }
+    if (argc > 255) {
+        compile_error(0, "Too many arguments in call to '%s'", node->func_call.func_name);
+    }
+    bytecode_emit(l->prog, op, dst, dst, argc, func);
+}
+
+static void lower_expr(Lowerer* l, ASTNode* node, int dst) {
+    use_reg(l, dst);
+    switch (node->type) {
+        case NODE_NUM:
+            lower_constant(l, node->num_value, dst);
+            break;
+        case NODE_IDENT:
+            bytecode_emit(l->prog, BC_LOADG, dst, 0, 0, slot_of(node->str_value));
+            break;
+        case NODE_CALL:
+            lower_call(l, node, dst, BC_CALL);
+            break;
+        case NODE_INDEX:
+            lower_expr(l, node->element.index, dst);
+            bytecode_emit(l->prog, BC_LOADX, dst, dst, 0, slot_of(node->element.array->str_value));
+            break;
+        case NODE_BINOP: {
+            int rhs = use_reg(l, dst + 1);
+            lower_expr(l, node->binop.left, dst);
+            lower_expr(l, node->binop.right, rhs);
+            bytecode_emit(l->prog, binop_opcode(node->binop.op), dst, dst, rhs, 0);
+            break;
+        }
+        case NODE_UNOP:
+            lower_expr(l, node->unop.operand, dst);
+            switch (node->unop.op) {
+                case OP_NEG:  bytecode_emit(l->prog, BC_NEG, dst, dst, 0, 0); break;
+                case OP_BNOT: bytecode_emit(l->prog, BC_NOT, dst, dst, 0, 0); break;
+                case OP_LNOT: bytecode_emit(l->prog, BC_LNOT, dst, dst, 0, 0); break;
+                case OP_POS:  break;
+                default:
+                    compile_error(0, "Unsupported unary operator %s",
+                            operator_to_string(node->unop.op));
+            }
+            break;
+        default:
+            // strings have no integer value outside of print
+            bytecode_emit(l->prog, BC_LOADI, dst, 0, 0, 0);
+            break;
+    }
+}
+
+// emits a branch taken when `cond` evaluates to `when`; returns it for patching
+static int lower_branch(Lowerer* l, ASTNode* cond, bool when) {
+    Opcode op;
+    if (cond->type == NODE_BINOP && branch_opcode(cond->binop.op, !when, &op)) {
+        lower_expr(l, cond->binop.left, 0);
+        lower_expr(l, cond->binop.right, use_reg(l, 1));
+        return bytecode_emit(l->prog, op, 0, 1, 0, -1);
+    }
+    if (cond->type == NODE_UNOP && cond->unop.op == OP_LNOT) {
+        lower_expr(l, cond->unop.operand, 0);
+        return bytecode_emit(l->prog, when ? BC_JZ : BC_JNZ, 0, 0, 0, -1);
+    }
+    lower_expr(l, cond, 0);
+    return bytecode_emit(l->prog, when ? BC_JNZ : BC_JZ, 0, 0, 0, -1);
+}
+
+static void push_break(Lowerer* l, int at) {
+    if (l->break_count == l->break_capacity) {
+        l->break_capacity = l->break_capacity ? l->break_capacity * 2 : 16;
+        l->breaks = mem_realloc(l->breaks, l->break_capacity * sizeof(int));
+        if (!l->breaks) {
+            out_of_memory("push_break");
+        }
+    }
+    l->breaks[l->break_count++] = at;
+}
+
+static void lower_while(Lowerer* l, ASTNode* node) {
+    // rotated: one conditional branch per iteration
+    int first_break = l->break_count;
+    int to_cond = bytecode_emit(l->prog, BC_JMP, 0, 0, 0, -1);
+    int body = l->prog->count;
+
+    l->break_depth++;
+    lower_stmt(l, node->control.loop_body);
+    l->break_depth--;
+
+    bytecode_patch(l->prog, to_cond, l->prog->count);
+    int back = lower_branch(l, node->control.condition, true);
+    bytecode_patch(l->prog, back, body);
+
+    for (int i = first_break; i < l->break_count; i++) {
+        bytecode_patch(l->prog, l->breaks[i], l->prog->count);
+    }
+    l->break_count = first_break;
+}
+
+// a jump out of the switch dispatch, waiting for the start of clause
+// `clause` (-1: the default clause, or the end without one)
+typedef struct {
+    int at;
+    int clause;
+} CaseJump;
+
+// binary search over labels[low..high] for the value in r0
+static void lower_case_search(Lowerer* l, const CaseLabel* labels, int low, int high,
+                              CaseJump* jumps, int* count) {
+    if (high - low < 3) {
+        for (int i = low; i <= high; i++) {
+            bytecode_emit(l->prog, BC_LOADI, use_reg(l, 1), 0, 0, labels[i].value);
+            jumps[(*count)++] = (CaseJump){ bytecode_emit(l->prog, BC_JEQ, 0, 1, 0, -1), labels[i].index };
+        }
+        jumps[(*count)++] = (CaseJump){ bytecode_emit(l->prog, BC_JMP, 0, 0, 0, -1), -1 };
+        return;
+    }
+    int mid = low + (high - low) / 2;
+    bytecode_emit(l->prog, BC_LOADI, use_reg(l, 1), 0, 0, labels[mid].value);
+    jumps[(*count)++] = (CaseJump){ bytecode_emit(l->prog, BC_JEQ, 0, 1, 0, -1), labels[mid].index };
+    int upper = bytecode_emit(l->prog, BC_JGT, 0, 1, 0, -1);
+    lower_case_search(l, labels, low, mid - 1, jumps, count);
+    bytecode_patch(l->prog, upper, l->prog->count);
+    lower_case_search(l, labels, mid + 1, high, jumps, count);
+}
+
+static void lower_switch(Lowerer* l, ASTNode* node) {
+    CaseLabel* labels;
+    int default_index;
+    int count = collect_case_labels(node, &labels, &default_index);
+    int clauses = 0;
+    for (ASTNode* c = node->switch_stmt.cases; c; c = c->binop.right) clauses++;
+
+    bool table = dense_case_labels(labels, count);
+    int span = table ? labels[count - 1].value - labels[0].value + 1 : 0;
+    // a table has one jump per value in the range plus the fallback; a
+    // search one per case plus at most one fallback per case
+    CaseJump* jumps = mem_alloc((table ? span + 1 : 2 * count + 1) * sizeof(CaseJump));
+    int* starts = mem_alloc((clauses + 1) * sizeof(int));
+    if (!jumps || !starts) {
+        out_of_memory("lower_switch");
+    }
+    int jump_count = 0;
+
+    lower_expr(l, node->switch_stmt.expr, 0);
+    if (table) {
+        bytecode_emit(l->prog, BC_LOADI, use_reg(l, 1), 0, 0, labels[0].value);
+        bytecode_emit(l->prog, BC_JTAB, 0, 1, 0, span);
+        for (int i = 0, next = 0; i <= span; i++) {
+            int clause = -1;
+            if (i < span && labels[next].value - labels[0].value == i) clause = labels[next++].index;
+            jumps[jump_count++] = (CaseJump){ bytecode_emit(l->prog, BC_JMP, 0, 0, 0, -1), clause };
+        }
+    } else if (count > 0) {
+        lower_case_search(l, labels, 0, count - 1, jumps, &jump_count);
+    } else {
+        jumps[jump_count++] = (CaseJump){ bytecode_emit(l->prog, BC_JMP, 0, 0, 0, -1), -1 };
+    }
+
+    // clauses in source order; control falls from one into the next
+    int first_break = l->break_count;
+    l->break_depth++;
+    int index = 0;
+    for (ASTNode* c = node->switch_stmt.cases; c; c = c->binop.right, index++) {
+        starts[index] = l->prog->count;
+        lower_stmt(l, c->binop.left->case_clause.body);
+    }
+    l->break_depth--;
+    int end = l->prog->count;
+
+    for (int i = 0; i < jump_count; i++) {
+        int clause = jumps[i].clause >= 0 ? jumps[i].clause : default_index;
+        bytecode_patch(l->prog, jumps[i].at, clause >= 0 ? starts[clause] : end);
+    }
+    for (int i = first_break; i < l->break_count; i++) {
+        bytecode_patch(l->prog, l->breaks[i], end);
+    }
+    l->break_count = first_break;
+    mem_free(jumps);
+    mem_free(starts);
+    mem_free(labels);
+}
+
+static void lower_if(Lowerer* l, ASTNode* node) {
+    int to_else = lower_branch(l, node->control.condition, false);
+    lower_stmt(l, node->control.if_body);
+    if (node->control.else_body) {
+        int to_end = bytecode_emit(l->prog, BC_JMP, 0, 0, 0, -1);
+        bytecode_patch(l->prog, to_else, l->prog->count);
+        lower_stmt(l, node->control.else_body);
+        bytecode_patch(l->prog, to_end, l->prog->count);
+    } else {
+        bytecode_patch(l->prog, to_else, l->prog->count);
+    }
+}
+
+static void lower_stmt(Lowerer* l, ASTNode* node) {
+    if (!node) return;
+    switch (node->type) {
+        case NODE_COMPOUND:
+            lower_stmt(l, node->binop.left);
+            lower_stmt(l, node->binop.right);
+            break;
+        case NODE_DECL:
+            if (node->decl.init_expr) {
+                lower_expr(l, node->decl.init_expr, 0);
+                lower_narrow(l, 0, node->decl.name);
+                bytecode_emit(l->prog, BC_STOREG, 0, 0, 0, slot_of(node->decl.name));
+            }
+            break;
+        case NODE_ASSIGN:
+            lower_expr(l, node->assign.value, 0);
+            lower_narrow(l, 0, node->assign.target->str_value);
+            bytecode_emit(l->prog, BC_STOREG, 0, 0, 0, slot_of(node->assign.target->str_value));
+            break;
+        case NODE_INDEX_ASSIGN:
+            lower_expr(l, node->element.index, 0);
+            lower_expr(l, node->element.value, use_reg(l, 1));
+            lower_narrow(l, 1, node->element.array->str_value);
+            bytecode_emit(l->prog, BC_STOREX, 1, 0, 0, slot_of(node->element.array->str_value));
+            break;
+        case NODE_PRINT:
+            if (node->print_expr.expr->type == NODE_STR) {
+                int str = bytecode_add_string(l->prog, node->print_expr.expr->str_value);
+                bytecode_emit(l->prog, BC_PRINTS, 0, 0, 0, str);
+            } else {
+                lower_expr(l, node->print_expr.expr, 0);
+                bytecode_emit(l->prog, BC_PRINTI, 0, 0, 0, 0);
+            }
+            break;
+        case NODE_IF:
+            lower_if(l, node);
+            break;
+        case NODE_WHILE:
+            lower_while(l, node);
+            break;
+        case NODE_SWITCH:
+            lower_switch(l, node);
+            break;
+        case NODE_BREAK:
+            if (l->break_depth == 0) {
+                compile_error(0, "'break' outside of a loop or switch");
+            }
+            push_break(l, bytecode_emit(l->prog, BC_JMP, 0, 0, 0, -1));
+            break;
+        case NODE_RETURN:
+            if (node->return_stmt.tail_call && l->in_function) {
+                lower_call(l, node->return_stmt.expr, 0, BC_TAILCALL);
+            } else if (node->return_stmt.expr) {
+                lower_expr(l, node->return_stmt.expr, 0);
+            } else {
+                bytecode_emit(l->prog, BC_LOADI, 0, 0, 0, 0);
+            }
+            bytecode_emit(l->prog, BC_RET, 0, 0, 0, 0);
+            break;
+        case NODE_EMPTY:
+            break;
+        default:
+            // expression used as a statement: evaluate for side effects
+            lower_expr(l, node, 0);
+            break;
+    }
+}
+
+static void lower_function(Lowerer* l, ASTNode* node) {
+    BytecodeFunc* fn = &l->prog->funcs[bytecode_find_func(l->prog, node->func.name)];
+
+    // parameters are copied into their global slots on entry, as in handle_function
+    for (ASTNode* p = node->func.params; p; p = p->binop.right) {
+        fn->param_slots = mem_realloc(fn->param_slots, (fn->nparams + 1) * sizeof(int));
+        if (!fn->param_slots) {
+            out_of_memory("lower_function");
+        }
+        fn->param_slots[fn->nparams++] = slot_of(p->binop.left->param.name);
+    }
+
+    l->max_reg = 1;
+    l->in_function = true;
+    fn->entry = l->prog->count;
+    // CALL copies the arguments whole; narrow parameters are cut down here
+    for (ASTNode* p = node->func.params; p; p = p->binop.right) {
+        const char* name = p->binop.left->param.name;
+        if (type_size(lookup_symbol(name)->type) == 8) continue;
+        bytecode_emit(l->prog, BC_LOADG, 0, 0, 0, slot_of(name));
+        lower_narrow(l, 0, name);
+        bytecode_emit(l->prog, BC_STOREG, 0, 0, 0, slot_of(name));
+    }
+    lower_stmt(l, node->func.body);
+    l->in_function = false;
+    bytecode_emit(l->prog, BC_LOADI, 0, 0, 0, 0);
+    bytecode_emit(l->prog, BC_RET, 0, 0, 0, 0);
+    fn->nregs = l->max_reg;
+}
+
+BytecodeProgram* lower_program(ASTNode* root) {
+    Lowerer l = {0};
+    l.prog = bytecode_create();
+    l.prog->global_count = symbol_slot_count();
+
+    // register every function first so calls can refer forward
+    for (ASTNode* f = root->program.functions; f; f = f->binop.right) {
+        if (bytecode_find_func(l.prog, f->binop.left->func.name) < 0) {
+            bytecode_add_func(l.prog, f->binop.left->func.name);
+        }
+    }
+    for (ASTNode* f = root->program.functions; f; f = f->binop.right) {
+        lower_function(&l, f->binop.left);
+    }
+
+    l.max_reg = 1;
+    l.prog->entry = l.prog->count;
+    if (has_main_function(root->program.functions)) {
+        bytecode_emit(l.prog, BC_CALL, 0, 0, 0, bytecode_find_func(l.prog, "main"));
+        bytecode_emit(l.prog, BC_HALT, 0, 0, 0, 0);
+    } else if (root->program.main_block) {
+        lower_stmt(&l, root->program.main_block);
+        bytecode_emit(l.prog, BC_LOADI, 0, 0, 0, 0);
+        bytecode_emit(l.prog, BC_HALT, 0, 0, 0, 0);
+    } else {
+        compile_error(0, "No entry point (main function or MAIN block)");
+    }
+    l.prog->entry_nregs = l.max_reg;
+
+    mem_free(l.breaks);
+    return l.prog;
+}
@@ -0,0 +1,351 @@
+#include "vm/vm.h"
+#include "vm/bytecode.h"
+#include "codegen/helpers.h"
+#include "codegen/symbol.h"
+#include "trace/trace.h"
+#include "driver/stats.h"
+#include "driver/memory.h"
+#include "driver/diagnostics.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+
+// computed-goto dispatch where the compiler supports labels as values,
+// a plain switch loop otherwise
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_THREADED 1
+#endif
+
+typedef struct {
+    int ret_pc;
+    int base;       // first register of the caller's window
+    int nregs;      // caller's window size
+    uint8_t ret_reg;
+} Frame;
+
+// program output goes straight to fd 1 like the write syscalls in the native code
+static char out_buffer[1 << 16];
+static size_t out_len = 0;
+
+static void out_flush(void) {
+    size_t done = 0;
+    while (done < out_len) {
+        ssize_t n = write(1, out_buffer + done, out_len - done);
+        if (n <= 0) break;
+        done += (size_t)n;
+    }
+    out_len = 0;
+}
+
+static void out_write(const char* data, size_t len) {
+    if (out_len + len > sizeof(out_buffer)) out_flush();
+    if (len > sizeof(out_buffer)) {
+        memcpy(out_buffer, data, sizeof(out_buffer));
+        out_len = sizeof(out_buffer);
+        out_flush();
+        out_write(data + sizeof(out_buffer), len - sizeof(out_buffer));
+        return;
+    }
+    memcpy(out_buffer + out_len, data, len);
+    out_len += len;
+}
+
+// same text as itoa in the generated assembly: optional '-', digits, newline
+static void out_int(int64_t value) {
+    char buf[24];
+    int pos = sizeof(buf);
+    uint64_t mag = value < 0 ? (uint64_t)0 - (uint64_t)value : (uint64_t)value;
+    buf[--pos] = '\n';
+    do {
+        buf[--pos] = (char)('0' + mag % 10);
+        mag /= 10;
+    } while (mag);
+    if (value < 0) buf[--pos] = '-';
+    out_write(buf + pos, sizeof(buf) - pos);
+}
+
+// the signal the native program would have died of; the run ends there
+// and the compile with it, leaving the signal to the caller
+static int fault_signal = 0;
+
+static _Noreturn void fault(int signo) {
+    out_flush();
+    fault_signal = signo;
+    compile_abort();
+}
+
+int vm_fault(void) {
+    int signo = fault_signal;
+    fault_signal = 0;
+    return signo;
+}
+
+// idiv faults on these; do the same so the exit status matches
+static void check_division(int64_t lhs, int64_t rhs) {
+    if (rhs == 0 || (lhs == INT64_MIN && rhs == -1)) {
+        fault(SIGFPE);
+    }
+}
+
+// the native code does not check indexes either, but the VM must not read
+// or write outside its globals
+static void check_element(int64_t slot, int global_count) {
+    if (slot < 0 || slot >= global_count) {
+        fault(SIGSEGV);
+    }
+}
+
+int vm_run(BytecodeProgram* prog) {
+    // what a run that ended on an error left buffered is not printed
+    out_len = 0;
+    int64_t* globals = mem_calloc(prog->global_count ? prog->global_count : 1, sizeof(int64_t));
+    int reg_capacity = 1024;
+    int64_t* regfile = mem_calloc(reg_capacity, sizeof(int64_t));
+    int frame_capacity = 256;
+    int frame_count = 0;
+    Frame* frames = mem_alloc(frame_capacity * sizeof(Frame));
+    if (!globals || !regfile || !frames) {
+        out_of_memory("vm_run");
+    }
+
+    const Instr* code = prog->code;
+    const int64_t* consts = prog->consts;
+    const Instr* pc = code + prog->entry;
+    int base = 0;
+    int nregs = prog->entry_nregs;
+    int64_t* r = regfile;
+    int64_t status = 0;
+
+#ifdef VM_THREADED
+    static void* dispatch_table[] = {
+#define BC_LABEL(name, fmt) &&op_##name,
+        BYTECODE_OPS(BC_LABEL)
+#undef BC_LABEL
+    };
+#define TARGET(name) op_##name:
+#define DISPATCH()   goto *dispatch_table[pc->op]
+#else
+#define TARGET(name) case BC_##name:
+#define DISPATCH()   goto dispatch
+#endif
+#define NEXT()       do { pc++; DISPATCH(); } while (0)
+#define JUMP(target) do { pc = code + (target); DISPATCH(); } while (0)
+#define BINARY(name, expr) \
+    TARGET(name) { int64_t x = r[pc->b], y = r[pc->c]; (void)x; (void)y; r[pc->a] = (expr); NEXT(); }
+#define BRANCH(name, cond) \
+    TARGET(name) { if (cond) JUMP(pc->imm); NEXT(); }
+
+#ifdef VM_THREADED
+    DISPATCH();
+#else
+dispatch:
+    switch (pc->op) {
+#endif
+
+    TARGET(LOADI)  { r[pc->a] = pc->imm; NEXT(); }
+    TARGET(LOADK)  { r[pc->a] = consts[pc->imm]; NEXT(); }
+    TARGET(LOADG)  { r[pc->a] = globals[pc->imm]; NEXT(); }
+    TARGET(STOREG) { globals[pc->imm] = r[pc->a]; NEXT(); }
+    TARGET(LOADX) {
+        int64_t slot = (int64_t)pc->imm + r[pc->b];
+        check_element(slot, prog->global_count);
+        r[pc->a] = globals[slot];
+        NEXT();
+    }
+    TARGET(STOREX) {
+        int64_t slot = (int64_t)pc->imm + r[pc->b];
+        check_element(slot, prog->global_count);
+        globals[slot] = r[pc->a];
+        NEXT();
+    }
+    TARGET(MOV)    { r[pc->a] = r[pc->b]; NEXT(); }
+    TARGET(EXT) {
+        int shift = 64 - (pc->imm < 0 ? -pc->imm : pc->imm);
+        uint64_t high = (uint64_t)r[pc->a] << shift;
+        r[pc->a] = pc->imm < 0 ? (int64_t)high >> shift : (int64_t)(high >> shift);
+        NEXT();
+    }
+
+    BINARY(ADD,  (int64_t)((uint64_t)x + (uint64_t)y))
+    BINARY(SUB,  (int64_t)((uint64_t)x - (uint64_t)y))
+    BINARY(MUL,  (int64_t)((uint64_t)x * (uint64_t)y))
+    TARGET(DIV) {
+        int64_t x = r[pc->b], y = r[pc->c];
+        check_division(x, y);
+        r[pc->a] = x / y;
+        NEXT();
+    }
+    TARGET(MOD) {
+        int64_t x = r[pc->b], y = r[pc->c];
+        check_division(x, y);
+        r[pc->a] = x % y;
+        NEXT();
+    }
+    BINARY(AND,  x & y)
+    BINARY(OR,   x | y)
+    BINARY(XOR,  x ^ y)
+    BINARY(NAND, ~(x & y))
+    BINARY(NOR,  ~(x | y))
+    BINARY(XNOR, ~(x ^ y))
+    BINARY(SHL,  (int64_t)((uint64_t)x << (y & 63)))
+    BINARY(SHR,  x >> (y & 63))
+    BINARY(EQ,   x == y)
+    BINARY(NE,   x != y)
+    BINARY(LT,   x < y)
+    BINARY(LE,   x <= y)
+    BINARY(GT,   x > y)
+    BINARY(GE,   x >= y)
+    BINARY(LAND, (x != 0) & (y != 0))
+    BINARY(LOR,  (x != 0) | (y != 0))
+
+    TARGET(NEG)  { r[pc->a] = (int64_t)((uint64_t)0 - (uint64_t)r[pc->b]); NEXT(); }
+    TARGET(NOT)  { r[pc->a] = ~r[pc->b]; NEXT(); }
+    TARGET(LNOT) { r[pc->a] = r[pc->b] == 0; NEXT(); }
+
+    TARGET(JMP)  { JUMP(pc->imm); }
+    BRANCH(JZ,  r[pc->a] == 0)
+    BRANCH(JNZ, r[pc->a] != 0)
+    BRANCH(JEQ, r[pc->a] == r[pc->b])
+    BRANCH(JNE, r[pc->a] != r[pc->b])
+    BRANCH(JLT, r[pc->a] <  r[pc->b])
+    BRANCH(JLE, r[pc->a] <= r[pc->b])
+    BRANCH(JGT, r[pc->a] >  r[pc->b])
+    BRANCH(JGE, r[pc->a] >= r[pc->b])
+    TARGET(JTAB) {
+        uint64_t i = (uint64_t)r[pc->a] - (uint64_t)r[pc->b];
+        pc += 1 + (i < (uint64_t)pc->imm ? i : (uint64_t)pc->imm);
+        DISPATCH();
+    }
+
+    TARGET(PRINTI) { out_int(r[pc->a]); NEXT(); }
+    TARGET(PRINTS) {
+        out_write(prog->strings[pc->imm], prog->string_lens[pc->imm]);
+        NEXT();
+    }
+
+    TARGET(CALL) {
+        const BytecodeFunc* fn = &prog->funcs[pc->imm];
+        for (int i = 0; i < fn->nparams && i < pc->c; i++) {
+            globals[fn->param_slots[i]] = r[pc->b + i];
+        }
+
+        if (frame_count == frame_capacity) {
+            frame_capacity *= 2;
+            frames = mem_realloc(frames, frame_capacity * sizeof(Frame));
+            if (!frames) {
+                out_of_memory("vm_run (frames)");
+            }
+        }
+        Frame* frame = &frames[frame_count++];
+        frame->ret_pc = (int)(pc - code) + 1;
+        frame->base = base;
+        frame->nregs = nregs;
+        frame->ret_reg = pc->a;
+
+        base += nregs;
+        nregs = fn->nregs;
+        if (base + nregs > reg_capacity) {
+            while (base + nregs > reg_capacity) reg_capacity *= 2;
+            regfile = mem_realloc(regfile, reg_capacity * sizeof(int64_t));
+            if (!regfile) {
+                out_of_memory("vm_run (registers)");
+            }
+        }
+        r = regfile + base;
+        JUMP(fn->entry);
+    }
+
+    TARGET(TAILCALL) {
+        const BytecodeFunc* fn = &prog->funcs[pc->imm];
+        for (int i = 0; i < fn->nparams && i < pc->c; i++) {
+            globals[fn->param_slots[i]] = r[pc->b + i];
+        }
+
+        // same frame and return slot; only the window size changes
+        nregs = fn->nregs;
+        if (base + nregs > reg_capacity) {
+            while (base + nregs > reg_capacity) reg_capacity *= 2;
+            regfile = mem_realloc(regfile, reg_capacity * sizeof(int64_t));
+            if (!regfile) {
+                out_of_memory("vm_run (registers)");
+            }
+            r = regfile + base;
+        }
+        JUMP(fn->entry);
+    }
+
+    TARGET(RET) {
+        int64_t value = r[pc->a];
+        if (frame_count == 0) {
+            status = value;
+            goto halt;
+        }
+        Frame* frame = &frames[--frame_count];
+        base = frame->base;
+        nregs = frame->nregs;
+        r = regfile + base;
+        r[frame->ret_reg] = value;
+        JUMP(frame->ret_pc);
+    }
+
+    TARGET(HALT) {
+        status = r[pc->a];
+        goto halt;
+    }
+
+#ifndef VM_THREADED
+    default:
+        compile_error(0, "Invalid opcode %d", pc->op);
+    }
+#endif
+
+#undef TARGET
+#undef DISPATCH
+#undef NEXT
+#undef JUMP
+#undef BINARY
+#undef BRANCH
+
+halt:
+    out_flush();
+    mem_free(globals);
+    mem_free(regfile);
+    mem_free(frames);
+    // the exit syscall keeps only the low byte
+    return (int)(status & 0xff);
+}
+
+int run_vm(ASTNode* root, int dump_bytecode) {
+    init_symbol_table();
+    stats_begin(PHASE_COLLECT_VARIABLES, NULL);
+    collect_variables(root);
+    stats_end(PHASE_COLLECT_VARIABLES);
+    if (trace_enabled(TRACE_SYMBOLS)) {
+        FILE* trace = trace_begin(TRACE_SYMBOLS, 0, "symbols");
+        print_symbol_table(trace);
+        trace_end(trace);
+    }
+    stats_begin(PHASE_VERIFY_SYMBOLS, NULL);
+    verify_symbols(root);
+    stats_end(PHASE_VERIFY_SYMBOLS);
+
+    stats_begin(PHASE_LOWER, NULL);
+    BytecodeProgram* prog = lower_program(root);
+    stats_end(PHASE_LOWER);
+    free_symbol_table();
+
+    if (dump_bytecode) {
+        bytecode_dump(prog, stderr);
+    }
+
+    fflush(stdout);
+    stats_begin(PHASE_RUN, NULL);
+    int status = vm_run(prog);
+    stats_end(PHASE_RUN);
+    bytecode_free(prog);
+    return status;
+}
@@ -1,35 +1,113 @@
 #!/bin/bash
 
+# SCANNER=flex (default) builds the Flex lexer from lang.l, SCANNER=simd the
+# hand-written memory-mapped scanner in src/lexer/scanner.c
+SCANNER=${SCANNER:-flex}
+
+# COMPILER_SOCKET=PATH sends every compile to a `./utils.sh server` listening
+# on PATH, through bin/compiler-client, instead of starting bin/compiler
+COMPILER=./bin/compiler
+[ -n "$COMPILER_SOCKET" ] && COMPILER=./bin/compiler-client
+
 generate() {
     echo "Generating parser and lexer files..."
     bison -d -o src/parser/parser.tab.c --header=include/parser/parser.tab.h src/parser/parser.y
-    flex -o src/lexer/lex.yy.c src/lexer/lang.l
+    if [ "$SCANNER" = "flex" ]; then
+        flex -o src/lexer/lex.yy.c src/lexer/lang.l
+    fi
+}
+
+lexer_sources() {
+    case "$SCANNER" in
+        flex) echo "src/lexer/lex.yy.c" ;;
+        simd) echo "src/lexer/scanner.c" ;;
+        *) echo "Unknown SCANNER '$SCANNER' (expected flex or simd)" >&2; return 1 ;;
+    esac
 }
 
+# libcompiler: everything but the command line and the server
+LIBRARY_SOURCES="
+    src/parser/parser.tab.c
+    src/parser/ast.c
+    src/codegen/codegen.c
+    src/codegen/handlers.c
+    src/codegen/helpers.c
+    src/codegen/symbol.c
+    src/codegen/layout.c
+    src/codegen/select.c
+    src/codegen/vector.c
+    src/codegen/instrument.c
+    src/codegen/cache.c
+    src/driver/options.c
+    src/driver/stats.c
+    src/driver/profile.c
+    src/driver/memory.c
+    src/driver/diagnostics.c
+    src/vm/bytecode.c
+    src/vm/lower.c
+    src/vm/vm.c
+    src/optimizer/optimizer.c
+    src/optimizer/analysis.c
+    src/optimizer/consteval.c
+    src/optimizer/inline.c
+    src/optimizer/licm.c
+    src/optimizer/cse.c
+    src/optimizer/vectorize.c
+    src/optimizer/unroll.c
+    src/optimizer/dce.c
+    src/optimizer/tailcall.c
+    src/trace/trace.c
+    src/lib/compiler.c"
+
 compile() {
     generate
-    echo "Compiling the compiler executable..."
-    mkdir -p bin
-    gcc -o bin/compiler -Iinclude \
-        src/lexer/lex.yy.c        \
-        src/parser/parser.tab.c   \
-        src/parser/ast.c          \
-        src/codegen/codegen.c     \
-        src/codegen/handlers.c    \
-        src/codegen/helpers.c     \
-        src/codegen/symbol.c      \
-        -lfl
+    echo "Compiling libcompiler and the compiler executable ($SCANNER scanner)..."
+    LEXER=$(lexer_sources) || return 1
+    mkdir -p bin lib build/obj
+    # position independent, so the same objects make the static and the shared library
+    OBJECTS=""
+    for source in $LIBRARY_SOURCES $LEXER; do
+        object="build/obj/$(basename "$source" .c).o"
+        gcc -fPIC -c -Iinclude "$source" -o "$object" || return 1
+        OBJECTS="$OBJECTS $object"
+    done
+    rm -f lib/libcompiler.a
+    ar rcs lib/libcompiler.a $OBJECTS
+    gcc -shared -o lib/libcompiler.so $OBJECTS
+    gcc -pthread -o bin/compiler -Iinclude \
+        src/driver/main.c         \
+        src/server/server.c       \
+        src/server/protocol.c     \
+        lib/libcompiler.a
+    gcc -o bin/compiler-client -Iinclude \
+        src/server/client.c       \
+        src/server/protocol.c     \
+        src/driver/options.c
+    gcc -o bin/tracedump -Iinclude \
+        src/trace/tracedump.c     \
+        src/trace/trace.c         \
+        src/driver/memory.c       \
+        src/driver/diagnostics.c
 }
 
 run() {
     echo "Running the compiler executable..."
     mkdir -p build/asm
-    ./bin/compiler "$@"
+    $COMPILER "$@"
+}
+
+server() {
+    echo "Serving compile requests on ${COMPILER_SOCKET:-build/compiler.sock}..."
+    mkdir -p build
+    ./bin/compiler --server="${COMPILER_SOCKET:-build/compiler.sock}" "$@"
 }
 
 assemble() {
     echo "Assembling the generated assembly file..."
-    nasm -f elf64 build/asm/program.asm -o build/asm/program.o || { echo "Assembly failed"; return 1; }
+    # assembly from `compiler -g` carries %line markers for the DWARF line table
+    DEBUG_FLAGS=""
+    grep -q '^%line' build/asm/program.asm && DEBUG_FLAGS="-g -F dwarf"
+    nasm -f elf64 $DEBUG_FLAGS build/asm/program.asm -o build/asm/program.o || { echo "Assembly failed"; return 1; }
 }
 
 link() {
@@ -45,6 +123,12 @@ binary() {
     ./build/bin/program
 }
 
+vm() {
+    echo "Running the input on the bytecode VM..."
+    echo "|-------------------------|"
+    $COMPILER --vm "$@"
+}
+
 build() {
     echo "Running the full build pipeline..."
     compile
@@ -73,7 +157,7 @@ test() {
     for test_file in $TEST_FILES; do
         echo -e "\n➢ Testing with $test_file..."
         
-        run "$test_file"
+        run "$test_file" "$@"
         rc=$?
         # if run was successful
         if [ $rc -eq 0 ]; then
@@ -94,28 +178,230 @@ test() {
     done
 }
 
+benchmark() {
+    echo "Benchmarking the bytecode VM against the native binaries..."
+
+    RUNS=${RUNS:-200}
+    TEST_FILES=$(find test -type f -name "*.txt" | sort)
+
+    set +e
+    compile > /dev/null || return 1
+    mkdir -p build/bench
+
+    printf "\n%-36s %14s %14s %8s\n" "program" "native (ms)" "vm (ms)" "output"
+    for test_file in $TEST_FILES; do
+        # only programs that compile, assemble and link take part
+        run "$test_file" > /dev/null 2>&1 || continue
+        assemble > /dev/null 2>&1 || continue
+        link > /dev/null 2>&1 || continue
+
+        ./build/bin/program > build/bench/native.out
+        native_rc=$?
+        $COMPILER --vm "$test_file" > build/bench/vm.out 2> /dev/null
+        vm_rc=$?
+
+        # program output is the tail of the VM run (after any compiler chatter)
+        native_size=$(stat -c %s build/bench/native.out)
+        tail -c "$native_size" build/bench/vm.out > build/bench/vm.tail
+        if cmp -s build/bench/native.out build/bench/vm.tail && [ $native_rc -eq $vm_rc ]; then
+            same="same"
+        else
+            same="DIFFERS"
+        fi
+
+        start=$(date +%s%N)
+        for ((i = 0; i < RUNS; i++)); do ./build/bin/program > /dev/null; done
+        native_ms=$(( ($(date +%s%N) - start) / 1000000 ))
+
+        start=$(date +%s%N)
+        for ((i = 0; i < RUNS; i++)); do $COMPILER --vm "$test_file" > /dev/null 2>&1; done
+        vm_ms=$(( ($(date +%s%N) - start) / 1000000 ))
+
+        printf "%-36s %14d %14d %8s\n" "$test_file" "$native_ms" "$vm_ms" "$same"
+    done
+    echo -e "\n($RUNS runs each; vm time includes parsing and lowering)"
+}
+
+throughput() {
+    echo "Measuring compile throughput on generated programs..."
+
+    RUNS=${RUNS:-5}
+    BASELINE=${BASELINE:-test/bench/throughput.tsv}
+    TOLERANCE=${TOLERANCE:-25}  # percent below the baseline rate that counts as a regression
+
+    set +e
+    compile > /dev/null || return 1
+    gcc -O2 -o bin/progen src/bench/progen.c || return 1
+    mkdir -p build/bench build/asm
+    RESULTS=build/bench/throughput.tsv
+
+    # one axis at a time, each growing 4x per step; the other sizes keep
+    # progen's defaults
+    CASES="statements-500 --statements=500
+statements-2k --statements=2000
+statements-8k --statements=8000
+depth-2 --statements=1000 --depth=2
+depth-8 --statements=1000 --depth=8
+nesting-1 --statements=1000 --nesting=1
+nesting-4 --statements=1000 --nesting=4
+functions-16 --statements=1000 --functions=16
+functions-256 --statements=1000 --functions=256
+variables-16 --statements=1000 --variables=16
+variables-1k --statements=1000 --variables=1024"
+
+    printf "case\ttokens\tnodes\tasm_bytes\tms\ttokens_per_s\tnodes_per_s\tasm_bytes_per_s\n" > "$RESULTS"
+    printf "\n%-16s %9s %9s %10s %9s %12s %12s %12s\n" "case" "tokens" "nodes" "asm (B)" "ms" "tokens/s" "nodes/s" "asm B/s"
+    while read -r name args; do
+        program="build/bench/$name.txt"
+        ./bin/progen --seed=1 $args > "$program"
+        tokens=$($COMPILER --trace=tokens "$@" "$program" 2>&1 > /dev/null | grep -c '^\[tokens\]')
+
+        # best of RUNS; --stats=json ends with the totals line
+        best=""
+        for ((i = 0; i < RUNS; i++)); do
+            total=$($COMPILER --stats=json "$@" "$program" 2>&1 > /dev/null |
+                    sed -n 's/.*"total": {"wall_ms": \([0-9.]*\), "nodes": \([0-9]*\), "peak_rss_kb": [0-9]*, "asm_bytes": \([0-9]*\)}}.*/\1 \2 \3/p')
+            [ -z "$total" ] && { echo "$name: compile failed"; continue 2; }
+            best=$(echo "$best $total" | awk '{ if (NF == 3 || $4 < $1) print $(NF-2), $(NF-1), $NF; else print $1, $2, $3 }')
+        done
+        read -r ms nodes asm_bytes <<< "$best"
+        echo "$name $tokens $nodes $asm_bytes $ms" | awk '{
+            s = ($5 > 0 ? $5 : 0.001) / 1000
+            printf "%s\t%d\t%d\t%d\t%.3f\t%.0f\t%.0f\t%.0f\n", $1, $2, $3, $4, $5, $2 / s, $3 / s, $4 / s
+        }' >> "$RESULTS"
+        tail -n 1 "$RESULTS" | awk -F '\t' '{ printf "%-16s %9d %9d %10d %9.3f %12d %12d %12d\n", $1, $2, $3, $4, $5, $6, $7, $8 }'
+    done <<< "$CASES"
+
+    if [ ! -f "$BASELINE" ] || [ "${SAVE:-0}" = "1" ]; then
+        mkdir -p "$(dirname "$BASELINE")"
+        cp "$RESULTS" "$BASELINE"
+        echo -e "\nSaved the results as the baseline ($BASELINE)"
+        return 0
+    fi
+
+    # a case regresses when its nodes/s falls more than TOLERANCE% below the baseline
+    echo -e "\nCompared with $BASELINE (regression: nodes/s more than $TOLERANCE% lower):"
+    awk -F '\t' -v tolerance="$TOLERANCE" '
+        NR == FNR { if (FNR > 1) base[$1] = $7; next }
+        FNR > 1 && ($1 in base) {
+            change = (base[$1] > 0) ? ($7 - base[$1]) * 100 / base[$1] : 0
+            flag = (change < -tolerance) ? "REGRESSED" : "ok"
+            if (flag != "ok") regressions++
+            printf "%-16s %12d -> %12d nodes/s %+7.1f%%  %s\n", $1, base[$1], $7, change, flag
+        }
+        END { exit regressions > 0 }' "$BASELINE" "$RESULTS"
+}
+
+# counters of one perf stat -x, output file: cycles instructions branches branch-misses
+perf_counters() {
+    awk -F ',' '
+        $3 ~ /^cycles/        { cycles = $1 }
+        $3 ~ /^instructions/  { instructions = $1 }
+        $3 ~ /^branches/      { branches = $1 }
+        $3 ~ /^branch-misses/ { misses = $1 }
+        END { printf "%s %s %s %s\n", cycles + 0, instructions + 0, branches + 0, misses + 0 }' "$1"
+}
+
+runtime() {
+    echo "Timing the benchmark programs on each backend and optimization level..."
+
+    RUNS=${RUNS:-3}
+    # a configuration is an optimization level, run natively or (vm-) on the VM
+    CONFIGS=${*:-O0 O1 O2 vm-O0 vm-O2}
+    PROGRAMS=$(find bench/programs -type f -name "*.txt" | sort)
+
+    set +e
+    compile > /dev/null || return 1
+    mkdir -p build/bench
+    RESULTS=build/bench/runtime.tsv
+
+    PERF=""
+    if command -v perf > /dev/null && perf stat -x, -e instructions -o /dev/null true > /dev/null 2>&1; then
+        PERF="perf stat -x, -e cycles,instructions,branches,branch-misses -o build/bench/perf.txt"
+    fi
+
+    printf "program\tconfig\tms\tcycles\tinstructions\tbranches\tbranch_misses\toutput\n" > "$RESULTS"
+    printf "\n%-16s %-7s %10s %14s %6s %8s %8s\n" "program" "config" "ms" "instructions" "IPC" "br-miss" "output"
+    for program in $PROGRAMS; do
+        expected="${program%.txt}.expected"
+        name=$(basename "$program" .txt)
+        for config in $CONFIGS; do
+            level="-${config#vm-}"
+            if [ "$config" = "${config#vm-}" ]; then
+                run "$program" "$level" > /dev/null 2>&1 && assemble > /dev/null 2>&1 && link > /dev/null 2>&1 ||
+                    { printf "%-16s %-7s %10s\n" "$name" "$config" "build failed"; continue; }
+                command=(./build/bin/program)
+            else
+                # includes parsing and lowering, a small share of these programs
+                command=($COMPILER --vm "$level" "$program")
+            fi
+
+            "${command[@]}" > build/bench/runtime.out 2> /dev/null
+            if cmp -s build/bench/runtime.out "$expected"; then output="ok"; else output="WRONG"; fi
+
+            best=""
+            for ((i = 0; i < RUNS; i++)); do
+                start=$(date +%s%N)
+                "${command[@]}" > /dev/null 2>&1
+                ms=$(( ($(date +%s%N) - start) / 1000000 ))
+                if [ -z "$best" ] || [ "$ms" -lt "$best" ]; then best=$ms; fi
+            done
+
+            counters="0 0 0 0"
+            if [ -n "$PERF" ]; then
+                $PERF "${command[@]}" > /dev/null 2>&1 && counters=$(perf_counters build/bench/perf.txt)
+            fi
+            read -r cycles instructions branches misses <<< "$counters"
+
+            printf "%s\t%s\t%d\t%s\t%s\t%s\t%s\t%s\n" "$name" "$config" "$best" \
+                "$cycles" "$instructions" "$branches" "$misses" "$output" >> "$RESULTS"
+            echo "$name $config $best $cycles $instructions $branches $misses $output" | awk '{
+                ipc = ($4 > 0) ? sprintf("%.2f", $5 / $4) : "-"
+                miss = ($6 > 0) ? sprintf("%.2f%%", $7 * 100 / $6) : "-"
+                printf "%-16s %-7s %10d %14s %6s %8s %8s\n", $1, $2, $3, ($5 > 0 ? $5 : "-"), ipc, miss, $8
+            }'
+        done
+    done
+    [ -z "$PERF" ] && echo -e "\n(perf is not available: wall time only)"
+    echo "Results in $RESULTS (best of $RUNS runs)"
+    ! grep -q 'WRONG$' "$RESULTS"
+}
+
 clean() {
     echo "Cleaning up generated files and build artifacts..."
     rm -f src/parser/parser.tab.c include/parser/parser.tab.h
     rm -f src/lexer/lex.yy.c 
     rm -rf bin
+    rm -rf lib
     rm -rf build
 }
 
 help() {
-    echo "Usage: $0 {generate|compile|run|assemble|link|binary|build|example|clean|help}"
+    echo "Usage: $0 {generate|compile|run|assemble|link|binary|vm|build|example|test|benchmark|throughput|runtime|server|clean|help}"
     echo ""
     echo "Commands:"
     echo "  generate       - Generate parser and lexer files using Bison and Flex."
-    echo "  compile        - Generate parser and lexer files, then compile the compiler executable."
+    echo "  compile        - Generate parser and lexer files, then build libcompiler (lib/) and the"
+    echo "                   compiler executable."
+    echo "                   SCANNER=simd uses the memory-mapped scanner instead of Flex."
     echo "  run {input}    - Run the compiler executable with input file."
     echo "  assemble       - Assemble the generated assembly file into an object file."
     echo "  link           - Link the object file to produce the final binary."
     echo "  binary         - Run the final binary."
+    echo "  vm {input}     - Run the input on the bytecode VM (no assembly)."
     echo "  build {input}  - Run the full pipeline: generate, compile, run, assemble and link."
     echo "  example        - Run compiler with predefined example input and run the binary."
     echo "  clean          - Remove all generated files and build artifacts."
-    echo "  test           - Run all tests from the test folder."
+    echo "  test [flags]   - Run all tests from the test folder (flags go to the compiler)."
+    echo "  benchmark      - Time the bytecode VM against the native binaries (RUNS=n)."
+    echo "  runtime [configs] - Run bench/programs natively and on the VM at each optimization level"
+    echo "                   (O0 O1 O2 vm-O0 vm-O2 by default), check their output and report wall"
+    echo "                   time and perf counters when perf is available (RUNS=n)."
+    echo "  throughput [flags] - Compile generated programs and report tokens/s, nodes/s and"
+    echo "                   asm bytes/s against the saved baseline (RUNS=n, SAVE=1, TOLERANCE=pct)."
+    echo "  server [flags] - Keep the compiler resident on the COMPILER_SOCKET Unix socket"
+    echo "                   (default build/compiler.sock); with COMPILER_SOCKET set, the other"
+    echo "                   commands compile through bin/compiler-client."
     echo "  help           - Display this help message."
 }
 
@@ -139,6 +425,9 @@ case "$1" in
     binary)
         binary
         ;;
+    vm)
+        vm "${@:2}"
+        ;;
     build)
         build "${@:2}"
         ;;
@@ -146,7 +435,19 @@ case "$1" in
         example
         ;;
     test)
-        test
+        test "${@:2}"
+        ;;
+    benchmark)
+        benchmark
+        ;;
+    throughput)
+        throughput "${@:2}"
+        ;;
+    runtime)
+        runtime "${@:2}"
+        ;;
+    server)
+        server "${@:2}"
         ;;
     clean)
         clean